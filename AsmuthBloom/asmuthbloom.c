@@ -2,9 +2,11 @@
 // For Arizona State University's CSE539: Applied Cryptography course.
 
 #include "asmuthbloom.h"
+#include "moduli.h"
+#include "remainder.h"
 
 // Free an Asmuth-Bloom instance
-void free_instance(struct asmuth_bloom *instance)
+void free_asmuth_bloom_instance(struct asmuth_bloom *instance)
 {
   // instance never passed init, i.e. just free instance memory
   if (instance->passedInit == 0)
@@ -50,7 +52,7 @@ void free_instance(struct asmuth_bloom *instance)
 // with parameters (t,n,lambda). Parameters must be in the following range:
 // 2 <= t <= n <= 1000
 // 64 <= lambda <= 512
-struct asmuth_bloom *init_instance(int t, int n, int lambda)
+struct asmuth_bloom *init_asmuth_bloom_instance(int t, int n, int lambda)
 {
   struct asmuth_bloom *instance;
   instance = (struct asmuth_bloom *)malloc(1 * sizeof(struct asmuth_bloom));
@@ -65,24 +67,63 @@ struct asmuth_bloom *init_instance(int t, int n, int lambda)
   if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
   {
     printf("Asmuth-Bloom (%d,%d) scheme with security %d is not valid.\n", t, n, lambda);
-    free_instance(instance);
+    free_asmuth_bloom_instance(instance);
     exit(EXIT_FAILURE);
   }
 
   instance->t = t;
   instance->n = n;
   instance->lambda = lambda;
+  instance->pool = NULL;
+  instance->moduli = NULL;
+  instance->tree = NULL;
   instance->passedInit = 1;
   return instance;
 }
 
+// Splits the share reductions across pool's threads. The pool is not owned by
+// the instance and can be shared by any number of them, as long as they do not
+// generate shares at the same time. NULL goes back to serial.
+void set_asmuth_bloom_thread_pool(struct asmuth_bloom *instance, struct thread_pool *pool)
+{
+  instance->pool = pool;
+}
+
+// Takes m_0 ... m_n from a precomputed table instead of searching them. The
+// table is not owned by the instance, must be for the instance's lambda and
+// hold at least n moduli after m_0. NULL goes back to the prime search.
+void set_moduli_table(struct asmuth_bloom *instance, const struct moduli_table *table)
+{
+  if (table != NULL && (table->lambda != instance->lambda || table->n < instance->n))
+  {
+    printf("Moduli table for security %d and n = %d does not fit the (%d,%d) instance with security %d.\n",
+           table->lambda, table->n, instance->t, instance->n, instance->lambda);
+    return;
+  }
+  instance->moduli = table;
+}
+
+// Reduces the shares through a product tree of m_1 ... m_n built earlier,
+// usually over a moduli table, instead of building one. The tree is not owned
+// by the instance and is only used if its moduli turn out to be the
+// instance's. NULL goes back to building a tree when t is large.
+void set_product_tree(struct asmuth_bloom *instance, const struct product_tree *tree)
+{
+  if (tree != NULL && tree->n != instance->n)
+  {
+    printf("Product tree over %d moduli does not fit the (%d,%d) instance.\n", tree->n, instance->t, instance->n);
+    return;
+  }
+  instance->tree = tree;
+}
+
 // generate random secret of length lambda
-void generate_secret(struct asmuth_bloom *instance)
+void generate_asmuth_bloom_secret(struct asmuth_bloom *instance)
 {
   if (instance->passedInit != 1)
   {
     printf("Failed trying to generate secret before instance init.\n");
-    free_instance(instance);
+    free_asmuth_bloom_instance(instance);
     exit(EXIT_FAILURE);
   }
   else if (instance->hasSecret == 1)
@@ -113,27 +154,171 @@ void generate_secret(struct asmuth_bloom *instance)
 // Set it to set
 void get_next_prime(mpz_t *set, mpz_t num, int lambda)
 {
-  mpz_t *prime = (mpz_t *)malloc(1 * sizeof(mpz_t));
-  mpz_init(*prime);
-  mpz_nextprime(*prime, num);
+  mpz_t prime;
+  mpz_init(prime);
+  mpz_nextprime(prime, num);
+
+  // a candidate that fails the stronger test is skipped, not searched again
+  while (mpz_probab_prime_p(prime, lambda / 2) == 0)
+  {
+    mpz_nextprime(prime, prime);
+  }
+
+  mpz_set(*set, prime);
+  mpz_clear(prime);
+  return;
+}
+
+struct prime_job
+{
+  mpz_t *candidates;
+  int *index; // candidates[index[i]] is the i-th one tested, NULL for all in order
+  char *prime;
+  int reps;
+};
+
+// prime[i] = whether candidate i passes reps rounds of the primality test,
+// begin <= i < end
+static void test_range(void *arg, int begin, int end)
+{
+  struct prime_job *job = (struct prime_job *)arg;
+  for (int i = begin; i < end; i++)
+  {
+    mpz_srcptr candidate = job->candidates[job->index != NULL ? job->index[i] : i];
+    job->prime[i] = mpz_probab_prime_p(candidate, job->reps) != 0;
+  }
+}
 
-  int prime_found = 0;
-  while (prime_found == 0)
+// Sets out[0 ... count-1] to the count primes that follow after (at least 2),
+// in increasing order, each with err probability 1/(2^lambda): the same chain
+// as calling get_next_prime on the previous one count times.
+//
+// Windows of odd numbers above after are sieved by the odd primes below
+// SIEVE_PRIME_LIMIT, which leaves about one candidate in ten. The survivors
+// go through a single-round test SIEVE_BATCH per thread at a time, and only
+// the passing ones the chain still needs get the lambda / 2 rounds, which are
+// most of the work. Both steps are split across pool's threads (NULL for
+// serial).
+void next_primes(mpz_t *out, int count, const mpz_t after, int lambda, struct thread_pool *pool)
+{
+  // odd primes below SIEVE_PRIME_LIMIT
+  char *composite = (char *)calloc(SIEVE_PRIME_LIMIT, 1);
+  unsigned long int *small = (unsigned long int *)malloc(SIEVE_PRIME_LIMIT / 2 * sizeof(unsigned long int));
+  int smalls = 0;
+  for (unsigned long int q = 3; q < SIEVE_PRIME_LIMIT; q += 2)
   {
-    int test;
-    test = mpz_probab_prime_p(*prime, lambda / 2);
-    if (test > 0)
+    if (composite[q])
     {
-      prime_found = 1;
+      continue;
     }
-    else if (test == 0)
+    small[smalls++] = q;
+    for (unsigned long int j = q * q; j < SIEVE_PRIME_LIMIT; j += 2 * q)
     {
-      mpz_nextprime(*prime, num);
+      composite[j] = 1;
     }
   }
+  free(composite);
+
+  // the window covers low, low + 2, ..., low + 2 (width - 1), sized for the
+  // expected gap of about ln(after) between primes plus a quarter
+  long gap = (long)mpz_sizeinbase(after, 2) * 7 / 10 + 1;
+  long width = (long)count * gap / 2 * 5 / 4;
+  width = width < 4096 ? 4096 : (width > (1L << 22) ? (1L << 22) : width);
+  char *sieve = (char *)malloc(width);
+  mpz_t low;
+  mpz_init(low);
+  mpz_add_ui(low, after, (unsigned long int)1);
+  if (mpz_even_p(low))
+  {
+    mpz_add_ui(low, low, (unsigned long int)1);
+  }
 
-  mpz_set(*set, *prime);
-  return;
+  int batch = SIEVE_BATCH * (pool != NULL ? pool->threads : 1);
+  mpz_t *candidates = (mpz_t *)malloc(batch * sizeof(mpz_t));
+  for (int i = 0; i < batch; i++)
+  {
+    mpz_init(candidates[i]);
+  }
+  int *passed = (int *)malloc(batch * sizeof(int));
+  char *prime = (char *)malloc(batch);
+  struct prime_job job;
+  job.candidates = candidates;
+  job.prime = prime;
+
+  int found = 0;
+  while (found < count)
+  {
+    // low + 2j = 0 mod q  <=>  j = -low / 2 mod q; q itself is not struck
+    memset(sieve, 0, width);
+    for (int k = 0; k < smalls; k++)
+    {
+      unsigned long int q = small[k];
+      unsigned long int r = mpz_fdiv_ui(low, q);
+      unsigned long int j = (q - r) % q * ((q + 1) / 2) % q;
+      if (mpz_cmp_ui(low, q) <= 0 && mpz_get_ui(low) + 2 * j == q)
+      {
+        j += q;
+      }
+      for (; j < (unsigned long int)width; j += q)
+      {
+        sieve[j] = 1;
+      }
+    }
+
+    // the survivors in order, a batch at a time
+    long j = 0;
+    while (j < width && found < count)
+    {
+      int k = 0;
+      for (; j < width && k < batch; j++)
+      {
+        if (!sieve[j])
+        {
+          mpz_add_ui(candidates[k++], low, (unsigned long int)(2 * j));
+        }
+      }
+      job.index = NULL;
+      job.reps = 1;
+      thread_pool_run(pool, k, test_range, &job);
+      int passes = 0;
+      for (int i = 0; i < k; i++)
+      {
+        if (prime[i])
+        {
+          passed[passes++] = i;
+        }
+      }
+
+      // full test for as many of them, in order, as are still missing
+      job.reps = lambda / 2;
+      for (int first = 0; first < passes && found < count;)
+      {
+        int take = passes - first < count - found ? passes - first : count - found;
+        job.index = passed + first;
+        thread_pool_run(pool, take, test_range, &job);
+        for (int i = 0; i < take; i++)
+        {
+          if (prime[i])
+          {
+            mpz_set(out[found++], candidates[passed[first + i]]);
+          }
+        }
+        first += take;
+      }
+    }
+    mpz_add_ui(low, low, (unsigned long int)(2 * width));
+  }
+
+  for (int i = 0; i < batch; i++)
+  {
+    mpz_clear(candidates[i]);
+  }
+  free(candidates);
+  free(passed);
+  free(prime);
+  free(sieve);
+  free(small);
+  mpz_clear(low);
 }
 
 // This has been thoroughly tested to always pass, not necessary to run anymore.
@@ -157,7 +342,7 @@ void check_m(struct asmuth_bloom *instance)
              instance->t,
              instance->n,
              instance->lambda);
-      free_instance(instance);
+      free_asmuth_bloom_instance(instance);
       exit(EXIT_FAILURE);
     }
   }
@@ -182,15 +367,40 @@ void check_m(struct asmuth_bloom *instance)
            instance->t,
            instance->n,
            instance->lambda);
-    free_instance(instance);
+    free_asmuth_bloom_instance(instance);
     exit(EXIT_FAILURE);
   }
 
   return;
 }
 
+struct share_job
+{
+  struct asmuth_bloom *instance;
+  const mp_limb_t *y; // s + alpha * m[0]
+  mp_size_t yn;
+  int first;          // range index 0 is participant first
+};
+
+// shares[i] = y mod m[i+1] for first + begin <= i < first + end, each a
+// division of y's limbs on the field layer
+static void share_range(void *arg, int begin, int end)
+{
+  struct share_job *job = (struct share_job *)arg;
+  struct asmuth_bloom *instance = job->instance;
+  mp_limb_t *scratch = (mp_limb_t *)malloc((job->yn + 1) * sizeof(mp_limb_t));
+  for (int i = job->first + begin; i < job->first + end; i++)
+  {
+    mp_size_t mn = (mp_size_t)mpz_size((instance->m)[i + 1]);
+    mp_limb_t *share = mpz_limbs_write((instance->shares)[i], mn);
+    field_mod(share, job->y, job->yn, mpz_limbs_read((instance->m)[i + 1]), mn, scratch);
+    mpz_limbs_finish((instance->shares)[i], mn);
+  }
+  free(scratch);
+}
+
 // generates shares for Asmuth-Bloom instance
-void generate_shares(struct asmuth_bloom *instance)
+void generate_asmuth_bloom_shares(struct asmuth_bloom *instance)
 {
   if (instance->hasShares != 0 && instance->hasM != 0)
   {
@@ -220,19 +430,28 @@ void generate_shares(struct asmuth_bloom *instance)
     mpz_init((instance->m)[i]);
   }
   instance->hasM = 1;
+  instance->capacity = instance->n;
 
-  // gnereating m_0 and m_1
-  get_next_prime(&((instance->m)[0]), instance->s, instance->lambda); // m_0 = next prime after s
-  mpz_mul_si(temp, (instance->m)[0], (long int)2);                    // temp = s * 2
-  get_next_prime(&((instance->m)[1]), temp, instance->lambda);        // m_1 = next prime after 2*m_0
-
-  // iteratively generating m_2...m_n from m_(i-1)
-  for (int i = 2; i <= instance->n; i++)
+  if (instance->moduli != NULL)
   {
-    get_next_prime(&((instance->m)[i]), (instance->m)[i - 1], instance->lambda);
+    // the table was checked when it was built
+    for (int i = 0; i <= instance->n; i++)
+    {
+      get_modulus((instance->m)[i], instance->moduli, i);
+    }
   }
+  else
+  {
+    // gnereating m_0 and m_1
+    get_next_prime(&((instance->m)[0]), instance->s, instance->lambda); // m_0 = next prime after s
+    mpz_mul_si(temp, (instance->m)[0], (long int)2);                    // temp = m_0 * 2
+
+    // m_1 = next prime after 2*m_0 and m_2...m_n the primes that follow it,
+    // sieved in one pass
+    next_primes(instance->m + 1, instance->n, temp, instance->lambda, instance->pool);
 
-  check_m(instance); // Not necessary. Trey has shown always mathematically passes.
+    check_m(instance); // Not necessary. Trey has shown always mathematically passes.
+  }
 
   // get an upper bound for a
   mpz_set_ui(ub, (unsigned long int)1);
@@ -252,13 +471,37 @@ void generate_shares(struct asmuth_bloom *instance)
   mpz_urandomm(instance->alpha, state, ub);
 
   // generate shares
-  for (int i = 0; i < instance->n; i++)
+  // y = s + alpha * m[0] is the same for every participant, so it is formed
+  // once. With a large threshold y spans many moduli and goes down a product
+  // tree, otherwise each participant divides it on the instance's threads.
+  mpz_set(temp, instance->s);
+  mpz_addmul(temp, instance->alpha, (instance->m)[0]);
+  const struct product_tree *tree = instance->tree;
+  for (int i = 0; tree != NULL && i < instance->n; i++)
   {
-    mpz_set((instance->shares)[i], instance->s); // shares[i] = s
-    // shares[i] = shares[i] + alpha * m[0]
-    mpz_addmul((instance->shares)[i], instance->alpha, (instance->m)[0]);
-    // shares[i] = shares[i] mod m[i+1]
-    mpz_mod((instance->shares)[i], (instance->shares)[i], (instance->m)[i + 1]);
+    if (mpz_cmp((tree->m)[i], (instance->m)[i + 1]) != 0)
+    {
+      tree = NULL;
+    }
+  }
+  if (tree != NULL)
+  {
+    remainder_tree(instance->shares, temp, tree, instance->pool);
+  }
+  else if (instance->t >= REMAINDER_TREE_THRESHOLD)
+  {
+    struct product_tree *built = build_moduli_tree(instance->m + 1, instance->n, instance->pool);
+    remainder_tree(instance->shares, temp, built, instance->pool);
+    free_moduli_tree(built);
+  }
+  else
+  {
+    struct share_job job;
+    job.instance = instance;
+    job.y = mpz_limbs_read(temp);
+    job.yn = (mp_size_t)mpz_size(temp);
+    job.first = 0;
+    thread_pool_run(instance->pool, instance->n, share_range, &job);
   }
 
   mpz_clear(temp);
@@ -266,86 +509,310 @@ void generate_shares(struct asmuth_bloom *instance)
   return;
 }
 
-// output 1 if secret successfully recovered. 0 else.
-int recover_secret(struct asmuth_bloom *instance)
+// Enrolls participants n+1, ..., n+k into an instance that already has
+// shares. The moduli chain continues from m[n] and only the new shares are
+// reduced, so each participant costs one prime and one division, plus
+// O(t) multiplications to check that the t - 1 largest moduli still leave
+// m[0] * m[n-t+2] * ... * m[n] below m[1] * ... * m[t]. The m and shares
+// arrays grow geometrically.
+void add_asmuth_bloom_participants(struct asmuth_bloom *instance, int k)
 {
   if (instance->hasShares != 1 || instance->hasM != 1)
   {
-    printf("Asmuth-Bloom instance does not have shares to reconstruct.\n");
-    exit(EXIT_FAILURE);
+    printf("Cannot add participants to an Asmuth-Bloom instance without shares.\n");
+    return;
+  }
+  if (k < 1 || instance->n + k > 1000)
+  {
+    printf("Cannot add %d participants to %d, the limit is 1000.\n", k, instance->n);
+    return;
   }
 
-  // Variables
-  int isSecret;
-  mpz_t result;
-  mpz_t dummy;          // Not used, just to satisfy function args
-  mpz_t m_product;      // will be m_1 * ... m_t
-  mpz_t a[instance->t]; // used for Ext Euclidean Algo
-  mpz_t b[instance->t]; // used for Ext Euclidean Algo
-  mpz_t e[instance->t]; // used for construction of secret
+  int n = instance->n + k;
+  if (n > instance->capacity)
+  {
+    int capacity = 2 * instance->capacity > n ? 2 * instance->capacity : n;
+    instance->m = (mpz_t *)realloc(instance->m, (capacity + 1) * sizeof(mpz_t));
+    instance->shares = (mpz_t *)realloc(instance->shares, capacity * sizeof(mpz_t));
+    instance->capacity = capacity;
+  }
+  for (int i = instance->n; i < n; i++)
+  {
+    mpz_init((instance->m)[i + 1]);
+    mpz_init((instance->shares)[i]);
+  }
 
-  // inits
-  mpz_init(result);
-  mpz_init(dummy);
-  mpz_init_set_ui(m_product, (unsigned long)1);
-  for (int i = 0; i < instance->t; i++)
+  // the table's chain continues from m_0 of the table, not of the secret
+  int from_table = 0;
+  if (instance->moduli != NULL && n <= instance->moduli->n)
+  {
+    mpz_t m0;
+    mpz_init(m0);
+    get_modulus(m0, instance->moduli, 0);
+    from_table = mpz_cmp(m0, (instance->m)[0]) == 0;
+    mpz_clear(m0);
+  }
+  if (from_table)
+  {
+    for (int i = instance->n + 1; i <= n; i++)
+    {
+      get_modulus((instance->m)[i], instance->moduli, i);
+    }
+  }
+  else
   {
-    mpz_init(a[i]);
-    mpz_init(b[i]);
-    mpz_init_set_ui(e[i], (unsigned long)1);
+    next_primes(instance->m + instance->n + 1, k, (instance->m)[instance->n], instance->lambda, instance->pool);
   }
 
-  // Calculate:
-  // m_product = m_1 * ... * m_t
-  for (int i = 0; i < instance->t; i++)
+  mpz_t lhs, rhs;
+  mpz_init_set(lhs, (instance->m)[0]);
+  mpz_init_set_ui(rhs, (unsigned long int)1);
+  for (int i = n - instance->t + 2; i <= n; i++)
+  {
+    mpz_mul(lhs, lhs, (instance->m)[i]);
+  }
+  for (int i = 1; i <= instance->t; i++)
+  {
+    mpz_mul(rhs, rhs, (instance->m)[i]);
+  }
+  int fits = mpz_cmp(lhs, rhs) < 0;
+  mpz_clear(lhs);
+  mpz_clear(rhs);
+  if (!fits)
   {
-    mpz_mul(m_product, m_product, (instance->m)[i + 1]);
+    printf("Moduli for %d participants break the Asmuth-Bloom condition, none added.\n", n);
+    for (int i = instance->n; i < n; i++)
+    {
+      mpz_clear((instance->m)[i + 1]);
+      mpz_clear((instance->shares)[i]);
+    }
+    return;
   }
 
-  // Calculate:
-  // (a_i,b_i) = Extended Euclidian Algo (m_[i+1], m_product / m_[i+1])
-  // e_i = 1 - a_i * m_[i+1]
-  for (int i = 0; i < instance->t; i++)
+  // y = s + alpha * m[0], as in generate_asmuth_bloom_shares
+  mpz_t y;
+  mpz_init_set(y, instance->s);
+  mpz_addmul(y, instance->alpha, (instance->m)[0]);
+  struct share_job job;
+  job.instance = instance;
+  job.y = mpz_limbs_read(y);
+  job.yn = (mp_size_t)mpz_size(y);
+  job.first = instance->n;
+  thread_pool_run(instance->pool, k, share_range, &job);
+  mpz_clear(y);
+
+  instance->n = n;
+}
+
+// Precomputes the constants to recover from the shares of participants
+// x[0], ..., x[k-1], k >= t, each one of 1 ... n. Returns NULL if the quorum
+// is not valid.
+struct asmuth_bloom_recovery *init_asmuth_bloom_recovery(struct asmuth_bloom *instance, const int *x, int k)
+{
+  if (instance->hasM != 1)
+  {
+    printf("Asmuth-Bloom instance does not have moduli to recover with.\n");
+    return NULL;
+  }
+  if (k < instance->t)
+  {
+    printf("Recovery needs at least %d shares, got %d.\n", instance->t, k);
+    return NULL;
+  }
+  char *seen = (char *)calloc(instance->n + 1, sizeof(char));
+  for (int j = 0; j < k; j++)
   {
-    mpz_cdiv_q(dummy, m_product, (instance->m)[i + 1]); // dummy = m_prod / m_[i+1]
-    mpz_gcdext(dummy, a[i], b[i], (instance->m)[i + 1], dummy);
-    mpz_submul(e[i], a[i], (instance->m)[i + 1]); // e[i] = 1 - a[i] * m[i+1]
+    if (x[j] < 1 || x[j] > instance->n || seen[x[j]])
+    {
+      printf("Participant %d is not one of the %d participants or is in the quorum twice.\n", x[j], instance->n);
+      free(seen);
+      return NULL;
+    }
+    seen[x[j]] = 1;
+  }
+  free(seen);
+
+  struct asmuth_bloom_recovery *context;
+  context = (struct asmuth_bloom_recovery *)malloc(1 * sizeof(struct asmuth_bloom_recovery));
+  context->k = k;
+  context->x = (int *)malloc(k * sizeof(int));
+  memcpy(context->x, x, k * sizeof(int));
+  mpz_init_set(context->m0, (instance->m)[0]);
+  context->f = NULL;
+  context->weights = NULL;
+  context->inverse = NULL;
+  context->tree = NULL;
+  context->cofactor = NULL;
+
+  // Garner needs the digits of every q_j in one limb count, which a chain
+  // that crosses a limb boundary does not give
+  int garner = (size_t)k * mpz_size((instance->m)[x[0]]) < CRT_TREE_THRESHOLD;
+  if (garner)
+  {
+    context->f = (struct field *)malloc((k + 1) * sizeof(struct field));
+    for (int j = 0; j <= k; j++)
+    {
+      field_init(&((context->f)[j]), j < k ? (instance->m)[x[j]] : context->m0);
+      garner &= (context->f)[j].limbs == (context->f)[0].limbs || j == k;
+    }
   }
+  if (!garner)
+  {
+    free(context->f);
+    context->f = NULL;
+    mpz_t *q = (mpz_t *)malloc(k * sizeof(mpz_t));
+    context->cofactor = (mpz_t *)malloc(k * sizeof(mpz_t));
+    for (int j = 0; j < k; j++)
+    {
+      mpz_init_set(q[j], (instance->m)[x[j]]);
+      mpz_init((context->cofactor)[j]);
+    }
+    context->tree = build_moduli_tree(q, k, NULL);
+    cofactor_inverses(context->cofactor, context->tree);
+    for (int j = 0; j < k; j++)
+    {
+      mpz_clear(q[j]);
+    }
+    free(q);
+    return context;
+  }
+
+  // row k, over m_0, has m_0's limb count
+  context->limbs = (context->f)[0].limbs;
+  context->weights = (mp_limb_t *)malloc(((size_t)k * (k - 1) / 2 * context->limbs + (size_t)k * (context->f)[k].limbs) *
+                                         sizeof(mp_limb_t));
+  context->inverse = (mp_limb_t *)malloc((size_t)k * context->limbs * sizeof(mp_limb_t));
 
-  // Calculate:
-  // result = e[0]*share[0] + ... + e[t-1]*share[t-1] mod m_product
-  for (int i = 0; i < instance->t; i++)
+  // row j: Q_0 = 1, Q_(i+1) = Q_i q_i mod q_j, ending at Q_j
+  mpz_t power;
+  mpz_init(power);
+  for (int j = 0; j <= k; j++)
   {
-    mpz_mul(dummy, e[i], (instance->shares)[i]);
-    mpz_add(result, result, dummy);
+    const struct field *f = &((context->f)[j]);
+    mpz_srcptr modulus = j < k ? (instance->m)[x[j]] : context->m0;
+    mp_limb_t *row = context->weights + (size_t)j * (j - 1) / 2 * context->limbs;
+    mpz_set_ui(power, (unsigned long int)1);
+    for (int i = 0; i < j; i++)
+    {
+      field_import(row + (size_t)i * f->limbs, power, f);
+      mpz_mul(power, power, (instance->m)[x[i]]);
+      mpz_mod(power, power, modulus);
+    }
+    if (j < k)
+    {
+      mp_limb_t plain[FIELD_MAX_LIMBS];
+      mpz_invert(power, power, modulus);
+      field_import(plain, power, f);
+      field_to_mont(context->inverse + (size_t)j * context->limbs, plain, f);
+    }
   }
-  mpz_mod(result, result, m_product);
-  mpz_mod(result, result, (instance->m)[0]);
+  mpz_clear(power);
+  return context;
+}
+
+void free_asmuth_bloom_recovery(struct asmuth_bloom_recovery *context)
+{
+  if (context->tree != NULL)
+  {
+    for (int j = 0; j < context->k; j++)
+    {
+      mpz_clear((context->cofactor)[j]);
+    }
+    free(context->cofactor);
+    free_moduli_tree(context->tree);
+  }
+  free(context->f);
+  free(context->weights);
+  free(context->inverse);
+  free(context->x);
+  mpz_clear(context->m0);
+  free(context);
+}
 
-  // compare result to secret
-  if (mpz_cmp(result, instance->s) == 0)
-  { // Success!
-    isSecret = 1;
+// secret = s from shares[j], the share of participant x[j] of the quorum
+void asmuth_bloom_recover_with(mpz_t secret, const struct asmuth_bloom_recovery *context, const mpz_t *shares)
+{
+  int k = context->k;
+  if (context->tree != NULL)
+  {
+    // w_j = r_j (M / q_j)^-1 mod q_j, y = sum w_j M / q_j mod M
+    mpz_t *w = (mpz_t *)malloc(k * sizeof(mpz_t));
+    for (int j = 0; j < k; j++)
+    {
+      mpz_init(w[j]);
+      mpz_mul(w[j], shares[j], (context->cofactor)[j]);
+      mpz_mod(w[j], w[j], (context->tree->m)[j]);
+    }
+    crt_combine(secret, w, context->tree);
+    mpz_mod(secret, secret, (context->tree->node)[0]);
+    mpz_mod(secret, secret, context->m0);
+    for (int j = 0; j < k; j++)
+    {
+      mpz_clear(w[j]);
+    }
+    free(w);
+    return;
   }
-  else
+
+  int limbs = context->limbs;
+  mp_limb_t *v = (mp_limb_t *)malloc((size_t)k * limbs * sizeof(mp_limb_t));
+  mp_limb_t r[FIELD_MAX_LIMBS], acc[FIELD_MAX_LIMBS];
+  for (int j = 0; j < k; j++)
   {
-    isSecret = 0;
+    const struct field *f = &((context->f)[j]);
+    const mp_limb_t *row = context->weights + (size_t)j * (j - 1) / 2 * limbs;
+    field_import(r, shares[j], f);
+    memset(acc, 0, limbs * sizeof(mp_limb_t));
+    if (j > 0)
+    {
+      f->ops->dot(acc, v, row, j, f);
+    }
+    f->ops->sub(acc, r, acc, f);
+    f->ops->mul(v + (size_t)j * limbs, acc, context->inverse + (size_t)j * limbs, f);
   }
 
-  mpz_clear(result);
-  mpz_clear(dummy);
-  mpz_clear(m_product);
-  for (int i = 0; i < instance->t; i++)
+  // the digits are below their own moduli, which are above m_0
+  const struct field *f0 = &((context->f)[k]);
+  mp_limb_t *u = (mp_limb_t *)calloc((size_t)k * f0->limbs, sizeof(mp_limb_t));
+  mp_limb_t scratch[FIELD_MAX_LIMBS + 1];
+  for (int j = 0; j < k; j++)
   {
-    mpz_clear(a[i]);
-    mpz_clear(b[i]);
-    mpz_clear(e[i]);
+    field_mod(u + (size_t)j * f0->limbs, v + (size_t)j * limbs, limbs, f0->p, f0->psize, scratch);
   }
+  f0->ops->dot(acc, u, context->weights + (size_t)k * (k - 1) / 2 * limbs, k, f0);
+  field_export(secret, acc, f0);
+  free(u);
+  free(v);
+}
 
+// Recovers s from the shares of participants 1 ... t and returns 1 if it
+// matches the instance's secret.
+int recover_asmuth_bloom_secret(struct asmuth_bloom *instance)
+{
+  if (instance->hasShares != 1 || instance->hasM != 1)
+  {
+    printf("Asmuth-Bloom instance does not have shares to reconstruct.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int *x = (int *)malloc(instance->t * sizeof(int));
+  for (int j = 0; j < instance->t; j++)
+  {
+    x[j] = j + 1;
+  }
+  struct asmuth_bloom_recovery *context = init_asmuth_bloom_recovery(instance, x, instance->t);
+  free(x);
+
+  mpz_t result;
+  mpz_init(result);
+  asmuth_bloom_recover_with(result, context, instance->shares);
+  int isSecret = mpz_cmp(result, instance->s) == 0;
+  mpz_clear(result);
+  free_asmuth_bloom_recovery(context);
   return isSecret;
 }
 
-void print_instance(struct asmuth_bloom *instance)
+void print_asmuth_bloom_instance(struct asmuth_bloom *instance)
 {
   if (instance->passedInit == 1)
   {
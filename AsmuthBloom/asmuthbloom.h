@@ -5,7 +5,24 @@
 #include <gmp.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/random.h>
+#include "../common/field.h"
+#include "../common/threadpool.h"
+#include "../common/visibility.h"
+
+struct moduli_table;
+struct product_tree;
+
+// next_primes sieves candidate moduli by the odd primes below this
+#define SIEVE_PRIME_LIMIT 65536
+
+// candidates next_primes tests at a time per thread
+#define SIEVE_BATCH 16
+
+// quorums whose moduli take up at least this many limbs in all recover
+// through a product tree, below it Garner's quadratic loop is faster
+#define CRT_TREE_THRESHOLD 192
 
 struct asmuth_bloom
 {
@@ -24,22 +41,69 @@ struct asmuth_bloom
   mpz_t *m;    // the pairwise relative primes
   mpz_t alpha; // random value
   mpz_t *shares;
+  int capacity; // participants m and shares have room for, at least n
+
+  struct thread_pool *pool; // splits share generation across threads, NULL for serial
+  const struct moduli_table *moduli; // precomputed m, NULL to search the primes
+  const struct product_tree *tree;   // product tree of m[1 ... n], NULL to build one if t is large
+};
+
+// Constants of the Chinese remainder theorem for a fixed quorum, so that the
+// same quorum can recover any number of secrets. With q_j = m[x[j]] and
+// Q_j = q_0 ... q_(j-1), Garner's algorithm finds the mixed radix digits
+// 	v_j = (r_j - sum_{i<j} v_i Q_i) Q_j^-1 mod q_j
+// of y = sum v_j Q_j, and s = sum v_j (Q_j mod m_0) mod m_0. Every step is a
+// dot product of residues on the field layer, O(k^2) word sized products in
+// all and no number wider than a modulus. Wider quorums go through a product
+// tree, which GMP's subquadratic products make faster from a few hundred
+// limbs on.
+struct asmuth_bloom_recovery
+{
+  int k;     // number of shares in the quorum
+  int *x;    // participants of the quorum, with moduli m[x[j]]
+  mpz_t m0;
+
+  // Garner, below CRT_TREE_THRESHOLD limbs
+  int limbs;          // limbs per digit
+  struct field *f;    // f[j] over q_j, f[k] over m_0
+  mp_limb_t *weights; // row j at j (j - 1) / 2 digits: Q_i mod q_j for i < j, row k is mod m_0
+  mp_limb_t *inverse; // Q_j^-1 mod q_j in Montgomery form
+
+  // from CRT_TREE_THRESHOLD limbs on, NULL below
+  struct product_tree *tree; // over the quorum's moduli
+  mpz_t *cofactor;           // (M / q_j)^-1 mod q_j, M = q_0 ... q_(k-1)
 };
 
-void free_instance(struct asmuth_bloom *);
+SECRET_SHARING_API void free_asmuth_bloom_instance(struct asmuth_bloom *);
+
+SECRET_SHARING_API struct asmuth_bloom *init_asmuth_bloom_instance(int, int, int);
+
+SECRET_SHARING_API void set_asmuth_bloom_thread_pool(struct asmuth_bloom *, struct thread_pool *);
 
-struct asmuth_bloom *init_instance(int, int, int);
+SECRET_SHARING_API void set_moduli_table(struct asmuth_bloom *, const struct moduli_table *);
 
-void generate_secret(struct asmuth_bloom *);
+SECRET_SHARING_API void set_product_tree(struct asmuth_bloom *, const struct product_tree *);
+
+SECRET_SHARING_API void generate_asmuth_bloom_secret(struct asmuth_bloom *);
 
 void get_next_prime(mpz_t *, mpz_t, int);
 
+void next_primes(mpz_t *, int, const mpz_t, int, struct thread_pool *);
+
 void check_m(struct asmuth_bloom *);
 
-void generate_shares(struct asmuth_bloom *);
+SECRET_SHARING_API void generate_asmuth_bloom_shares(struct asmuth_bloom *);
+
+SECRET_SHARING_API void add_asmuth_bloom_participants(struct asmuth_bloom *, int);
+
+SECRET_SHARING_API struct asmuth_bloom_recovery *init_asmuth_bloom_recovery(struct asmuth_bloom *, const int *, int);
+
+SECRET_SHARING_API void free_asmuth_bloom_recovery(struct asmuth_bloom_recovery *);
+
+SECRET_SHARING_API void asmuth_bloom_recover_with(mpz_t, const struct asmuth_bloom_recovery *, const mpz_t *);
 
-int recover_secret(struct asmuth_bloom *);
+SECRET_SHARING_API int recover_asmuth_bloom_secret(struct asmuth_bloom *);
 
-void print_instance(struct asmuth_bloom *);
+SECRET_SHARING_API void print_asmuth_bloom_instance(struct asmuth_bloom *);
 
 #endif
@@ -1,6 +1,264 @@
+#define _POSIX_C_SOURCE 199309L
 #include "asmuthbloom.h"
+#include "moduli.h"
+#include "remainder.h"
+#include "rns.h"
 #include <stdio.h>
 #include <gmp.h>
+#include <string.h>
+#include <time.h>
+
+static double seconds_since(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// s from the shares of participants first + 1 ... first + t by the CRT,
+// returns 1 if it matches the instance's secret
+static int recover_from(struct asmuth_bloom *instance, int first)
+{
+  mpz_t y, M, c, inv;
+  mpz_init_set_ui(y, (unsigned long int)0);
+  mpz_init_set_ui(M, (unsigned long int)1);
+  mpz_init(c);
+  mpz_init(inv);
+  for (int i = first; i < first + instance->t; i++)
+  {
+    // y += M * ((share - y) * M^-1 mod m), M *= m
+    mpz_ptr m = (instance->m)[i + 1];
+    mpz_invert(inv, M, m);
+    mpz_sub(c, (instance->shares)[i], y);
+    mpz_mul(c, c, inv);
+    mpz_mod(c, c, m);
+    mpz_addmul(y, M, c);
+    mpz_mul(M, M, m);
+  }
+  mpz_mod(y, y, (instance->m)[0]);
+  int found = mpz_cmp(y, instance->s) == 0;
+  mpz_clear(y);
+  mpz_clear(M);
+  mpz_clear(c);
+  mpz_clear(inv);
+  return found;
+}
+
+// enrolls k participants one at a time into a (t,n) instance, compares that
+// with generating all n + k shares, and recovers from the last t participants
+static void time_enroll(int t, int n, int lambda, int k, struct thread_pool *pool)
+{
+  struct asmuth_bloom *instance = init_asmuth_bloom_instance(t, n, lambda);
+  set_asmuth_bloom_thread_pool(instance, pool);
+  generate_asmuth_bloom_secret(instance);
+  generate_asmuth_bloom_shares(instance);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < k; i++)
+  {
+    add_asmuth_bloom_participants(instance, 1);
+  }
+  double enroll = seconds_since(&start);
+
+  struct asmuth_bloom *full = init_asmuth_bloom_instance(t, instance->n, lambda);
+  set_asmuth_bloom_thread_pool(full, pool);
+  generate_asmuth_bloom_secret(full);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  generate_asmuth_bloom_shares(full);
+  double regenerate = seconds_since(&start);
+
+  printf("%d participants added: %.3f ms each, all %d shares generated in %.3f ms\n", k, enroll * 1000 / k,
+         full->n, regenerate * 1000);
+  printf("Secret recovered from the last %d participants: %d\n", t, recover_from(instance, instance->n - t));
+
+  free_asmuth_bloom_instance(full);
+  free_asmuth_bloom_instance(instance);
+}
+
+// recovers a (t,n) instance's secret from its last k participants, reusing one
+// set of constants, and compares that with the CRT from scratch
+static void time_recovery(int t, int n, int lambda, int k)
+{
+  if (k < t || k > n)
+  {
+    printf("A quorum of %d is not between t = %d and n = %d.\n", k, t, n);
+    return;
+  }
+  struct asmuth_bloom *instance = init_asmuth_bloom_instance(t, n, lambda);
+  generate_asmuth_bloom_secret(instance);
+  generate_asmuth_bloom_shares(instance);
+
+  int *x = (int *)malloc(k * sizeof(int));
+  for (int j = 0; j < k; j++)
+  {
+    x[j] = n - k + 1 + j;
+  }
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct asmuth_bloom_recovery *context = init_asmuth_bloom_recovery(instance, x, k);
+  double setup = seconds_since(&start);
+
+  int rounds = 100, found = 1;
+  mpz_t secret;
+  mpz_init(secret);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int r = 0; r < rounds; r++)
+  {
+    asmuth_bloom_recover_with(secret, context, instance->shares + n - k);
+    found &= mpz_cmp(secret, instance->s) == 0;
+  }
+  double with = seconds_since(&start) / rounds;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int r = 0; r < rounds; r++)
+  {
+    found &= recover_from(instance, n - k);
+  }
+  double plain = seconds_since(&start) / rounds;
+
+  printf("%s constants for %d shares in %.3f ms, then %.3f ms per recovery, %.3f ms without\n",
+         context->tree != NULL ? "Product tree" : "Garner", k, setup * 1000, with * 1000, plain * 1000);
+  printf("Secret recovered: %d\n", found);
+
+  mpz_clear(secret);
+  free_asmuth_bloom_recovery(context);
+  free(x);
+  free_asmuth_bloom_instance(instance);
+}
+
+// best of RNS_RUNS fresh (t,n) instances on engine: share generation and
+// recovery by participants 1 ... t, the RNG seeded and the moduli set up
+// outside of the timings. Returns whether every run recovered its secret.
+#define RNS_RUNS 5
+static int time_rns_engine(int t, int n, int lambda, enum rns_engine engine, struct thread_pool *pool,
+                           double *shares, double *recovery)
+{
+  int found = 1;
+  for (int run = 0; run < RNS_RUNS; run++)
+  {
+    struct timespec start;
+    struct rns_asmuth_bloom *instance = init_rns_instance(t, n, lambda);
+    set_rns_engine(instance, engine);
+    set_rns_thread_pool(instance, pool);
+    generate_rns_secret(instance);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    generate_rns_shares(instance);
+    double share = seconds_since(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    found &= rns_recover_secret(instance);
+    double recover = seconds_since(&start);
+    if (run == 0 || share < *shares)
+    {
+      *shares = share;
+    }
+    if (run == 0 || recover < *recovery)
+    {
+      *recovery = recover;
+    }
+
+    // the other engine has to read the same residues
+    set_rns_engine(instance, engine == RNS_GMP ? RNS_SIMD : RNS_GMP);
+    found &= rns_recover_secret(instance);
+    free_rns_instance(instance);
+  }
+  return found;
+}
+
+// generates and recovers the shares of a (t,n) instance on the lane kernels,
+// on GMP and on whichever RNS_AUTO picks; all three do the same work, from
+// drawing alpha to the residues and from the residues to the secret
+static void time_rns(int t, int n, int lambda, struct thread_pool *pool)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct rns_asmuth_bloom *instance = init_rns_instance(t, n, lambda);
+  double setup = seconds_since(&start);
+  int c = instance->c;
+  free_rns_instance(instance);
+
+  double shares[3], recovery[3];
+  int found = time_rns_engine(t, n, lambda, RNS_SIMD, pool, &shares[0], &recovery[0]);
+  found &= time_rns_engine(t, n, lambda, RNS_GMP, pool, &shares[1], &recovery[1]);
+  found &= time_rns_engine(t, n, lambda, RNS_AUTO, pool, &shares[2], &recovery[2]);
+
+  printf("%s kernels, %d primes of %d bits per participant, chosen in %.3f ms\n", rns_kernel_name(), c,
+         RNS_PRIME_BITS, setup * 1000);
+  printf("Shares generated in %.3f ms, %.3f ms with GMP, %.3f ms picked automatically\n", shares[0] * 1000,
+         shares[1] * 1000, shares[2] * 1000);
+  printf("Secret recovered in %.3f ms, %.3f ms with GMP, %.3f ms picked automatically\n", recovery[0] * 1000,
+         recovery[1] * 1000, recovery[2] * 1000);
+  printf("Secret recovered: %d\n", found);
+}
+
+// generates the shares of a (t,n) instance with the moduli searched and with
+// the moduli from the table at path, building the table first if there is none
+static void time_table(int t, int n, int lambda, const char *path, struct thread_pool *pool)
+{
+  struct timespec start;
+  struct moduli_table *table = open_moduli_table(path);
+  if (table == NULL)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!build_moduli_table(path, lambda, n, pool))
+    {
+      return;
+    }
+    printf("Moduli table for n = %d built in %.3f ms\n", n, seconds_since(&start) * 1000);
+    table = open_moduli_table(path);
+  }
+
+  struct asmuth_bloom *searched = init_asmuth_bloom_instance(t, n, lambda);
+  set_asmuth_bloom_thread_pool(searched, pool);
+  generate_asmuth_bloom_secret(searched);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  generate_asmuth_bloom_shares(searched);
+  double search = seconds_since(&start);
+
+  struct asmuth_bloom *instance = init_asmuth_bloom_instance(t, n, lambda);
+  set_asmuth_bloom_thread_pool(instance, pool);
+  set_moduli_table(instance, table);
+  generate_asmuth_bloom_secret(instance);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  generate_asmuth_bloom_shares(instance);
+  double mapped = seconds_since(&start);
+
+  // the product tree of the table's m_1 ... m_n, kept for later instances
+  mpz_t *m = (mpz_t *)malloc(n * sizeof(mpz_t));
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init(m[i]);
+    get_modulus(m[i], table, i + 1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct product_tree *tree = build_moduli_tree(m, n, pool);
+  double build = seconds_since(&start);
+
+  struct asmuth_bloom *cached = init_asmuth_bloom_instance(t, n, lambda);
+  set_asmuth_bloom_thread_pool(cached, pool);
+  set_moduli_table(cached, table);
+  set_product_tree(cached, tree);
+  generate_asmuth_bloom_secret(cached);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  generate_asmuth_bloom_shares(cached);
+  double reduced = seconds_since(&start);
+
+  printf("Shares generated in %.3f ms searching the moduli, %.3f ms with the table\n", search * 1000, mapped * 1000);
+  printf("Product tree built in %.3f ms, shares generated in %.3f ms with the table and tree\n", build * 1000,
+         reduced * 1000);
+  printf("Secret recovered: %d %d\n", recover_asmuth_bloom_secret(instance), recover_asmuth_bloom_secret(cached));
+
+  for (int i = 0; i < n; i++)
+  {
+    mpz_clear(m[i]);
+  }
+  free(m);
+  free_moduli_tree(tree);
+  free_asmuth_bloom_instance(searched);
+  free_asmuth_bloom_instance(instance);
+  free_asmuth_bloom_instance(cached);
+  close_moduli_table(table);
+}
 
 int main(int argc, char *argv[])
 {
@@ -22,17 +280,61 @@ int main(int argc, char *argv[])
   else
   {
     printf("Must input a threshold, number of parties, and security parameter.\n");
+    printf("An optional fourth argument is the number of share generation threads, 0 for one per processor.\n");
+    printf("With \"enroll\" and a count k as fourth and fifth arguments, times adding k participants one at a time.\n");
+    printf("With \"table\" and a path as fourth and fifth arguments, times share generation with a moduli table.\n");
+    printf("With \"recover\" and a quorum size k as fourth and fifth arguments, times recovery with precomputed constants.\n");
+    printf("With \"rns\" as fourth argument, times the residue number system engine, optionally on [threads].\n");
     exit(EXIT_FAILURE);
   }
 
-  instance = init_instance(t, n, lambda);
-  generate_secret(instance);
-  generate_shares(instance);
-  printf("Secret recovered: %d\n", recover_secret(instance));
+  if (argc > 5 && strcmp(argv[4], "enroll") == 0)
+  {
+    struct thread_pool *pool = argc > 6 ? start_thread_pool((int)strtol(argv[6], NULL, 10)) : NULL;
+    time_enroll(t, n, lambda, (int)strtol(argv[5], NULL, 10), pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+
+  if (argc > 4 && strcmp(argv[4], "rns") == 0)
+  {
+    struct thread_pool *pool = argc > 5 ? start_thread_pool((int)strtol(argv[5], NULL, 10)) : NULL;
+    time_rns(t, n, lambda, pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+
+  if (argc > 5 && strcmp(argv[4], "recover") == 0)
+  {
+    time_recovery(t, n, lambda, (int)strtol(argv[5], NULL, 10));
+    return 0;
+  }
+
+  if (argc > 5 && strcmp(argv[4], "table") == 0)
+  {
+    struct thread_pool *pool = argc > 6 ? start_thread_pool((int)strtol(argv[6], NULL, 10)) : NULL;
+    time_table(t, n, lambda, argv[5], pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+
+  instance = init_asmuth_bloom_instance(t, n, lambda);
+
+  struct thread_pool *pool = NULL;
+  if (argc > 4)
+  {
+    pool = start_thread_pool((int)strtol(argv[4], NULL, 10));
+    set_asmuth_bloom_thread_pool(instance, pool);
+  }
+
+  generate_asmuth_bloom_secret(instance);
+  generate_asmuth_bloom_shares(instance);
+  printf("Secret recovered: %d\n", recover_asmuth_bloom_secret(instance));
 
-  // print_instance(instance);
+  // print_asmuth_bloom_instance(instance);
 
-  free_instance(instance);
+  free_asmuth_bloom_instance(instance);
+  stop_thread_pool(pool);
 
   return 0;
 }
@@ -0,0 +1,162 @@
+#define _DEFAULT_SOURCE
+#include "moduli.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Checks that m_0 < m_1 < ... < m_n and that for every threshold t
+// m_0 * m_(n-t+2) * ... * m_n < m_1 * ... * m_t, growing both products one
+// factor per threshold.
+static int check_chain(mpz_t *m, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (mpz_cmp(m[i], m[i + 1]) >= 0)
+    {
+      return 0;
+    }
+  }
+
+  int fits = 1;
+  mpz_t lhs, rhs;
+  mpz_init_set(lhs, m[0]);
+  mpz_init_set(rhs, m[1]);
+  for (int t = 2; t <= n && fits; t++)
+  {
+    mpz_mul(lhs, lhs, m[n - t + 2]);
+    mpz_mul(rhs, rhs, m[t]);
+    fits = mpz_cmp(lhs, rhs) < 0;
+  }
+  mpz_clear(lhs);
+  mpz_clear(rhs);
+  return fits;
+}
+
+// Builds the table of m_0 ... m_n for lambda and writes it to path, searching
+// the primes on pool's threads (NULL for serial). Returns 1 on success.
+int build_moduli_table(const char *path, int lambda, int n, struct thread_pool *pool)
+{
+  if (lambda < 64 || lambda > 512 || n < 2 || n > 1000)
+  {
+    printf("Moduli table for n = %d and security %d is not valid.\n", n, lambda);
+    return 0;
+  }
+
+  mpz_t bound;
+  mpz_t *m = (mpz_t *)malloc((n + 1) * sizeof(mpz_t));
+  for (int i = 0; i <= n; i++)
+  {
+    mpz_init(m[i]);
+  }
+  mpz_init(bound);
+  mpz_setbit(bound, (mp_bitcnt_t)lambda);
+  get_next_prime(&(m[0]), bound, lambda);
+  mpz_mul_2exp(bound, m[0], 1);
+  next_primes(m + 1, n, bound, lambda, pool);
+
+  int ok = check_chain(m, n);
+  if (!ok)
+  {
+    printf("Moduli chain for n = %d and security %d breaks the Asmuth-Bloom condition.\n", n, lambda);
+  }
+
+  FILE *file = ok ? fopen(path, "wb") : NULL;
+  if (ok && file == NULL)
+  {
+    printf("Cannot write moduli table %s.\n", path);
+    ok = 0;
+  }
+  if (ok)
+  {
+    struct moduli_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODULI_MAGIC, sizeof(header.magic));
+    header.version = MODULI_VERSION;
+    header.lambda = lambda;
+    header.n = n;
+    header.limbs = (int32_t)mpz_size(m[n]);
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    mp_limb_t *entry = (mp_limb_t *)malloc(header.limbs * sizeof(mp_limb_t));
+    for (int i = 0; i <= n && ok; i++)
+    {
+      size_t size = mpz_size(m[i]);
+      memcpy(entry, mpz_limbs_read(m[i]), size * sizeof(mp_limb_t));
+      memset(entry + size, 0, (header.limbs - size) * sizeof(mp_limb_t));
+      ok = fwrite(entry, sizeof(mp_limb_t), header.limbs, file) == (size_t)header.limbs;
+    }
+    free(entry);
+    ok &= fclose(file) == 0;
+    if (!ok)
+    {
+      printf("Cannot write moduli table %s.\n", path);
+    }
+  }
+
+  for (int i = 0; i <= n; i++)
+  {
+    mpz_clear(m[i]);
+  }
+  free(m);
+  mpz_clear(bound);
+  return ok;
+}
+
+// Maps the table at path read-only. Returns NULL if it cannot be read or is
+// not a moduli table.
+struct moduli_table *open_moduli_table(const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct moduli_header))
+  {
+    close(fd);
+    printf("Moduli table %s is too short.\n", path);
+    return NULL;
+  }
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    printf("Cannot map moduli table %s.\n", path);
+    return NULL;
+  }
+
+  const struct moduli_header *header = (const struct moduli_header *)map;
+  size_t expected = sizeof(struct moduli_header) + (size_t)(header->n + 1) * header->limbs * sizeof(mp_limb_t);
+  if (memcmp(header->magic, MODULI_MAGIC, sizeof(header->magic)) != 0 || header->version != MODULI_VERSION ||
+      header->n < 2 || header->limbs < 1 || (size_t)st.st_size != expected)
+  {
+    munmap(map, (size_t)st.st_size);
+    printf("%s is not a moduli table.\n", path);
+    return NULL;
+  }
+
+  struct moduli_table *table = (struct moduli_table *)malloc(1 * sizeof(struct moduli_table));
+  table->lambda = header->lambda;
+  table->n = header->n;
+  table->limbs = header->limbs;
+  table->m = (const mp_limb_t *)((const char *)map + sizeof(struct moduli_header));
+  table->map = map;
+  table->size = (size_t)st.st_size;
+  return table;
+}
+
+void close_moduli_table(struct moduli_table *table)
+{
+  munmap(table->map, table->size);
+  free(table);
+}
+
+// r = m_i from the table, 0 <= i <= table->n
+void get_modulus(mpz_t r, const struct moduli_table *table, int i)
+{
+  mpz_t view;
+  mpz_roinit_n(view, table->m + (size_t)i * table->limbs, table->limbs);
+  mpz_set(r, view);
+}
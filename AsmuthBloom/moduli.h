@@ -0,0 +1,49 @@
+// Precomputed Asmuth-Bloom moduli chains in memory-mapped files.
+//
+// With m_0 the next prime after 2^lambda, above every lambda bit secret, the
+// chain m_0 < m_1 < ... < m_n only depends on lambda and n, and the chain for
+// n is the first n + 1 entries of any longer one. A table file holds it as a
+// header followed by n + 1 entries of the same number of native-endian limbs,
+// m_i at limb i * limbs, so it is mapped read-only and shared by every
+// process that opens it, and an instance that uses it does no prime search.
+// The Asmuth-Bloom condition is checked for every threshold when the table is
+// built.
+#ifndef ASMUTH_BLOOM_MODULI_HEADER
+#define ASMUTH_BLOOM_MODULI_HEADER
+
+#include <gmp.h>
+#include <stdint.h>
+#include "asmuthbloom.h"
+#include "../common/visibility.h"
+
+#define MODULI_MAGIC "ABMODULI"
+#define MODULI_VERSION 1
+
+struct moduli_header
+{
+  char magic[8];
+  uint32_t version;
+  int32_t lambda;
+  int32_t n;     // the file holds m_0 ... m_n
+  int32_t limbs; // limbs per entry
+};
+
+struct moduli_table
+{
+  int lambda;
+  int n;
+  int limbs;
+  const mp_limb_t *m; // m_i is m[i * limbs ... (i + 1) * limbs - 1]
+  void *map;
+  size_t size;
+};
+
+SECRET_SHARING_API int build_moduli_table(const char *, int, int, struct thread_pool *);
+
+SECRET_SHARING_API struct moduli_table *open_moduli_table(const char *);
+
+SECRET_SHARING_API void close_moduli_table(struct moduli_table *);
+
+SECRET_SHARING_API void get_modulus(mpz_t, const struct moduli_table *, int);
+
+#endif
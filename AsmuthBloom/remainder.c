@@ -0,0 +1,297 @@
+#include "remainder.h"
+
+static int is_leaf(const struct product_tree *tree, int k)
+{
+  return (tree->hi)[k] - (tree->lo)[k] <= PRODUCT_TREE_LEAF;
+}
+
+static void layout_node(struct product_tree *tree, int k, int lo, int hi)
+{
+  (tree->lo)[k] = lo;
+  (tree->hi)[k] = hi;
+  if (!is_leaf(tree, k))
+  {
+    int mid = (lo + hi) / 2;
+    layout_node(tree, 2 * k + 1, lo, mid);
+    layout_node(tree, 2 * k + 2, mid, hi);
+  }
+}
+
+// the threads split the tree below this many levels, about 4 subtrees each
+static int split_depth(const struct thread_pool *pool)
+{
+  int depth = 0;
+  if (pool != NULL)
+  {
+    while ((1 << depth) < 4 * pool->threads)
+    {
+      depth++;
+    }
+  }
+  return depth;
+}
+
+// roots of the subtrees below depth levels, left to right
+static void collect_subtrees(const struct product_tree *tree, int k, int depth, int *list, int *count)
+{
+  if (depth == 0 || is_leaf(tree, k))
+  {
+    list[(*count)++] = k;
+    return;
+  }
+  collect_subtrees(tree, 2 * k + 1, depth - 1, list, count);
+  collect_subtrees(tree, 2 * k + 2, depth - 1, list, count);
+}
+
+static void multiply_node(struct product_tree *tree, int k)
+{
+  if (is_leaf(tree, k))
+  {
+    mpz_set((tree->node)[k], (tree->m)[(tree->lo)[k]]);
+    for (int i = (tree->lo)[k] + 1; i < (tree->hi)[k]; i++)
+    {
+      mpz_mul((tree->node)[k], (tree->node)[k], (tree->m)[i]);
+    }
+    return;
+  }
+  multiply_node(tree, 2 * k + 1);
+  multiply_node(tree, 2 * k + 2);
+  mpz_mul((tree->node)[k], (tree->node)[2 * k + 1], (tree->node)[2 * k + 2]);
+}
+
+// the nodes above the split, once the subtrees are done
+static void multiply_top(struct product_tree *tree, int k, int depth)
+{
+  if (depth == 0 || is_leaf(tree, k))
+  {
+    return;
+  }
+  multiply_top(tree, 2 * k + 1, depth - 1);
+  multiply_top(tree, 2 * k + 2, depth - 1);
+  mpz_mul((tree->node)[k], (tree->node)[2 * k + 1], (tree->node)[2 * k + 2]);
+}
+
+struct tree_job
+{
+  struct product_tree *tree;
+  const int *list; // roots of the subtrees
+  mpz_t *rem;      // the value reduced by each subtree's root
+  mpz_t *out;
+};
+
+static void multiply_range(void *arg, int begin, int end)
+{
+  struct tree_job *job = (struct tree_job *)arg;
+  for (int j = begin; j < end; j++)
+  {
+    multiply_node(job->tree, (job->list)[j]);
+  }
+}
+
+// Builds the product tree of m[0 ... n-1], splitting the subtrees across
+// pool's threads (NULL for serial).
+struct product_tree *build_moduli_tree(const mpz_t *m, int n, struct thread_pool *pool)
+{
+  struct product_tree *tree = (struct product_tree *)malloc(1 * sizeof(struct product_tree));
+  // a heap over at most 2n/PRODUCT_TREE_LEAF + 1 leaves never needs more
+  // than 4 times that many slots
+  tree->n = n;
+  tree->nodes = 4 * (2 * (n / PRODUCT_TREE_LEAF) + 1);
+  tree->lo = (int *)calloc(tree->nodes, sizeof(int));
+  tree->hi = (int *)calloc(tree->nodes, sizeof(int));
+  tree->m = (mpz_t *)malloc(n * sizeof(mpz_t));
+  tree->node = (mpz_t *)malloc(tree->nodes * sizeof(mpz_t));
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init_set((tree->m)[i], m[i]);
+  }
+  for (int k = 0; k < tree->nodes; k++)
+  {
+    mpz_init((tree->node)[k]);
+  }
+  layout_node(tree, 0, 0, n);
+
+  int depth = split_depth(pool);
+  int *list = (int *)malloc((1 << depth) * sizeof(int));
+  int count = 0;
+  collect_subtrees(tree, 0, depth, list, &count);
+
+  struct tree_job job;
+  job.tree = tree;
+  job.list = list;
+  thread_pool_run(pool, count, multiply_range, &job);
+  multiply_top(tree, 0, depth);
+
+  free(list);
+  return tree;
+}
+
+void free_moduli_tree(struct product_tree *tree)
+{
+  for (int i = 0; i < tree->n; i++)
+  {
+    mpz_clear((tree->m)[i]);
+  }
+  for (int k = 0; k < tree->nodes; k++)
+  {
+    mpz_clear((tree->node)[k]);
+  }
+  free(tree->m);
+  free(tree->node);
+  free(tree->lo);
+  free(tree->hi);
+  free(tree);
+}
+
+// r is already reduced by node k, out[i] = r mod m[i] for the node's moduli
+static void reduce_node(mpz_t *out, const mpz_t r, const struct product_tree *tree, int k)
+{
+  if (is_leaf(tree, k))
+  {
+    for (int i = (tree->lo)[k]; i < (tree->hi)[k]; i++)
+    {
+      mpz_tdiv_r(out[i], r, (tree->m)[i]);
+    }
+    return;
+  }
+  mpz_t child;
+  mpz_init(child);
+  for (int c = 2 * k + 1; c <= 2 * k + 2; c++)
+  {
+    mpz_tdiv_r(child, r, (tree->node)[c]);
+    reduce_node(out, child, tree, c);
+  }
+  mpz_clear(child);
+}
+
+// the nodes above the split, leaving r reduced by each subtree's root in rem
+static void reduce_top(mpz_t *rem, int *count, const mpz_t r, const struct product_tree *tree, int k, int depth)
+{
+  if (depth == 0 || is_leaf(tree, k))
+  {
+    mpz_set(rem[(*count)++], r);
+    return;
+  }
+  mpz_t child;
+  mpz_init(child);
+  for (int c = 2 * k + 1; c <= 2 * k + 2; c++)
+  {
+    mpz_tdiv_r(child, r, (tree->node)[c]);
+    reduce_top(rem, count, child, tree, c, depth - 1);
+  }
+  mpz_clear(child);
+}
+
+static void reduce_range(void *arg, int begin, int end)
+{
+  struct tree_job *job = (struct tree_job *)arg;
+  for (int j = begin; j < end; j++)
+  {
+    reduce_node(job->out, (job->rem)[j], job->tree, (job->list)[j]);
+  }
+}
+
+// out[i] = y mod m[i] for every modulus of the tree, y >= 0, splitting the
+// subtrees across pool's threads (NULL for serial).
+void remainder_tree(mpz_t *out, const mpz_t y, const struct product_tree *tree, struct thread_pool *pool)
+{
+  int depth = split_depth(pool);
+  int *list = (int *)malloc((1 << depth) * sizeof(int));
+  mpz_t *rem = (mpz_t *)malloc((1 << depth) * sizeof(mpz_t));
+  int count = 0;
+  collect_subtrees(tree, 0, depth, list, &count);
+  for (int j = 0; j < count; j++)
+  {
+    mpz_init(rem[j]);
+  }
+
+  mpz_t r;
+  mpz_init(r);
+  mpz_tdiv_r(r, y, (tree->node)[0]);
+  int reduced = 0;
+  reduce_top(rem, &reduced, r, tree, 0, depth);
+
+  struct tree_job job;
+  job.tree = (struct product_tree *)tree;
+  job.list = list;
+  job.rem = rem;
+  job.out = out;
+  thread_pool_run(pool, count, reduce_range, &job);
+
+  for (int j = 0; j < count; j++)
+  {
+    mpz_clear(rem[j]);
+  }
+  mpz_clear(r);
+  free(rem);
+  free(list);
+}
+
+// r = M mod node[k]^2, where M / m[i] mod m[i] = (M mod m[i]^2) / m[i]
+static void cofactor_node(mpz_t *c, const mpz_t r, const struct product_tree *tree, int k)
+{
+  mpz_t child, square;
+  mpz_init(child);
+  mpz_init(square);
+  if (is_leaf(tree, k))
+  {
+    for (int i = (tree->lo)[k]; i < (tree->hi)[k]; i++)
+    {
+      mpz_mul(square, (tree->m)[i], (tree->m)[i]);
+      mpz_tdiv_r(child, r, square);
+      mpz_divexact(child, child, (tree->m)[i]);
+      mpz_invert(c[i], child, (tree->m)[i]);
+    }
+  }
+  else
+  {
+    for (int j = 2 * k + 1; j <= 2 * k + 2; j++)
+    {
+      mpz_mul(square, (tree->node)[j], (tree->node)[j]);
+      mpz_tdiv_r(child, r, square);
+      cofactor_node(c, child, tree, j);
+    }
+  }
+  mpz_clear(child);
+  mpz_clear(square);
+}
+
+// c[i] = (M / m[i])^-1 mod m[i], M the product of the tree's moduli, which
+// have to be pairwise coprime
+void cofactor_inverses(mpz_t *c, const struct product_tree *tree)
+{
+  cofactor_node(c, (tree->node)[0], tree, 0);
+}
+
+// y = sum w[i] * node[k] / m[i] over the node's moduli
+static void combine_node(mpz_t y, const mpz_t *w, const struct product_tree *tree, int k)
+{
+  if (is_leaf(tree, k))
+  {
+    mpz_t cofactor;
+    mpz_init(cofactor);
+    mpz_set_ui(y, (unsigned long int)0);
+    for (int i = (tree->lo)[k]; i < (tree->hi)[k]; i++)
+    {
+      mpz_divexact(cofactor, (tree->node)[k], (tree->m)[i]);
+      mpz_addmul(y, w[i], cofactor);
+    }
+    mpz_clear(cofactor);
+    return;
+  }
+  mpz_t right;
+  mpz_init(right);
+  combine_node(y, w, tree, 2 * k + 1);
+  combine_node(right, w, tree, 2 * k + 2);
+  mpz_mul(y, y, (tree->node)[2 * k + 2]);
+  mpz_addmul(y, right, (tree->node)[2 * k + 1]);
+  mpz_clear(right);
+}
+
+// y = sum w[i] * M / m[i], M the product of the tree's moduli. With
+// w[i] = r[i] * c[i] mod m[i] from cofactor_inverses, y mod M is the number
+// that leaves r[i] mod every m[i].
+void crt_combine(mpz_t y, const mpz_t *w, const struct product_tree *tree)
+{
+  combine_node(y, w, tree, 0);
+}
@@ -0,0 +1,50 @@
+// Product and remainder trees over the Asmuth-Bloom moduli.
+//
+// y = s + alpha * m_0 has about t moduli's worth of limbs, so reducing it by
+// each of the n moduli separately costs about n t divisions of a limb by a
+// limb. The product tree holds the products of the moduli over halving
+// ranges. y is reduced by the root and each remainder by the two children,
+// so the operands shrink with the ranges and every level is a handful of
+// balanced divisions that GMP does in subquadratic time. The tree only
+// depends on the moduli, so one built for a moduli table serves every
+// instance that uses the table.
+//
+// The same tree runs the Chinese remainder theorem the other way for large
+// quorums: with M the product of the moduli, y = sum w[i] M / m[i] is put
+// together bottom up, each node as left * right's product + right * left's.
+#ifndef ASMUTH_BLOOM_REMAINDER_HEADER
+#define ASMUTH_BLOOM_REMAINDER_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include "../common/threadpool.h"
+#include "../common/visibility.h"
+
+// below this many moduli a node is a leaf and reduces by each modulus
+#define PRODUCT_TREE_LEAF 8
+
+// generate_asmuth_bloom_shares goes through a product tree from this threshold on
+#define REMAINDER_TREE_THRESHOLD 64
+
+// node[0] is the root, the children of node[k] are node[2k+1] and node[2k+2]
+struct product_tree
+{
+  int n;        // number of moduli
+  int nodes;    // number of node slots
+  int *lo;      // node k covers moduli lo[k] ... hi[k]-1
+  int *hi;
+  mpz_t *m;     // the moduli
+  mpz_t *node;  // node[k] = m[lo[k]] * ... * m[hi[k]-1]
+};
+
+SECRET_SHARING_API struct product_tree *build_moduli_tree(const mpz_t *, int, struct thread_pool *);
+
+SECRET_SHARING_API void free_moduli_tree(struct product_tree *);
+
+void remainder_tree(mpz_t *, const mpz_t, const struct product_tree *, struct thread_pool *);
+
+void cofactor_inverses(mpz_t *, const struct product_tree *);
+
+void crt_combine(mpz_t, const mpz_t *, const struct product_tree *);
+
+#endif
@@ -0,0 +1,798 @@
+#include "rns.h"
+#include <immintrin.h>
+#include <pthread.h>
+
+#define UNROLL _Pragma("GCC unroll 8")
+
+// independent vectors the share kernels keep in flight, to cover the latency
+// of the three dependent products of a Montgomery step
+#define RNS_CHAINS 8
+
+// All lane arithmetic is Montgomery with R = 2^32 for primes p in
+// (2^30, 2^31): redc(T) = T / 2^32 mod p for T < p 2^32, and since 2p and 4p
+// stay below 2^33, a 32 bit word is brought below p by two conditional
+// subtractions, done as unsigned minimums with the wrapped differences.
+
+static inline uint32_t redc(uint64_t T, uint32_t p, uint32_t pinv)
+{
+  uint32_t m = (uint32_t)T * pinv;
+  uint64_t u = (T + (uint64_t)m * p) >> 32;
+  return (uint32_t)(u >= p ? u - p : u);
+}
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b)
+{
+  return a < b ? a : b;
+}
+
+// r[j] = y mod p[j] for count primes, y given as words 32 bit words. acc goes
+// acc * 2^32 + w from the top word down, with acc * 2^32 = redc(acc * 2^64).
+static void reduce_scalar(uint32_t *r, const uint32_t *y, int words, const uint32_t *p, const uint32_t *pinv,
+                          const uint32_t *r2, int count)
+{
+  for (int j = 0; j < count; j++)
+  {
+    uint32_t acc = 0;
+    for (int w = words - 1; w >= 0; w--)
+    {
+      uint32_t word = min_u32(y[w], y[w] - 2 * p[j]);
+      word = min_u32(word, word - p[j]);
+      acc = redc((uint64_t)acc * r2[j], p[j], pinv[j]) + word;
+      acc = min_u32(acc, acc - p[j]);
+    }
+    r[j] = acc;
+  }
+}
+
+// acc[j] -= v * Q_j and q[j] = Q_j * pi mod p[j] for count primes, where q[j]
+// holds Q_j * 2^32 mod p[j]
+static void garner_scalar(uint32_t *acc, uint32_t *q, const uint32_t *p, const uint32_t *pinv, const uint32_t *r2,
+                          int count, uint32_t v, uint32_t pi)
+{
+  for (int j = 0; j < count; j++)
+  {
+    uint32_t d = acc[j] - redc((uint64_t)v * q[j], p[j], pinv[j]);
+    acc[j] = min_u32(d, d + p[j]);
+    uint32_t plain = redc((uint64_t)q[j] * pi, p[j], pinv[j]);
+    q[j] = redc((uint64_t)plain * r2[j], p[j], pinv[j]);
+  }
+}
+
+// The vector kernels hold one prime per 64 bit lane, which is what the
+// 32 x 32 -> 64 bit lane products take.
+
+__attribute__((target("avx2"))) static inline __m256i redc_avx2(__m256i T, __m256i p, __m256i pinv)
+{
+  __m256i m = _mm256_mul_epu32(T, pinv);
+  __m256i u = _mm256_srli_epi64(_mm256_add_epi64(T, _mm256_mul_epu32(m, p)), 32);
+  return _mm256_min_epu32(u, _mm256_sub_epi32(u, p));
+}
+
+__attribute__((target("avx2"))) static inline __m256i load_avx2(const uint32_t *a)
+{
+  return _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)a));
+}
+
+__attribute__((target("avx2"))) static inline void store_avx2(uint32_t *r, __m256i a)
+{
+  __m256i packed = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+  _mm_storeu_si128((__m128i *)r, _mm256_castsi256_si128(packed));
+}
+
+__attribute__((target("avx2"))) static void reduce_avx2(uint32_t *r, const uint32_t *y, int words, const uint32_t *p,
+                                                        const uint32_t *pinv, const uint32_t *r2, int count)
+{
+  int j = 0;
+  for (; j + 4 * RNS_CHAINS <= count; j += 4 * RNS_CHAINS)
+  {
+    __m256i pj[RNS_CHAINS], ij[RNS_CHAINS], sj[RNS_CHAINS], dj[RNS_CHAINS], a[RNS_CHAINS];
+    UNROLL
+    for (int k = 0; k < RNS_CHAINS; k++)
+    {
+      pj[k] = load_avx2(p + j + 4 * k);
+      ij[k] = load_avx2(pinv + j + 4 * k);
+      sj[k] = load_avx2(r2 + j + 4 * k);
+      dj[k] = _mm256_add_epi32(pj[k], pj[k]);
+      a[k] = _mm256_setzero_si256();
+    }
+    for (int w = words - 1; w >= 0; w--)
+    {
+      __m256i word = _mm256_set1_epi64x((long long)y[w]);
+      UNROLL
+      for (int k = 0; k < RNS_CHAINS; k++)
+      {
+        __m256i wk = _mm256_min_epu32(word, _mm256_sub_epi32(word, dj[k]));
+        wk = _mm256_min_epu32(wk, _mm256_sub_epi32(wk, pj[k]));
+        a[k] = _mm256_add_epi32(redc_avx2(_mm256_mul_epu32(a[k], sj[k]), pj[k], ij[k]), wk);
+        a[k] = _mm256_min_epu32(a[k], _mm256_sub_epi32(a[k], pj[k]));
+      }
+    }
+    UNROLL
+    for (int k = 0; k < RNS_CHAINS; k++)
+    {
+      store_avx2(r + j + 4 * k, a[k]);
+    }
+  }
+  reduce_scalar(r + j, y, words, p + j, pinv + j, r2 + j, count - j);
+}
+
+__attribute__((target("avx2"))) static void garner_avx2(uint32_t *acc, uint32_t *q, const uint32_t *p,
+                                                        const uint32_t *pinv, const uint32_t *r2, int count, uint32_t v,
+                                                        uint32_t pi)
+{
+  __m256i vv = _mm256_set1_epi64x((long long)v);
+  __m256i vp = _mm256_set1_epi64x((long long)pi);
+  int j = 0;
+  for (; j + 4 <= count; j += 4)
+  {
+    __m256i pj = load_avx2(p + j), ij = load_avx2(pinv + j), sj = load_avx2(r2 + j);
+    __m256i qj = load_avx2(q + j), aj = load_avx2(acc + j);
+    __m256i d = _mm256_sub_epi32(aj, redc_avx2(_mm256_mul_epu32(vv, qj), pj, ij));
+    aj = _mm256_min_epu32(d, _mm256_add_epi32(d, pj));
+    __m256i plain = redc_avx2(_mm256_mul_epu32(qj, vp), pj, ij);
+    qj = redc_avx2(_mm256_mul_epu32(plain, sj), pj, ij);
+    store_avx2(acc + j, aj);
+    store_avx2(q + j, qj);
+  }
+  garner_scalar(acc + j, q + j, p + j, pinv + j, r2 + j, count - j, v, pi);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i redc_avx512(__m512i T, __m512i p, __m512i pinv)
+{
+  __m512i m = _mm512_mul_epu32(T, pinv);
+  __m512i u = _mm512_srli_epi64(_mm512_add_epi64(T, _mm512_mul_epu32(m, p)), 32);
+  return _mm512_min_epu32(u, _mm512_sub_epi32(u, p));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i load_avx512(const uint32_t *a)
+{
+  return _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i *)a));
+}
+
+__attribute__((target("avx512f"))) static inline void store_avx512(uint32_t *r, __m512i a)
+{
+  _mm256_storeu_si256((__m256i *)r, _mm512_cvtepi64_epi32(a));
+}
+
+__attribute__((target("avx512f"))) static void reduce_avx512(uint32_t *r, const uint32_t *y, int words,
+                                                             const uint32_t *p, const uint32_t *pinv,
+                                                             const uint32_t *r2, int count)
+{
+  int j = 0;
+  for (; j + 8 * RNS_CHAINS <= count; j += 8 * RNS_CHAINS)
+  {
+    __m512i pj[RNS_CHAINS], ij[RNS_CHAINS], sj[RNS_CHAINS], dj[RNS_CHAINS], a[RNS_CHAINS];
+    UNROLL
+    for (int k = 0; k < RNS_CHAINS; k++)
+    {
+      pj[k] = load_avx512(p + j + 8 * k);
+      ij[k] = load_avx512(pinv + j + 8 * k);
+      sj[k] = load_avx512(r2 + j + 8 * k);
+      dj[k] = _mm512_add_epi32(pj[k], pj[k]);
+      a[k] = _mm512_setzero_si512();
+    }
+    for (int w = words - 1; w >= 0; w--)
+    {
+      __m512i word = _mm512_set1_epi64((long long)y[w]);
+      UNROLL
+      for (int k = 0; k < RNS_CHAINS; k++)
+      {
+        __m512i wk = _mm512_min_epu32(word, _mm512_sub_epi32(word, dj[k]));
+        wk = _mm512_min_epu32(wk, _mm512_sub_epi32(wk, pj[k]));
+        a[k] = _mm512_add_epi32(redc_avx512(_mm512_mul_epu32(a[k], sj[k]), pj[k], ij[k]), wk);
+        a[k] = _mm512_min_epu32(a[k], _mm512_sub_epi32(a[k], pj[k]));
+      }
+    }
+    UNROLL
+    for (int k = 0; k < RNS_CHAINS; k++)
+    {
+      store_avx512(r + j + 8 * k, a[k]);
+    }
+  }
+  reduce_avx2(r + j, y, words, p + j, pinv + j, r2 + j, count - j);
+}
+
+__attribute__((target("avx512f"))) static void garner_avx512(uint32_t *acc, uint32_t *q, const uint32_t *p,
+                                                             const uint32_t *pinv, const uint32_t *r2, int count,
+                                                             uint32_t v, uint32_t pi)
+{
+  __m512i vv = _mm512_set1_epi64((long long)v);
+  __m512i vp = _mm512_set1_epi64((long long)pi);
+  int j = 0;
+  for (; j + 8 <= count; j += 8)
+  {
+    __m512i pj = load_avx512(p + j), ij = load_avx512(pinv + j), sj = load_avx512(r2 + j);
+    __m512i qj = load_avx512(q + j), aj = load_avx512(acc + j);
+    __m512i d = _mm512_sub_epi32(aj, redc_avx512(_mm512_mul_epu32(vv, qj), pj, ij));
+    aj = _mm512_min_epu32(d, _mm512_add_epi32(d, pj));
+    __m512i plain = redc_avx512(_mm512_mul_epu32(qj, vp), pj, ij);
+    qj = redc_avx512(_mm512_mul_epu32(plain, sj), pj, ij);
+    store_avx512(acc + j, aj);
+    store_avx512(q + j, qj);
+  }
+  garner_avx2(acc + j, q + j, p + j, pinv + j, r2 + j, count - j, v, pi);
+}
+
+typedef void (*reduce_fn)(uint32_t *, const uint32_t *, int, const uint32_t *, const uint32_t *, const uint32_t *, int);
+typedef void (*garner_fn)(uint32_t *, uint32_t *, const uint32_t *, const uint32_t *, const uint32_t *, int, uint32_t,
+                          uint32_t);
+
+static reduce_fn reduce_kernel;
+static garner_fn garner_kernel;
+static const char *kernel_name;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// the widest kernels the CPU runs
+static void choose_kernels(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    kernel_name = "avx512f";
+    garner_kernel = garner_avx512;
+    reduce_kernel = reduce_avx512;
+  }
+  else if (__builtin_cpu_supports("avx2"))
+  {
+    kernel_name = "avx2";
+    garner_kernel = garner_avx2;
+    reduce_kernel = reduce_avx2;
+  }
+  else
+  {
+    kernel_name = "scalar";
+    garner_kernel = garner_scalar;
+    reduce_kernel = reduce_scalar;
+  }
+}
+
+// picks the kernels once, safely from any number of threads
+static void select_kernel(void)
+{
+  pthread_once(&kernel_once, choose_kernels);
+}
+
+const char *rns_kernel_name(void)
+{
+  select_kernel();
+  return kernel_name;
+}
+
+// The count largest primes below 2^RNS_PRIME_BITS, largest first, sieved in
+// windows by the odd primes up to 2^(RNS_PRIME_BITS / 2 + 1).
+static void largest_primes(uint32_t *out, int count)
+{
+  uint32_t limit = (uint32_t)1 << (RNS_PRIME_BITS / 2 + 1);
+  char *composite = (char *)calloc(limit, sizeof(char));
+  uint32_t *small = (uint32_t *)malloc(limit * sizeof(uint32_t));
+  int smalls = 0;
+  for (uint32_t d = 3; d < limit; d += 2)
+  {
+    if (!composite[d])
+    {
+      small[smalls++] = d;
+      for (uint32_t e = d * d; e < limit; e += 2 * d)
+      {
+        composite[e] = 1;
+      }
+    }
+  }
+  free(composite);
+
+  // window of the odd numbers hi - 2 * size + 1 ... hi - 1
+  uint32_t window = 1 << 16;
+  char *sieve = (char *)malloc(window * sizeof(char));
+  uint32_t hi = (uint32_t)1 << RNS_PRIME_BITS;
+  int found = 0;
+  while (found < count)
+  {
+    uint32_t lo = hi - 2 * window;
+    memset(sieve, 0, window);
+    for (int k = 0; k < smalls; k++)
+    {
+      // first odd multiple of small[k] at or above lo + 1
+      uint32_t d = small[k];
+      uint32_t first = (lo + 1 + d - 1) / d * d;
+      if ((first & 1) == 0)
+      {
+        first += d;
+      }
+      for (uint32_t e = first; e < hi; e += 2 * d)
+      {
+        sieve[(e - lo - 1) / 2] = 1;
+      }
+    }
+    for (int i = (int)window - 1; i >= 0 && found < count; i--)
+    {
+      if (!sieve[i])
+      {
+        out[found++] = lo + 1 + 2 * (uint32_t)i;
+      }
+    }
+    hi = lo;
+  }
+  free(sieve);
+  free(small);
+}
+
+// product of participant i's primes
+static void participant_modulus(mpz_t r, const struct rns_asmuth_bloom *instance, int i)
+{
+  mpz_set_ui(r, (unsigned long int)1);
+  for (int j = (i - 1) * instance->c; j < i * instance->c; j++)
+  {
+    mpz_mul_ui(r, r, (unsigned long int)(instance->p)[j]);
+  }
+}
+
+// M_1 > ... > M_n, so the condition is m_0 * M_1 ... M_(t-1) < M_(n-t+1) ... M_n,
+// with M_n > m_0
+static int check_rns_moduli(const struct rns_asmuth_bloom *instance)
+{
+  mpz_t lhs, rhs, modulus;
+  mpz_init_set(lhs, instance->m0);
+  mpz_init_set_ui(rhs, (unsigned long int)1);
+  mpz_init(modulus);
+  for (int i = 1; i < instance->t; i++)
+  {
+    participant_modulus(modulus, instance, i);
+    mpz_mul(lhs, lhs, modulus);
+  }
+  for (int i = instance->n - instance->t + 1; i <= instance->n; i++)
+  {
+    participant_modulus(modulus, instance, i);
+    mpz_mul(rhs, rhs, modulus);
+  }
+  int fits = mpz_cmp(lhs, rhs) < 0 && mpz_cmp(modulus, instance->m0) > 0;
+  mpz_clear(lhs);
+  mpz_clear(rhs);
+  mpz_clear(modulus);
+  return fits;
+}
+
+static void set_primes(struct rns_asmuth_bloom *instance)
+{
+  int count = instance->n * instance->c;
+  instance->p = (uint32_t *)malloc(count * sizeof(uint32_t));
+  instance->pinv = (uint32_t *)malloc(count * sizeof(uint32_t));
+  instance->r2 = (uint32_t *)malloc(count * sizeof(uint32_t));
+  largest_primes(instance->p, count);
+  for (int j = 0; j < count; j++)
+  {
+    uint32_t p = (instance->p)[j];
+    // p^-1 mod 2^32 by Newton iteration, p itself is correct to 3 bits
+    uint32_t inv = p;
+    for (int i = 0; i < 4; i++)
+    {
+      inv *= 2 - p * inv;
+    }
+    (instance->pinv)[j] = -inv;
+    uint64_t r = ((uint64_t)1 << 32) % p;
+    (instance->r2)[j] = (uint32_t)(r * r % p);
+  }
+}
+
+static void free_primes(struct rns_asmuth_bloom *instance)
+{
+  free(instance->p);
+  free(instance->pinv);
+  free(instance->r2);
+}
+
+// Picks m_0 and the primes of a (t,n) instance, the fewest primes per
+// participant that satisfy the Asmuth-Bloom condition, and seeds the
+// instance's RNG. Also keeps the moduli M_i, their product tree and the
+// product of the t largest, which every share generation needs.
+struct rns_asmuth_bloom *init_rns_instance(int t, int n, int lambda)
+{
+  if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
+  {
+    printf("Asmuth-Bloom (%d,%d) scheme with security %d is not valid.\n", t, n, lambda);
+    exit(EXIT_FAILURE);
+  }
+
+  struct rns_asmuth_bloom *instance;
+  instance = (struct rns_asmuth_bloom *)malloc(1 * sizeof(struct rns_asmuth_bloom));
+  instance->t = t;
+  instance->n = n;
+  instance->lambda = lambda;
+  instance->hasSecret = 0;
+  instance->hasShares = 0;
+  instance->shares = NULL;
+  instance->pool = NULL;
+  instance->engine = RNS_AUTO;
+
+  unsigned long int seed;
+  getrandom(&seed, sizeof(unsigned long int), GRND_RANDOM);
+  gmp_randinit_default(instance->state);
+  gmp_randseed_ui(instance->state, seed);
+
+  mpz_t bound;
+  mpz_init(bound);
+  mpz_init(instance->m0);
+  mpz_setbit(bound, (mp_bitcnt_t)lambda);
+  get_next_prime(&(instance->m0), bound, lambda);
+  mpz_clear(bound);
+
+  // every M_i has to clear m_0 by the spread of the t - 1 largest ones
+  instance->c = (lambda + 1) / (RNS_PRIME_BITS - 1) + 1;
+  set_primes(instance);
+  while (!check_rns_moduli(instance))
+  {
+    free_primes(instance);
+    instance->c++;
+    set_primes(instance);
+  }
+
+  instance->moduli = (mpz_t *)malloc(n * sizeof(mpz_t));
+  mpz_init_set_ui(instance->top, (unsigned long int)1);
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init(instance->moduli[i]);
+    participant_modulus(instance->moduli[i], instance, i + 1);
+    if (i >= n - t)
+    {
+      mpz_mul(instance->top, instance->top, instance->moduli[i]);
+    }
+  }
+  instance->tree = n >= REMAINDER_TREE_THRESHOLD ? build_moduli_tree(instance->moduli, n, NULL) : NULL;
+
+  mpz_init(instance->s);
+  mpz_init(instance->alpha);
+  return instance;
+}
+
+void free_rns_instance(struct rns_asmuth_bloom *instance)
+{
+  free_primes(instance);
+  free(instance->shares);
+  for (int i = 0; i < instance->n; i++)
+  {
+    mpz_clear(instance->moduli[i]);
+  }
+  free(instance->moduli);
+  if (instance->tree != NULL)
+  {
+    free_moduli_tree(instance->tree);
+  }
+  mpz_clear(instance->top);
+  mpz_clear(instance->m0);
+  mpz_clear(instance->s);
+  mpz_clear(instance->alpha);
+  gmp_randclear(instance->state);
+  free(instance);
+}
+
+// Splits the share residues across pool's threads. The pool is not owned by
+// the instance. NULL goes back to serial.
+void set_rns_thread_pool(struct rns_asmuth_bloom *instance, struct thread_pool *pool)
+{
+  instance->pool = pool;
+}
+
+// Runs shares and recovery on the lane kernels (RNS_SIMD), on GMP (RNS_GMP)
+// or on whichever RNS_SHARE_LIMIT and RNS_GARNER_LIMIT say is faster
+// (RNS_AUTO, the default). The shares are the same residues either way.
+void set_rns_engine(struct rns_asmuth_bloom *instance, enum rns_engine engine)
+{
+  instance->engine = engine;
+}
+
+// random secret of lambda bits
+void generate_rns_secret(struct rns_asmuth_bloom *instance)
+{
+  mpz_urandomb(instance->s, instance->state, instance->lambda);
+  instance->hasSecret = 1;
+}
+
+// whether the instance's shares go through the lane kernels
+static int simd_shares(const struct rns_asmuth_bloom *instance)
+{
+  if (instance->engine != RNS_AUTO)
+  {
+    return instance->engine == RNS_SIMD;
+  }
+  return instance->t * instance->c <= RNS_SHARE_LIMIT;
+}
+
+// whether a quorum of k recovers through Garner's algorithm on the lane kernels
+static int simd_recovery(const struct rns_asmuth_bloom *instance, int k)
+{
+  if (instance->engine != RNS_AUTO)
+  {
+    return instance->engine == RNS_SIMD;
+  }
+  return k * instance->c <= RNS_GARNER_LIMIT;
+}
+
+struct reduce_job
+{
+  struct rns_asmuth_bloom *instance;
+  const uint32_t *y;
+  int words;
+  mpz_srcptr whole; // y as a number, for GMP
+  mpz_t *rem;       // y mod M_i from the remainder tree, NULL to divide here
+};
+
+static void reduce_range(void *arg, int begin, int end)
+{
+  struct reduce_job *job = (struct reduce_job *)arg;
+  struct rns_asmuth_bloom *instance = job->instance;
+  int count = instance->n * instance->c;
+  int first = begin * RNS_BLOCK;
+  int last = end * RNS_BLOCK < count ? end * RNS_BLOCK : count;
+  reduce_kernel(instance->shares + first, job->y, job->words, instance->p + first, instance->pinv + first,
+                instance->r2 + first, last - first);
+}
+
+// shares of participants begin + 1 ... end with GMP: y mod M_i, from the
+// remainder tree or by one division, then that mod each of M_i's primes
+static void reduce_range_gmp(void *arg, int begin, int end)
+{
+  struct reduce_job *job = (struct reduce_job *)arg;
+  struct rns_asmuth_bloom *instance = job->instance;
+  int c = instance->c;
+  mpz_t r;
+  mpz_init(r);
+  for (int i = begin; i < end; i++)
+  {
+    if (job->rem != NULL)
+    {
+      mpz_set(r, job->rem[i]);
+    }
+    else
+    {
+      mpz_tdiv_r(r, job->whole, instance->moduli[i]);
+    }
+    for (int j = i * c; j < (i + 1) * c; j++)
+    {
+      (instance->shares)[j] = (uint32_t)mpz_fdiv_ui(r, (unsigned long int)(instance->p)[j]);
+    }
+  }
+  mpz_clear(r);
+}
+
+// y = s + alpha * m_0 with alpha below (M_(n-t+1) ... M_n - s) / m_0, and every
+// share residue y mod p on the instance's threads
+void generate_rns_shares(struct rns_asmuth_bloom *instance)
+{
+  if (instance->hasSecret != 1 || instance->hasShares != 0)
+  {
+    printf("Cannot generate shares on an Asmuth-Bloom instance without a secret or with shares.\n");
+    return;
+  }
+
+  mpz_t ub, y;
+  mpz_init(ub);
+  mpz_init(y);
+  mpz_sub(ub, instance->top, instance->s);
+  mpz_cdiv_q(ub, ub, instance->m0);
+  mpz_urandomm(instance->alpha, instance->state, ub);
+  mpz_set(y, instance->s);
+  mpz_addmul(y, instance->alpha, instance->m0);
+
+  int count = instance->n * instance->c;
+  instance->shares = (uint32_t *)malloc(count * sizeof(uint32_t));
+  struct reduce_job job;
+  job.instance = instance;
+  job.whole = y;
+  job.rem = NULL;
+  job.y = NULL;
+  if (simd_shares(instance))
+  {
+    select_kernel();
+    // the limbs of y read as little endian 32 bit words
+    size_t limbs = mpz_size(y);
+    uint32_t *words = (uint32_t *)malloc(2 * limbs * sizeof(uint32_t));
+    const mp_limb_t *yl = mpz_limbs_read(y);
+    for (size_t i = 0; i < limbs; i++)
+    {
+      words[2 * i] = (uint32_t)yl[i];
+      words[2 * i + 1] = (uint32_t)(yl[i] >> 32);
+    }
+    job.y = words;
+    job.words = (int)(2 * limbs);
+    thread_pool_run(instance->pool, (count + RNS_BLOCK - 1) / RNS_BLOCK, reduce_range, &job);
+    free(words);
+  }
+  else
+  {
+    if (instance->tree != NULL)
+    {
+      job.rem = (mpz_t *)malloc(instance->n * sizeof(mpz_t));
+      for (int i = 0; i < instance->n; i++)
+      {
+        mpz_init(job.rem[i]);
+      }
+      remainder_tree(job.rem, y, instance->tree, instance->pool);
+    }
+    thread_pool_run(instance->pool, instance->n, reduce_range_gmp, &job);
+    if (job.rem != NULL)
+    {
+      for (int i = 0; i < instance->n; i++)
+      {
+        mpz_clear(job.rem[i]);
+      }
+      free(job.rem);
+    }
+  }
+  instance->hasShares = 1;
+
+  mpz_clear(ub);
+  mpz_clear(y);
+}
+
+// a^-1 mod p by the extended Euclidean algorithm, a coprime to p
+static uint32_t invert_u32(uint32_t a, uint32_t p)
+{
+  int64_t r0 = p, r1 = a, s0 = 0, s1 = 1;
+  while (r1 != 0)
+  {
+    int64_t q = r0 / r1, t;
+    t = r0 - q * r1;
+    r0 = r1;
+    r1 = t;
+    t = s0 - q * s1;
+    s0 = s1;
+    s1 = t;
+  }
+  return (uint32_t)(s0 < 0 ? s0 + p : s0);
+}
+
+// secret from the quorum's shares by Garner's algorithm on the lane kernels
+static void garner_recover(mpz_t secret, const struct rns_asmuth_bloom *instance, const int *x, int k)
+{
+  select_kernel();
+  int c = instance->c;
+  int lanes = k * c;
+  uint32_t *p = (uint32_t *)malloc(lanes * sizeof(uint32_t));
+  uint32_t *pinv = (uint32_t *)malloc(lanes * sizeof(uint32_t));
+  uint32_t *r2 = (uint32_t *)malloc(lanes * sizeof(uint32_t));
+  uint32_t *acc = (uint32_t *)malloc(lanes * sizeof(uint32_t));
+  uint32_t *q = (uint32_t *)malloc(lanes * sizeof(uint32_t));
+  for (int j = 0; j < k; j++)
+  {
+    int from = (x[j] - 1) * c;
+    memcpy(p + j * c, instance->p + from, c * sizeof(uint32_t));
+    memcpy(pinv + j * c, instance->pinv + from, c * sizeof(uint32_t));
+    memcpy(r2 + j * c, instance->r2 + from, c * sizeof(uint32_t));
+    memcpy(acc + j * c, instance->shares + from, c * sizeof(uint32_t));
+  }
+  // Q = 1, i.e. 2^32 mod p in Montgomery form
+  for (int i = 0; i < lanes; i++)
+  {
+    q[i] = redc((uint64_t)r2[i], p[i], pinv[i]);
+  }
+
+  // acc[i] turns into the digit v_i
+  for (int i = 0; i < lanes; i++)
+  {
+    uint32_t Q = redc((uint64_t)q[i], p[i], pinv[i]);
+    acc[i] = (uint32_t)((uint64_t)acc[i] * invert_u32(Q, p[i]) % p[i]);
+    garner_kernel(acc + i + 1, q + i + 1, p + i + 1, pinv + i + 1, r2 + i + 1, lanes - i - 1, acc[i], p[i]);
+  }
+
+  size_t limit = mpz_size(instance->m0) + 1;
+  mpz_set_ui(secret, (unsigned long int)acc[lanes - 1]);
+  for (int i = lanes - 2; i >= 0; i--)
+  {
+    mpz_mul_ui(secret, secret, (unsigned long int)p[i]);
+    mpz_add_ui(secret, secret, (unsigned long int)acc[i]);
+    if (mpz_size(secret) > limit)
+    {
+      mpz_mod(secret, secret, instance->m0);
+    }
+  }
+  mpz_mod(secret, secret, instance->m0);
+
+  free(p);
+  free(pinv);
+  free(r2);
+  free(acc);
+  free(q);
+}
+
+// secret from the quorum's shares with GMP: the Chinese remainder theorem
+// over all of the quorum's primes on a product tree, then mod m_0
+static void crt_recover(mpz_t secret, const struct rns_asmuth_bloom *instance, const int *x, int k)
+{
+  int c = instance->c;
+  int lanes = k * c;
+  mpz_t *primes = (mpz_t *)malloc(lanes * sizeof(mpz_t));
+  mpz_t *w = (mpz_t *)malloc(lanes * sizeof(mpz_t));
+  for (int j = 0; j < k; j++)
+  {
+    for (int i = 0; i < c; i++)
+    {
+      int from = (x[j] - 1) * c + i;
+      mpz_init_set_ui(primes[j * c + i], (unsigned long int)(instance->p)[from]);
+      mpz_init_set_ui(w[j * c + i], (unsigned long int)(instance->shares)[from]);
+    }
+  }
+  struct product_tree *tree = build_moduli_tree(primes, lanes, instance->pool);
+  mpz_t *cofactor = (mpz_t *)malloc(lanes * sizeof(mpz_t));
+  for (int i = 0; i < lanes; i++)
+  {
+    mpz_init(cofactor[i]);
+  }
+  cofactor_inverses(cofactor, tree);
+  for (int i = 0; i < lanes; i++)
+  {
+    mpz_mul(w[i], w[i], cofactor[i]);
+    mpz_mod(w[i], w[i], primes[i]);
+  }
+  crt_combine(secret, w, tree);
+  mpz_mod(secret, secret, (tree->node)[0]);
+  mpz_mod(secret, secret, instance->m0);
+
+  for (int i = 0; i < lanes; i++)
+  {
+    mpz_clear(primes[i]);
+    mpz_clear(w[i]);
+    mpz_clear(cofactor[i]);
+  }
+  free(primes);
+  free(w);
+  free(cofactor);
+  free_moduli_tree(tree);
+}
+
+// Recovers secret from the shares of participants x[0], ..., x[k-1], k >= t.
+// Returns 0 if the quorum is not valid, 1 otherwise.
+//
+// With P_0, P_1, ... the quorum's primes in order, Garner's digit
+// v_i = acc_i Q_i^-1 mod P_i, Q_i = P_0 ... P_(i-1), is final once the
+// digits before it are subtracted, and it is subtracted from all later
+// primes in one kernel call. y = v_0 + P_0 (v_1 + P_1 (v_2 + ...)) is then
+// put together mod m_0.
+int rns_recover(mpz_t secret, const struct rns_asmuth_bloom *instance, const int *x, int k)
+{
+  if (instance->hasShares != 1)
+  {
+    printf("Asmuth-Bloom instance does not have shares to reconstruct.\n");
+    return 0;
+  }
+  if (k < instance->t)
+  {
+    printf("Recovery needs at least %d shares, got %d.\n", instance->t, k);
+    return 0;
+  }
+  char *seen = (char *)calloc(instance->n + 1, sizeof(char));
+  for (int j = 0; j < k; j++)
+  {
+    if (x[j] < 1 || x[j] > instance->n || seen[x[j]])
+    {
+      printf("Participant %d is not one of the %d participants or is in the quorum twice.\n", x[j], instance->n);
+      free(seen);
+      return 0;
+    }
+    seen[x[j]] = 1;
+  }
+  free(seen);
+  if (simd_recovery(instance, k))
+  {
+    garner_recover(secret, instance, x, k);
+  }
+  else
+  {
+    crt_recover(secret, instance, x, k);
+  }
+  return 1;
+}
+
+// Recovers s from the shares of participants 1 ... t and returns 1 if it
+// matches the instance's secret.
+int rns_recover_secret(struct rns_asmuth_bloom *instance)
+{
+  int *x = (int *)malloc(instance->t * sizeof(int));
+  for (int j = 0; j < instance->t; j++)
+  {
+    x[j] = j + 1;
+  }
+  mpz_t result;
+  mpz_init(result);
+  int isSecret = rns_recover(result, instance, x, instance->t) && mpz_cmp(result, instance->s) == 0;
+  mpz_clear(result);
+  free(x);
+  return isSecret;
+}
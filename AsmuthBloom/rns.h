@@ -0,0 +1,96 @@
+// Asmuth-Bloom over a residue number system.
+//
+// Participant i's modulus M_i is the product of c primes just below 2^31
+// instead of one lambda bit prime, and its share is the c residues of
+// y = s + alpha * m_0 modulo them. Every share operation then works on one
+// prime at a time in a 32 bit lane: shares are y's 32 bit words run through
+// Horner's rule per prime, and recovery is Garner's algorithm over the
+// quorum's primes, where every digit updates all later primes at once. The
+// kernels run a Montgomery product per lane on AVX-512, AVX2 or plain
+// integers, whichever the CPU has. Only the last step, the digits of y put
+// together mod m_0, uses GMP.
+//
+// c is the smallest count that makes M_1, ..., M_n, with m_0 the next prime
+// after 2^lambda, satisfy the Asmuth-Bloom condition for the instance's t.
+#ifndef ASMUTH_BLOOM_RNS_HEADER
+#define ASMUTH_BLOOM_RNS_HEADER
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "asmuthbloom.h"
+#include "remainder.h"
+#include "../common/visibility.h"
+
+// the primes are the largest ones below 2^RNS_PRIME_BITS
+#define RNS_PRIME_BITS 31
+
+// primes reduced per thread pool range
+#define RNS_BLOCK 256
+
+// RNS_AUTO generates shares on the lane kernels up to this many primes in t
+// moduli, about the 32 bit words of y, and on GMP above. Every prime reads
+// all of y on the lanes, while GMP's remainder tree grows quasi-linearly in y:
+// measured with n = 20 ... 1000 and lambda = 64 ... 512, the two are even at
+// 300 to 450 words.
+#define RNS_SHARE_LIMIT 400
+
+// RNS_AUTO recovers with Garner's algorithm on the lane kernels up to this
+// many primes in the quorum, and with the product tree above. Garner is
+// quadratic in them and was still ahead at 3000, behind at 5400.
+#define RNS_GARNER_LIMIT 4000
+
+enum rns_engine
+{
+  RNS_AUTO, // whichever the limits above pick
+  RNS_SIMD, // the lane kernels
+  RNS_GMP   // y mod M_i on a remainder tree, then mod each prime; CRT on a product tree
+};
+
+struct rns_asmuth_bloom
+{
+  int t;      // threshold
+  int n;      // number of participants
+  int lambda; // security parameter
+  int c;      // primes per participant
+
+  int hasSecret;
+  int hasShares;
+
+  gmp_randstate_t state; // RNG, seeded once at init
+  enum rns_engine engine;
+
+  mpz_t m0;       // the next prime after 2^lambda
+  mpz_t s;        // the secret
+  mpz_t alpha;    // random value
+  uint32_t *p;    // participant i has the primes p[(i-1)c ... ic-1], M_i is their product
+  uint32_t *pinv; // -p^-1 mod 2^32, per prime
+  uint32_t *r2;   // 2^64 mod p, per prime
+  uint32_t *shares; // y mod p, per prime
+  mpz_t *moduli;  // moduli[i - 1] = M_i
+  mpz_t top;      // M_(n-t+1) ... M_n, which y stays below
+  struct product_tree *tree; // of the M_i for GMP shares, NULL below REMAINDER_TREE_THRESHOLD participants
+
+  struct thread_pool *pool; // splits the share residues across threads, NULL for serial
+};
+
+SECRET_SHARING_API struct rns_asmuth_bloom *init_rns_instance(int, int, int);
+
+SECRET_SHARING_API void free_rns_instance(struct rns_asmuth_bloom *);
+
+SECRET_SHARING_API void set_rns_thread_pool(struct rns_asmuth_bloom *, struct thread_pool *);
+
+SECRET_SHARING_API void set_rns_engine(struct rns_asmuth_bloom *, enum rns_engine);
+
+SECRET_SHARING_API void generate_rns_secret(struct rns_asmuth_bloom *);
+
+SECRET_SHARING_API void generate_rns_shares(struct rns_asmuth_bloom *);
+
+SECRET_SHARING_API int rns_recover(mpz_t, const struct rns_asmuth_bloom *, const int *, int);
+
+SECRET_SHARING_API int rns_recover_secret(struct rns_asmuth_bloom *);
+
+SECRET_SHARING_API const char *rns_kernel_name(void);
+
+#endif
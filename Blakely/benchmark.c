@@ -1,6 +1,201 @@
+#define _POSIX_C_SOURCE 199309L
 #include "blakely.h"
 #include <stdio.h>
 #include <gmp.h>
+#include <time.h>
+
+// prime sizes compared by "compare": 64, the special form prime sizes and 512
+static const int compare_lambdas[] = {64, 89, 127, 192, 255, 384, 512};
+
+// average milliseconds for a whole init, share and recover run with primes
+// from source, repeated for at least 0.2 seconds
+static double time_runs(int t, int n, int lambda, enum prime_source source)
+{
+  struct timespec start, now;
+  double elapsed;
+  int runs = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    struct blakely *instance = init_blakely_instance(t, n, lambda);
+    set_blakely_prime_source(instance, source, NULL);
+    generate_blakely_secret(instance);
+    generate_blakely_shares(instance);
+    if (recover_blakely_secret(instance) != 1)
+    {
+      printf("Secret not recovered at lambda %d.\n", lambda);
+    }
+    free_blakely_instance(instance);
+    runs++;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+  } while (elapsed < 0.2);
+  return elapsed * 1000 / runs;
+}
+
+// prints the time per run with random, table and special form primes
+static void compare_primes(int t, int n)
+{
+  printf("lambda   random ms   table ms   special ms   random/special\n");
+  for (size_t i = 0; i < sizeof(compare_lambdas) / sizeof(compare_lambdas[0]); i++)
+  {
+    int lambda = compare_lambdas[i];
+    double random = time_runs(t, n, lambda, PRIME_RANDOM);
+    double table = time_runs(t, n, lambda, PRIME_TABLE);
+    double special = time_runs(t, n, lambda, PRIME_SPECIAL);
+    printf("%6d %11.3f %10.3f %12.3f %16.1f\n", lambda, random, table, special, random / special);
+  }
+}
+
+// times recover_blakely_secret, which is one t x t solve, next to a single
+// determinant of the same matrix; recovery through cofactors took t + 1 of
+// those. The elimination is split across pool's threads, NULL for serial.
+static void time_recovery(int t, int n, int lambda, struct thread_pool *pool)
+{
+  struct timespec start, end;
+  struct blakely *instance = init_blakely_instance(t, n, lambda);
+  set_blakely_thread_pool(instance, pool);
+  generate_blakely_secret(instance);
+  generate_blakely_shares(instance);
+
+  int found = 1, runs = 0;
+  double solve;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    found &= recover_blakely_secret(instance);
+    runs++;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    solve = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  } while (solve < 0.2);
+  solve /= runs;
+
+  mpz_t det;
+  mpz_init(det);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  determinant_mod(&instance->shares, &det, t, instance->p);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double one = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  mpz_clear(det);
+
+  printf("t = %d, %d threads: recovered in %.3f ms, one serial determinant %.3f ms (cofactor recovery needs %d)\n", t,
+         pool != NULL ? pool->threads : 1, solve * 1000, one * 1000, t + 1);
+  printf("Secret recovered: %d\n", found);
+  free_blakely_instance(instance);
+}
+
+// share generation and recovery times and share storage with full rows and
+// with seed-compressed shares
+static void compare_compressed(int t, int n, int lambda, struct thread_pool *pool)
+{
+  for (int compressed = 0; compressed <= 1; compressed++)
+  {
+    struct timespec start, mid, end;
+    struct blakely *instance = init_blakely_instance(t, n, lambda);
+    set_blakely_thread_pool(instance, pool);
+    set_compressed_shares(instance, compressed);
+    generate_blakely_secret(instance);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    generate_blakely_shares(instance);
+    clock_gettime(CLOCK_MONOTONIC, &mid);
+    int found = recover_blakely_secret(instance);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    size_t bytes = (size_t)n * ((size_t)instance->shares.cols * mpz_size(instance->p) * sizeof(mp_limb_t) +
+                                (compressed ? SHARE_SEED_BYTES : 0));
+    printf("%s shares: %.1f KB, generated in %.3f ms, recovered in %.3f ms, secret recovered: %d\n",
+           compressed ? "compressed" : "full", bytes / 1024.0,
+           (double)(mid.tv_sec - start.tv_sec) * 1000 + (mid.tv_nsec - start.tv_nsec) * 1e-6,
+           (double)(end.tv_sec - mid.tv_sec) * 1000 + (end.tv_nsec - mid.tv_nsec) * 1e-6, found);
+    free_blakely_instance(instance);
+  }
+}
+
+// count secrets shared on the same hyperplanes with share_blakely_secret,
+// recovered by the last t participants through one recovery context, next
+// to solving the quorum's system for each, with full or compressed shares
+static void time_quorum(int t, int n, int lambda, int count, int compressed)
+{
+  struct timespec start, end;
+  struct blakely *instance = init_blakely_instance(t, n, lambda);
+  set_compressed_shares(instance, compressed);
+  generate_blakely_secret(instance);
+  generate_blakely_shares(instance);
+
+  // every participant's last coordinate for each secret, of which the
+  // quorum's are kept
+  int *x = (int *)malloc(t * sizeof(int));
+  mpz_t *secrets = (mpz_t *)malloc(count * sizeof(mpz_t));
+  mpz_t *last = (mpz_t *)malloc((size_t)count * t * sizeof(mpz_t));
+  mpz_t *all = (mpz_t *)malloc(n * sizeof(mpz_t));
+  mpz_t a;
+  mpz_init(a);
+  for (int j = 0; j < t; j++)
+  {
+    x[j] = n - t + 1 + j;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init(all[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int c = 0; c < count; c++)
+  {
+    mpz_init(secrets[c]);
+    mpz_urandomm(secrets[c], instance->state, instance->p);
+    share_blakely_secret(all, instance, secrets[c]);
+    for (int j = 0; j < t; j++)
+    {
+      mpz_init_set(last[(size_t)c * t + j], all[x[j] - 1]);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double share = ((double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9) / count;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct blakely_recovery *context = init_blakely_recovery(instance, x);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double setup = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+  int found = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int c = 0; c < count; c++)
+  {
+    blakely_recover_with(a, context, &last[(size_t)c * t]);
+    found += mpz_cmp(a, secrets[c]) == 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double each = ((double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9) / count;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  recover_blakely_secret(instance);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double solve = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+  printf("%s shares, %d secrets: shared in %.3f ms each; context %.3f ms, then %.3f us each; solving the system "
+         "%.3f ms each (%.0fx)\n",
+         compressed ? "compressed" : "full", count, share * 1000, setup * 1000, each * 1e6, solve * 1000, solve / each);
+  printf("Secrets recovered: %d of %d\n", found, count);
+
+  free_blakely_recovery(context);
+  for (int c = 0; c < count; c++)
+  {
+    mpz_clear(secrets[c]);
+    for (int j = 0; j < t; j++)
+    {
+      mpz_clear(last[(size_t)c * t + j]);
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    mpz_clear(all[i]);
+  }
+  mpz_clear(a);
+  free(secrets);
+  free(last);
+  free(all);
+  free(x);
+  free_blakely_instance(instance);
+}
 
 int main(int argc, char *argv[])
 {
@@ -12,6 +207,11 @@ int main(int argc, char *argv[])
   {
     t = (int)strtol(argv[1], NULL, 10);
     n = (int)strtol(argv[2], NULL, 10);
+    if (strcmp(argv[3], "compare") == 0 && t <= n && t >= 2 && n <= 1000)
+    {
+      compare_primes(t, n);
+      return 0;
+    }
     lambda = (int)strtol(argv[3], NULL, 10);
     if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
     {
@@ -22,17 +222,73 @@ int main(int argc, char *argv[])
   else
   {
     printf("Must input a threshold, number of parties, and security parameter.\n");
+    printf("An optional fourth argument picks the prime source: table (default), special, cache or random.\n");
+    printf("An optional fifth argument is the number of share generation threads, 0 for one per processor.\n");
+    printf("With \"compare\" as the security parameter, times random, table and special form primes.\n");
+    printf("With \"recover\" as fourth argument, times recovering the secret, on as many threads as the fifth.\n");
+    printf("With \"compressed\" instead, compares full and seed-compressed shares.\n");
+    printf("With \"quorum\" and a count, shares that many secrets on the same hyperplanes and times one quorum\n");
+    printf("recovering them through a recovery context, with full and with compressed shares.\n");
     exit(EXIT_FAILURE);
   }
 
-  instance = init_instance(t, n, lambda);
-  generate_secret(instance);
-  generate_shares(instance);
-  printf("Secret recovered: %d\n", recover_secret(instance));
+  if (argc > 5 && strcmp(argv[4], "quorum") == 0)
+  {
+    time_quorum(t, n, lambda, (int)strtol(argv[5], NULL, 10), 0);
+    time_quorum(t, n, lambda, (int)strtol(argv[5], NULL, 10), 1);
+    return 0;
+  }
+  if (argc > 4 && strcmp(argv[4], "compressed") == 0)
+  {
+    struct thread_pool *pool = argc > 5 ? start_thread_pool((int)strtol(argv[5], NULL, 10)) : NULL;
+    compare_compressed(t, n, lambda, pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+  if (argc > 4 && strcmp(argv[4], "recover") == 0)
+  {
+    struct thread_pool *pool = argc > 5 ? start_thread_pool((int)strtol(argv[5], NULL, 10)) : NULL;
+    time_recovery(t, n, lambda, pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
 
-  //print_instance(instance);
+  instance = init_blakely_instance(t, n, lambda);
 
-  free_instance(instance);
+  struct prime_cache *cache = NULL;
+  if (argc > 4 && strcmp(argv[4], "cache") == 0)
+  {
+    cache = start_prime_cache(lambda, 4);
+    set_blakely_prime_source(instance, PRIME_CACHE, cache);
+  }
+  else if (argc > 4 && strcmp(argv[4], "special") == 0)
+  {
+    set_blakely_prime_source(instance, PRIME_SPECIAL, NULL);
+  }
+  else if (argc > 4 && strcmp(argv[4], "random") == 0)
+  {
+    set_blakely_prime_source(instance, PRIME_RANDOM, NULL);
+  }
+
+  struct thread_pool *pool = NULL;
+  if (argc > 5)
+  {
+    pool = start_thread_pool((int)strtol(argv[5], NULL, 10));
+    set_blakely_thread_pool(instance, pool);
+  }
+
+  generate_blakely_secret(instance);
+  generate_blakely_shares(instance);
+  printf("Secret recovered: %d\n", recover_blakely_secret(instance));
+
+  //print_blakely_instance(instance);
+
+  free_blakely_instance(instance);
+  if (cache != NULL)
+  {
+    stop_prime_cache(cache);
+  }
+  stop_thread_pool(pool);
 
   return 0;
 }
@@ -1,6 +1,6 @@
 #include "blakely.h"
 
-void free_instance(struct blakely *instance)
+void free_blakely_instance(struct blakely *instance)
 {
   if (instance->passedInit != 1)
   { // nothing aside from the struct was allocated
@@ -22,21 +22,14 @@ void free_instance(struct blakely *instance)
   mpz_clear(instance->p);
 
   // free shares matrix
-  for (int i = 0; i < instance->n; i++)
-  {
-    for (int j = 0; j < instance->t; j++)
-    {
-      mpz_clear((instance->shares)[i][j]);
-    }
-    free((instance->shares)[i]);
-  }
-  free(instance->shares);
+  free_matrix(&instance->shares);
+  free(instance->seeds);
 
   free(instance);
   return;
 }
 
-struct blakely *init_instance(int t, int n, int lambda)
+struct blakely *init_blakely_instance(int t, int n, int lambda)
 {
   struct blakely *instance;
   instance = (struct blakely *)malloc(1 * sizeof(struct blakely));
@@ -49,7 +42,7 @@ struct blakely *init_instance(int t, int n, int lambda)
   if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
   {
     printf("Blakely (%d,%d) scheme with security %d is not valid.\n", t, n, lambda);
-    free_instance(instance);
+    free_blakely_instance(instance);
     exit(EXIT_FAILURE);
   }
 
@@ -72,26 +65,66 @@ struct blakely *init_instance(int t, int n, int lambda)
     mpz_init((instance->s)[i]);
   }
 
-  // init shares
-  instance->shares = (mpz_t **) malloc(n * sizeof(mpz_t *));
-  for (int i = 0; i < n; i++) {
-    (instance->shares)[i] = (mpz_t *) malloc(t * sizeof(mpz_t));
-    for (int j = 0; j < t; j++) {
-      mpz_init((instance->shares)[i][j]);
-    }
-  }
+  // the shares matrix is allocated by generate_blakely_shares, once p is known
+  instance->shares.data = NULL;
+  instance->compressed = 0;
+  instance->seeds = NULL;
+
+  instance->primes.source = PRIME_TABLE;
+  instance->primes.cache = NULL;
+  instance->primes.secretBelowP = 0;
+  instance->pool = NULL;
 
   instance->passedInit = 1;
 
   return instance;
 }
 
-void generate_secret(struct blakely *instance)
+// Selects where generate_blakely_secret takes p from. cache is only used with
+// PRIME_CACHE, must have been started for the instance's lambda, and is not
+// owned by the instance.
+void set_blakely_prime_source(struct blakely *instance, enum prime_source source, struct prime_cache *cache)
+{
+  instance->primes.source = source;
+  instance->primes.cache = cache;
+}
+
+// With a table or special form prime, draw the secret uniformly below p
+// instead of below 2^lambda, so p never has to be replaced by a larger one.
+void set_blakely_secret_below_p(struct blakely *instance, int on)
+{
+  instance->primes.secretBelowP = on;
+}
+
+// Splits share generation and the recovery's elimination across pool's
+// threads. The pool is not owned by the instance and can be shared by any
+// number of them, as long as they do not use it at the same time. NULL goes
+// back to serial.
+void set_blakely_thread_pool(struct blakely *instance, struct thread_pool *pool)
+{
+  instance->pool = pool;
+}
+
+// Keep shares compressed: each participant's first t-1 coordinates are not
+// stored but expanded from a SHARE_SEED_BYTES seed whenever they are needed,
+// so a share is its seed and its last coordinate. Has to be set before
+// generate_blakely_shares.
+void set_compressed_shares(struct blakely *instance, int on)
+{
+  if (instance->hasShares != 0)
+  {
+    printf("Cannot change the share format of an instance that has already got shares.\n");
+    return;
+  }
+  instance->compressed = on;
+}
+
+void generate_blakely_secret(struct blakely *instance)
 {
   if (instance->passedInit != 1)
   {
     printf("Failed trying to generate secret before instance init.\n");
-    free_instance(instance);
+    free_blakely_instance(instance);
     exit(EXIT_FAILURE);
   }
   else if (instance->hasSecret == 1)
@@ -101,32 +134,18 @@ void generate_secret(struct blakely *instance)
   }
 
   // generate secret
-  mpz_urandomb((instance->s)[0], instance->state, instance->lambda);
-  
-  // set prime p of length lambda and p > s
   mpz_init(instance->p);
-  mpz_urandomb(instance->p, instance->state, instance->lambda);
-  while (mpz_cmp(instance->p, (instance->s)[0]) <= 0)
-  { // while (p <= s) get new p
-    mpz_urandomb(instance->p, instance->state, instance->lambda);
-  }
-  mpz_nextprime(instance->p, instance->p); 
-
-  // make sure p is prime with err probability 1/2^lambda
-  int prime_found = 0;
-  while (prime_found == 0)
-  {
-    int test;
-    test = mpz_probab_prime_p(instance->p, instance->lambda / 2);
-    if (test > 0)
-    { // it was prime
-      prime_found = 1;
-    }
-    else if (test == 0)
-    { // it was not prime
-      mpz_nextprime(instance->p, instance->p);
-    }
+  if (instance->primes.secretBelowP && fixed_prime(instance->p, &instance->primes, instance->lambda))
+  {
+    mpz_urandomm((instance->s)[0], instance->state, instance->p);
   }
+  else
+  {
+    mpz_urandomb((instance->s)[0], instance->state, instance->lambda);
+  }
+
+  // set prime p of length lambda and p > s, from the instance's prime source
+  provide_prime(instance->p, &instance->primes, instance->lambda, (instance->s)[0], instance->state);
 
   // generate s[i] for 1<=i<t. Remember, s is the intersection point.
   for (int i = 1; i < instance->t; i++)
@@ -134,294 +153,483 @@ void generate_secret(struct blakely *instance)
     mpz_urandomm((instance->s)[i], instance->state, instance->p);
   }
   
-  instance->hasSecret = 1; // so free_instance knows to free s
+  instance->hasSecret = 1; // so free_blakely_instance knows to free s
   return;
 }
 
-void generate_shares(struct blakely *instance)
+struct share_job {
+  struct blakely *instance;
+  uint8_t key[32];       // ChaCha20 key of the share streams
+  struct field *f;       // NULL if p does not fit the field layer
+  const mp_limb_t *point; // s[0] ... s[t-2] on the field layer
+  const mp_limb_t *last;  // s[t-1] on the field layer
+};
+
+// r = uniform value below p, by rejection from the smallest number of bytes
+// holding p, with the bits above p's top bit masked off
+static void stream_below(mpz_t r, struct chacha20 *rng, const mpz_t p, uint8_t *buf)
 {
-  if (instance->hasShares != 0)
+  size_t bits = mpz_sizeinbase(p, 2);
+  size_t bytes = (bits + 7) / 8;
+  uint8_t mask = (uint8_t)(0xff >> (8 * bytes - bits));
+  do
   {
-    printf("Cannot generate shares on an Asmuth-Bloom instance that has already got shares, or has not been initialized.\n");
-    return;
+    chacha20_bytes(rng, buf, bytes);
+    buf[bytes - 1] &= mask;
+    mpz_import(r, bytes, -1, 1, 0, 0, buf);
+  } while (mpz_cmp(r, p) >= 0);
+}
+
+// participant i's seed, the first SHARE_SEED_BYTES of stream i under key
+static void derive_seed(uint8_t *seed, const uint8_t *key, int i)
+{
+  struct chacha20 rng;
+  chacha20_init(&rng, key, (uint64_t)i);
+  chacha20_bytes(&rng, seed, SHARE_SEED_BYTES);
+  memset(&rng, 0, sizeof(rng));
+}
+
+// Draws the t-1 random coordinates of the row with the given seed into row r
+// of m, coordinate 0 in column first and every other coordinate j in column
+// j. The coordinates are the seed's ChaCha20 stream, nonce 0, cut into values
+// below p.
+static void expand_row(struct matrix *m, int r, int first, const uint8_t *seed, const mpz_t p, int t)
+{
+  struct chacha20 rng;
+  uint8_t *buf = (uint8_t *)malloc(mpz_size(p) * sizeof(mp_limb_t));
+  mpz_t coord;
+  mpz_init(coord);
+  chacha20_init(&rng, seed, (uint64_t)0);
+  for (int j = 0; j < t - 1; j++)
+  {
+    stream_below(coord, &rng, p, buf);
+    matrix_set(m, r, j == 0 ? first : j, coord);
   }
+  memset(&rng, 0, sizeof(rng));
+  mpz_clear(coord);
+  free(buf);
+}
 
-  // generating shares[i][j] where 0 <= i < n, 0 <= j < t-1
-  for (int i = 0; i < instance->n; i++)
+// Generates shares begin ... end-1. Participant i's random row is expanded
+// from its own seed, stream i under the job's key, so the shares only depend
+// on the key and not on how the participants are split across threads. Full
+// shares are expanded into their row of the shares matrix, compressed ones
+// into a scratch row that only lives until the last coordinate is known.
+static void share_range(void *arg, int begin, int end)
+{
+  struct share_job *job = (struct share_job *)arg;
+  struct blakely *instance = job->instance;
+  struct field *f = job->f;
+  int k = (instance->t) - 1;
+  struct matrix *shares = &instance->shares;
+  struct matrix scratch;
+  scratch.data = NULL;
+  if (instance->compressed)
   {
-    for (int j = 0; j < (instance->t) - 1; j++)
-    {
-      mpz_urandomm((instance->shares)[i][j], instance->state, instance->p);
-    }
+    init_matrix(&scratch, 1, instance->t, shares->limbs);
   }
 
+  // generating shares[i][j] where 0 <= j < t-1
   // Computing shares[i][t-1] = s[t-1] - shares[i][0]*s[0] - shares[i][1]*s[1] - ...
   // - shares[t-2]*s[t-2] mod p
-  mpz_t temp;
+  mpz_t temp, coord;
   mpz_init(temp);
-  for (int i = 0; i < instance->n; i++)
+  mpz_init(coord);
+  uint8_t own[SHARE_SEED_BYTES];
+  mp_limb_t dot[FIELD_MAX_LIMBS];
+  for (int i = begin; i < end; i++)
   {
-    mpz_set(temp, (instance->s)[(instance->t) - 1]); // temp = s[t-1]
-    for (int j = 0; j < (instance->t) - 1; j++)
+    uint8_t *seed = instance->compressed ? instance->seeds + (size_t)i * SHARE_SEED_BYTES : own;
+    struct matrix *rows = instance->compressed ? &scratch : shares;
+    int r = instance->compressed ? 0 : i;
+    mp_limb_t *last = matrix_entry(shares, i, instance->compressed ? 0 : k);
+    derive_seed(seed, job->key, i);
+    expand_row(rows, r, 0, seed, instance->p, instance->t);
+    if (f != NULL)
     {
-      // temp = temp - shares[i][j] * s[j]
-      mpz_submul(temp, (instance->shares)[i][j], (instance->s)[j]);
-
-      // temp = temp mod p
+      // the rows are field elements already, so the dot product is
+      // accumulated unreduced straight from the row and only reduced mod p
+      // once per share
+      f->ops->dot(dot, matrix_entry(rows, r, 0), job->point, k, f);
+      f->ops->sub(last, job->last, dot, f); // s[t-1] - dot
+    }
+    else
+    {
+      mpz_set(temp, (instance->s)[k]); // temp = s[t-1]
+      for (int j = 0; j < k; j++)
+      {
+        // temp = temp - shares[i][j] * s[j]
+        matrix_get(coord, rows, r, j);
+        mpz_submul(temp, coord, (instance->s)[j]);
+      }
+      // shares[i][t-1] = temp mod p
       mpz_fdiv_r(temp, temp, instance->p);
+      matrix_set(shares, i, instance->compressed ? 0 : k, temp);
     }
-    // shares[i][0] = temp
-    mpz_set((instance->shares)[i][(instance->t) - 1], temp);
   }
+  memset(own, 0, sizeof(own));
   mpz_clear(temp);
-
-  instance->hasShares = 1;
-  
-  return;
+  mpz_clear(coord);
+  free_matrix(&scratch);
 }
 
-// Find the determinant of matrix mod p and return in result. 
-void determinant_mod(mpz_t **matrix, mpz_t *result, int n, mpz_t p) {
-	int index;
-	mpz_t num1, num2, minus1, det;
-
-	mpz_init(num1);
-	mpz_init(num2);
-	mpz_init_set_ui(det, (unsigned long int) 1);
-	mpz_init_set_si(minus1, (long int) -1);
-	mpz_set_ui(*result, (unsigned long int) 1);
-
-	// make a copy of matrix because we will change values of matrix otherwise
-	mpz_t m_copy[n][n];
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			mpz_init_set(m_copy[i][j], matrix[i][j]); }
-	}
-
-	// temp array for storing row
-	mpz_t temp[n + 1];
-	for (int i = 0; i < n+1; i++) {
-		mpz_init(temp[i]);
-	}
+void generate_blakely_shares(struct blakely *instance)
+{
+  if (instance->hasShares != 0)
+  {
+    printf("Cannot generate shares on an Asmuth-Bloom instance that has already got shares, or has not been initialized.\n");
+    return;
+  }
 
-	// loop traversing diagonal elements
-	for (int i = 0; i < n; i++) {
-		index = i;
+  struct share_job job;
+  job.instance = instance;
 
-		// finding index with non-zero value
-		while (index < n && mpz_sgn(m_copy[index][i]) == 0) {
-			index++;
-		}
-		if (index == n) { // if there is no nonzero element
-			continue; // determinant is zero
-		}
-		if (index != i) {
-			// loop for swapping diag element row and index row
-			for (int j = 0; j < n; j++) {
-				mpz_swap(m_copy[index][j], m_copy[i][j]);
-			}
-
-			mpz_t dummy;
-			mpz_init(dummy);
-			mpz_pow_ui(dummy, minus1, index - 1);
-			mpz_mul(det, det, dummy); // det = det * (-1)^(index - 1)
-			mpz_clear(dummy);
-		}
+  // the share streams are keyed straight from getrandom, since the instance's
+  // GMP state only holds a 64 bit seed
+  size_t got = 0;
+  while (got < sizeof(job.key))
+  {
+    ssize_t r = getrandom(job.key + got, sizeof(job.key) - got, 0);
+    if (r > 0)
+      got += (size_t)r;
+  }
 
-		// Store values of diagonals
-		for (int j = 0; j < n; j++) {
-			mpz_set(temp[j],m_copy[i][j]);
-		}
-		// Traverse each row below diagonal
-		for (int j = i + 1; j < n; j++) {
-			mpz_set(num1, temp[i]);
-			mpz_set(num2, m_copy[j][i]);
-			
-			// traverse every column of the row and multiply to every row
-			for (int k = 0; k < n; k++) {
-				mpz_mul(m_copy[j][k], num1, m_copy[j][k]);
-				mpz_fdiv_r(m_copy[j][k], m_copy[j][k], p); // mop p
-				mpz_submul(m_copy[j][k], num2, temp[k]);
-				mpz_fdiv_r(m_copy[j][k], m_copy[j][k], p); // mod p
-			}
-			mpz_mul(*result, *result, num1);
-			mpz_fdiv_r(*result, *result, p); // mod p
-		}
-	}
+  struct field f;
+  mp_limb_t *point = NULL;
+  mp_limb_t last[FIELD_MAX_LIMBS];
+  job.f = NULL;
+  if (field_init(&f, instance->p))
+  {
+    int k = (instance->t) - 1;
+    point = (mp_limb_t *)malloc((size_t)k * f.limbs * sizeof(mp_limb_t));
+    for (int j = 0; j < k; j++)
+    {
+      field_import(point + (size_t)j * f.limbs, (instance->s)[j], &f);
+    }
+    field_import(last, (instance->s)[k], &f);
+    job.f = &f;
+  }
+  job.point = point;
+  job.last = last;
 
-	for (int i = 0; i < n; i++) {
-		mpz_mul(det, det, m_copy[i][i]);
-		mpz_fdiv_r(det, det, p); // ADDED
-	}
+  // compressed shares only keep the last coordinate next to their seed
+  init_matrix(&instance->shares, instance->n, instance->compressed ? 1 : instance->t, matrix_limbs(instance->p));
+  if (instance->compressed)
+  {
+    instance->seeds = (uint8_t *)malloc((size_t)instance->n * SHARE_SEED_BYTES);
+  }
+  thread_pool_run(instance->pool, instance->n, share_range, &job);
+  memset(job.key, 0, sizeof(job.key));
+  free(point);
 
-	int err = mpz_invert(*result, *result, p); // result = result^-1 mod p
-	mpz_mul(*result, *result, det); // result = result * det
-	mpz_fdiv_r(*result, *result, p); // result = result mod p
+  instance->hasShares = 1;
+  
+  return;
+}
 
-	// free m_copy and other big ints
-	for (int i = 0; i < n; i++) {
-		for (int j = 0; j < n; j++) {
-			mpz_clear(m_copy[i][j]);
-		}
-	}
-	mpz_clear(num1);
-	mpz_clear(num2);
-	mpz_clear(det);
-	mpz_clear(minus1);
+struct point_job {
+  struct blakely *instance;
+  mpz_t *last;            // last[i] is participant i+1's last coordinate
+  const mpz_t *coords;    // the point
+  struct field *f;        // NULL if p does not fit the field layer
+  const mp_limb_t *point; // coords[0] ... coords[t-2] on the field layer
+  const mp_limb_t *final; // coords[t-1] on the field layer
+};
+
+// last[i] = coords[t-1] - share[i][0]*coords[0] - ... - share[i][t-2]*coords[t-2]
+// mod p for begin <= i < end, with compressed rows expanded from their seeds
+// into a scratch row
+static void point_range(void *arg, int begin, int end)
+{
+  struct point_job *job = (struct point_job *)arg;
+  struct blakely *instance = job->instance;
+  struct field *f = job->f;
+  int k = (instance->t) - 1;
+  struct matrix scratch;
+  scratch.data = NULL;
+  if (instance->compressed)
+  {
+    init_matrix(&scratch, 1, instance->t, instance->shares.limbs);
+  }
 
-	return;
+  mpz_t coord;
+  mpz_init(coord);
+  mp_limb_t dot[FIELD_MAX_LIMBS], value[FIELD_MAX_LIMBS];
+  for (int i = begin; i < end; i++)
+  {
+    struct matrix *rows = instance->compressed ? &scratch : &instance->shares;
+    int r = instance->compressed ? 0 : i;
+    if (instance->compressed)
+    {
+      expand_row(&scratch, 0, 0, instance->seeds + (size_t)i * SHARE_SEED_BYTES, instance->p, instance->t);
+    }
+    if (f != NULL)
+    {
+      f->ops->dot(dot, matrix_entry(rows, r, 0), job->point, k, f);
+      f->ops->sub(value, job->final, dot, f);
+      field_export(job->last[i], value, f);
+    }
+    else
+    {
+      mpz_set(job->last[i], job->coords[k]);
+      for (int j = 0; j < k; j++)
+      {
+        matrix_get(coord, rows, r, j);
+        mpz_submul(job->last[i], coord, job->coords[j]);
+      }
+      mpz_fdiv_r(job->last[i], job->last[i], instance->p);
+    }
+  }
+  mpz_clear(coord);
+  free_matrix(&scratch);
 }
 
-		
-// Function to get the cofactor of matrix[n][n] at position matrix[x][y] 
-// and return as result.
-void get_cofactor(mpz_t **matrix, mpz_t *result, int x, int y, int n, mpz_t p) {
-	// make cofactor matrix
-	mpz_t **cofactor_matrix;
-	cofactor_matrix = (mpz_t **) malloc((n-1) * sizeof(mpz_t *));
-	for (int i = 0; i < n-1; i++) {
-		cofactor_matrix[i] = (mpz_t *) malloc((n-1) * sizeof(mpz_t)); 
-	}
+// Shares another secret, below p, on the hyperplanes of an instance with
+// shares: draws a new point with the secret as x[0] and sets last[i] to the
+// last coordinate participant i+1's hyperplane needs to pass through it, for
+// all n participants. The shares' other coordinates, or their seeds, stay as
+// they are, so a recovery context of the instance recovers the new secret
+// from a quorum's last[x[j] - 1]. Returns 0 if the instance has no shares or
+// the secret is not below p.
+int share_blakely_secret(mpz_t *last, struct blakely *instance, const mpz_t secret)
+{
+  if (instance->hasShares != 1)
+  {
+    printf("Cannot share a secret on the hyperplanes of an instance without shares.\n");
+    return 0;
+  }
+  if (mpz_sgn(secret) < 0 || mpz_cmp(secret, instance->p) >= 0)
+  {
+    printf("The secret must be below p.\n");
+    return 0;
+  }
 
-	int i = 0;
-	int j = 0;
-
-	// Init cofactor matrix
-	for (int row = 0; row < n; row++) {
-		for (int col = 0; col < n; col++) {
-			if (row != x && col != y) {
-				mpz_init_set(cofactor_matrix[i][j], matrix[row][col]);
-				j++;
-				if (j == n - 1) {
-					j = 0;
-					i++;
-				}
-			}
-		}
-	}
+  int t = instance->t;
+  mpz_t *coords = (mpz_t *)malloc(t * sizeof(mpz_t));
+  mpz_init_set(coords[0], secret);
+  for (int j = 1; j < t; j++)
+  {
+    mpz_init(coords[j]);
+    mpz_urandomm(coords[j], instance->state, instance->p);
+  }
 
-	determinant_mod(cofactor_matrix, result, n-1, p);
+  struct point_job job;
+  job.instance = instance;
+  job.last = last;
+  job.coords = (const mpz_t *)coords;
+  job.f = NULL;
+  job.point = NULL;
+
+  struct field f;
+  mp_limb_t *point = NULL;
+  mp_limb_t final[FIELD_MAX_LIMBS];
+  if (field_init(&f, instance->p))
+  {
+    point = (mp_limb_t *)malloc((size_t)(t - 1) * f.limbs * sizeof(mp_limb_t));
+    for (int j = 0; j < t - 1; j++)
+    {
+      field_import(point + (size_t)j * f.limbs, coords[j], &f);
+    }
+    field_import(final, coords[t - 1], &f);
+    job.f = &f;
+    job.point = point;
+  }
+  job.final = final;
+  thread_pool_run(instance->pool, instance->n, point_range, &job);
 
-	// result = result * (-1)^(x+y)
-	mpz_t sign;
-	mpz_init_set_si(sign, (long int) -1);
-	mpz_pow_ui(sign, sign, (x + y));
-	mpz_mul(*result, *result, sign);
-	mpz_fdiv_r(*result, *result, p);
-	mpz_clear(sign);
+  free(point);
+  for (int j = 0; j < t; j++)
+  {
+    mpz_clear(coords[j]);
+  }
+  free(coords);
+  return 1;
+}
 
-	// clearing cofactor_matrix
-	for (i = 0; i < n-1; i++) {
-		for (j = 0; j < n-1; j++) {
-			mpz_clear(cofactor_matrix[i][j]);
+// Share i is the hyperplane
+// 	share[i][0]*x[0] + ... + share[i][t-2]*x[t-2] - x[t-1] = -share[i][t-1]
+// and the secret is x[0] of the intersection point. mat is set to the
+// system of the quorum x[0] ... x[t-1], participants 1 ... n, or of 1 ... t
+// if x is NULL, with x[0] in the last column, so that it is what
+// solve_last_mod returns:
+// 	[-1, share[i][1], ..., share[i][t-2], share[i][0] | -share[i][t-1]]
+// with -1 and -share[i][t-1] taken mod p. Compressed shares are expanded
+// from their seeds straight into the matrix.
+static void quorum_matrix(struct matrix *mat, const struct blakely *instance, const int *x)
+{
+	int t = instance->t;
+	const struct matrix *shares = &instance->shares;
+	int w = shares->limbs;
+	init_matrix(mat, t, t + 1, w);
+	mpz_t minus_one, last;
+	mpz_init(minus_one);
+	mpz_init(last);
+	mpz_sub_ui(minus_one, instance->p, (unsigned long int) 1);
+	for (int i = 0; i < t; i++) {
+		int share = x != NULL ? x[i] - 1 : i;
+		if (instance->compressed) {
+			expand_row(mat, i, t - 1, instance->seeds + (size_t) share * SHARE_SEED_BYTES, instance->p, t);
+			matrix_get(last, shares, share, 0);
+		} else {
+			memcpy(matrix_entry(mat, i, 1), matrix_entry(shares, share, 1), (size_t) (t - 2) * w * sizeof(mp_limb_t));
+			memcpy(matrix_entry(mat, i, t - 1), matrix_entry(shares, share, 0), w * sizeof(mp_limb_t));
+			matrix_get(last, shares, share, t - 1);
+		}
+		matrix_set(mat, i, 0, minus_one);
+		if (mpz_sgn(last) != 0) {
+			mpz_sub(last, instance->p, last);
 		}
-		free(cofactor_matrix[i]);
+		matrix_set(mat, i, t, last);
 	}
-	free(cofactor_matrix);
-
-	return;
+	mpz_clear(minus_one);
+	mpz_clear(last);
 }
 
-
-int recover_secret(struct blakely *instance)
+int recover_blakely_secret(struct blakely *instance)
 {
 	if (instance->hasShares != 1) {
 		printf("Cannot recover secret if instance does not have shares.\n");
 		free(instance);
 		exit(EXIT_FAILURE);
 	}
-	
-	// 1. Get the determinant of the following square shares matrix:
-	// 		[share[0][0], ..., share[0][t-2], -1]
-	// 		[share[1][0], ..., share[1][t-2], -1]
-	// 		...             ...              ...
-	// 		[share[t-1][0], ..., share[t-1][t-2], -1]
-	mpz_t **mat;
-	mat = (mpz_t **) malloc((instance->t) * sizeof(mpz_t *));
-	for (int i = 0; i < (instance->t); i++) {
-		mat[i] = (mpz_t *) malloc((instance->t) * sizeof(mpz_t));
-		for (int j = 0; j  < (instance->t); j++) {
-			if (j != (instance->t) - 1) {
-				mpz_init_set(mat[i][j], (instance->shares)[i][j]);
-			} else {
-				mpz_init_set_si(mat[i][j], (long int) -1);
-			}
-		}
-	}
-	mpz_t *inv_det = (mpz_t *) malloc(1 * sizeof(mpz_t));
-	mpz_init(*inv_det);
-	determinant_mod(mat, inv_det, instance->t, instance->p);
-	
-	// 2. Find the inverse of the determinant mod p
-	mpz_invert(*inv_det, *inv_det, instance->p);
-
-	// 3. Get the top row of the transposed cofactor matrix from the above matrix
-	mpz_t *inv_mod_mat_row1;
-	inv_mod_mat_row1 = (mpz_t *) malloc((instance->t) * sizeof(mpz_t));
-	mpz_t result;
-	mpz_init(result);	
-	for (int i = 0; i < (instance->t); i++) {
-		mpz_init(inv_mod_mat_row1[i]);
-		get_cofactor(mat, &(inv_mod_mat_row1[i]), i, 0, instance->t, instance->p);
-		
-		// 4. Multiply this row vector by the inverse of the determinant found in 2.
-		mpz_mul(inv_mod_mat_row1[i], inv_mod_mat_row1[i], *inv_det);	
-		
-		// 5. mod each element by p
-		mpz_fdiv_r(inv_mod_mat_row1[i], inv_mod_mat_row1[i], instance->p);
-		
-		// 6. Find the dot product of that new row vector with the column vector:
-		// 		[-share[0][t-1], -share[1][t-1], ..., -share[t-1][t-1]]
-		mpz_submul(result, (instance->shares)[i][(instance->t)-1], inv_mod_mat_row1[i]);
-	
-		// 7. mod the result by p
-		mpz_fdiv_r(result, result, instance->p);
-	}
 
+	struct matrix mat;
+	quorum_matrix(&mat, instance, NULL);
 
-	// 8. check if it is the secret
-	int found_secret;
-	if (mpz_cmp(result, (instance->s)[0]) == 0) {
-		found_secret = 1;
-	} else {
-		found_secret = 0;
-	}
+	mpz_t result;
+	mpz_init(result);
+	int found_secret = solve_last_mod(result, &mat, instance->p, instance->pool) && mpz_cmp(result, (instance->s)[0]) == 0;
 
 	// free allocated vars
-	for (int i = 0; i < (instance->t); i++) {
-		for (int j = 0; j < (instance->t); j++) {
-			mpz_clear(mat[i][j]);
-		}
-		free(mat[i]);
-		mpz_clear(inv_mod_mat_row1[i]);
-	}
-	free(mat);
-	free(inv_mod_mat_row1);
+	free_matrix(&mat);
 	mpz_clear(result);
-	mpz_clear(*inv_det);
-	free(inv_det);
-
 
 	return found_secret;
 }
 
-// print mxn matrix of mpz_t
-void print_mpz_matrix (mpz_t **matrix, int m, int n) {
-	char *str;
-	for (int i = 0; i < m; i++) {
-		for (int j = 0; j < n; j++) {
-			str = mpz_get_str(NULL, 10, matrix[i][j]);
-			if (j == n - 1) {
-				printf("%s\n", str);
-			} else {
-				printf("%s, ", str);
-			}
-			free(str);
-		}
-	}
+// Precomputes the weights to recover from the shares of participants
+// x[0], ..., x[t-1], each one of 1 ... n. Returns NULL if the quorum is not
+// valid or its hyperplanes do not meet in a single point.
+struct blakely_recovery *init_blakely_recovery(struct blakely *instance, const int *x)
+{
+  if (instance->hasShares != 1)
+  {
+    printf("Blakely instance does not have shares to recover with.\n");
+    return NULL;
+  }
+  int t = instance->t;
+  char *seen = (char *)calloc(instance->n + 1, sizeof(char));
+  for (int j = 0; j < t; j++)
+  {
+    if (x[j] < 1 || x[j] > instance->n || seen[x[j]])
+    {
+      printf("Participant %d is not one of the %d participants or is in the quorum twice.\n", x[j], instance->n);
+      free(seen);
+      return NULL;
+    }
+    seen[x[j]] = 1;
+  }
+  free(seen);
+
+  // With A the quorum's matrix, the secret is row t-1 of A^-1 times the right
+  // hand sides -share[j][t-1], and that row u solves A^T u = e_(t-1).
+  struct matrix mat, transposed;
+  quorum_matrix(&mat, instance, x);
+  int w = mat.limbs;
+  init_matrix(&transposed, t, t + 1, w);
+  for (int i = 0; i < t; i++)
+  {
+    for (int j = 0; j < t; j++)
+    {
+      memcpy(matrix_entry(&transposed, j, i), matrix_entry(&mat, i, j), w * sizeof(mp_limb_t));
+    }
+  }
+  matrix_entry(&transposed, t - 1, t)[0] = 1;
+  free_matrix(&mat);
+
+  mpz_t *u = (mpz_t *)malloc(t * sizeof(mpz_t));
+  for (int j = 0; j < t; j++)
+  {
+    mpz_init(u[j]);
+  }
+  int solved = solve_mod(u, &transposed, instance->p, instance->pool);
+  free_matrix(&transposed);
+
+  struct blakely_recovery *context = NULL;
+  if (solved)
+  {
+    context = (struct blakely_recovery *)malloc(1 * sizeof(struct blakely_recovery));
+    context->t = t;
+    context->x = (int *)malloc(t * sizeof(int));
+    memcpy(context->x, x, t * sizeof(int));
+    mpz_init_set(context->p, instance->p);
+    context->fits = field_init(&context->f, instance->p);
+    init_matrix(&context->weights, 1, t, w);
+    for (int j = 0; j < t; j++)
+    {
+      // the right hand sides are negated shares, the weights take the sign
+      if (mpz_sgn(u[j]) != 0)
+      {
+        mpz_sub(u[j], instance->p, u[j]);
+      }
+      matrix_set(&context->weights, 0, j, u[j]);
+    }
+  }
+  else
+  {
+    printf("The hyperplanes of the quorum do not meet in a single point.\n");
+  }
+
+  for (int j = 0; j < t; j++)
+  {
+    mpz_clear(u[j]);
+  }
+  free(u);
+  return context;
+}
+
+void free_blakely_recovery(struct blakely_recovery *context)
+{
+  free_matrix(&context->weights);
+  free(context->x);
+  mpz_clear(context->p);
+  free(context);
 }
 
-void print_instance(struct blakely *instance)
+// secret = x[0] of the point where the quorum's hyperplanes meet, from last[j],
+// the last coordinate of participant x[j]'s share: one dot product with the
+// weights.
+void blakely_recover_with(mpz_t secret, const struct blakely_recovery *context, const mpz_t *last)
+{
+  int t = context->t;
+  if (context->fits)
+  {
+    const struct field *f = &context->f;
+    mp_limb_t *c = (mp_limb_t *)malloc((size_t)t * f->limbs * sizeof(mp_limb_t));
+    mp_limb_t r[FIELD_MAX_LIMBS];
+    for (int j = 0; j < t; j++)
+    {
+      field_import(c + (size_t)j * f->limbs, last[j], f);
+    }
+    f->ops->dot(r, matrix_entry(&context->weights, 0, 0), c, t, f);
+    field_export(secret, r, f);
+    free(c);
+    return;
+  }
+
+  mpz_t weight;
+  mpz_init(weight);
+  mpz_set_ui(secret, (unsigned long int)0);
+  for (int j = 0; j < t; j++)
+  {
+    matrix_get(weight, &context->weights, 0, j);
+    mpz_addmul(secret, weight, last[j]);
+  }
+  mpz_fdiv_r(secret, secret, context->p);
+  mpz_clear(weight);
+}
+
+void print_blakely_instance(struct blakely *instance)
 {
   if (instance->passedInit != 1)
   {
@@ -459,13 +667,28 @@ void print_instance(struct blakely *instance)
   // print shares
   if (instance->hasShares == 1)
   {
-    for (int i = 0; i < instance->n; i++)
+    mpz_t share;
+    mpz_init(share);
+    for (int i = 0; i < instance->n && instance->compressed; i++)
+    {
+      printf("Share %d: seed ", i + 1);
+      for (int b = 0; b < SHARE_SEED_BYTES; b++)
+      {
+        printf("%02x", (instance->seeds)[(size_t)i * SHARE_SEED_BYTES + b]);
+      }
+      matrix_get(share, &instance->shares, i, 0);
+      char *temp = mpz_get_str(NULL, 10, share);
+      printf(", last coordinate %s\n", temp);
+      free(temp);
+    }
+    for (int i = 0; i < instance->n && !instance->compressed; i++)
     {
       printf("Share %d: (", i + 1);
       for (int j = 0; j < instance->t; j++)
       {
         char *temp;
-        temp = mpz_get_str(NULL, 10, (instance->shares)[i][j]);
+        matrix_get(share, &instance->shares, i, j);
+        temp = mpz_get_str(NULL, 10, share);
         if (j == (instance->t) - 1)
         {
           printf("%s)\n", temp);
@@ -477,6 +700,7 @@ void print_instance(struct blakely *instance)
         free(temp);
       }
     }
+    mpz_clear(share);
   }
 
   return;
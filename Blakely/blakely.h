@@ -4,7 +4,17 @@
 #include <gmp.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/random.h>
+#include "../common/field.h"
+#include "../common/primes.h"
+#include "../common/chacha20.h"
+#include "../common/threadpool.h"
+#include "linalg.h"
+#include "../common/visibility.h"
+
+// bytes of the seed a compressed share's coordinates are expanded from
+#define SHARE_SEED_BYTES 32
 
 struct blakely {
   int t;
@@ -20,25 +30,54 @@ struct blakely {
   // big ints
   mpz_t *s; // secret is s[0]
   mpz_t p; // prime
-  mpz_t **shares; // shares
+  struct prime_provider primes; // where p comes from, the prime table by default
+  struct thread_pool *pool; // splits share generation and recovery across threads, NULL for serial
+  struct matrix shares; // share i is row i, one hyperplane, or only its last coordinate if compressed
+  int compressed; // shares keep a seed instead of their first t-1 coordinates
+  uint8_t *seeds; // participant i's seed at seeds + i * SHARE_SEED_BYTES, compressed shares only
 };
 
-void free_instance(struct blakely *);
+// The weights of a fixed quorum, so that it can recover any number of secrets
+// whose shares lie on the same hyperplanes and only differ in their last
+// coordinates. With A the quorum's system, the secret is one row of A^-1
+// times the last coordinates; that row is found once, by one elimination of
+// A^T, and every recovery after that is a dot product of t field elements.
+struct blakely_recovery
+{
+  int t;
+  int *x;                 // participants of the quorum
+  mpz_t p;
+  struct field f;         // over p, when fits
+  int fits;
+  struct matrix weights;  // 1 x t, secret = sum weights[j] * last coordinate of x[j] mod p
+};
+
+SECRET_SHARING_API void free_blakely_instance(struct blakely *);
+
+SECRET_SHARING_API struct blakely *init_blakely_instance(int, int, int);
+
+SECRET_SHARING_API void set_blakely_prime_source(struct blakely *, enum prime_source, struct prime_cache *);
+
+SECRET_SHARING_API void set_blakely_secret_below_p(struct blakely *, int);
+
+SECRET_SHARING_API void set_blakely_thread_pool(struct blakely *, struct thread_pool *);
+
+SECRET_SHARING_API void set_compressed_shares(struct blakely *, int);
 
-struct blakely *init_instance(int, int, int);
+SECRET_SHARING_API void generate_blakely_secret(struct blakely *);
 
-void generate_secret(struct blakely *);
+SECRET_SHARING_API void generate_blakely_shares(struct blakely *);
 
-void generate_shares(struct blakely *);
+SECRET_SHARING_API int share_blakely_secret(mpz_t *, struct blakely *, const mpz_t);
 
-void determinant_mod(mpz_t **, mpz_t *, int, mpz_t);
+SECRET_SHARING_API int recover_blakely_secret(struct blakely *);
 
-void get_cofactor(mpz_t **, mpz_t *, int, int, int, mpz_t);
+SECRET_SHARING_API struct blakely_recovery *init_blakely_recovery(struct blakely *, const int *);
 
-int recover_secret(struct blakely *);
+SECRET_SHARING_API void free_blakely_recovery(struct blakely_recovery *);
 
-void print_mpz_matrix(mpz_t **, int, int);
+SECRET_SHARING_API void blakely_recover_with(mpz_t, const struct blakely_recovery *, const mpz_t *);
 
-void print_instance(struct blakely *);
+SECRET_SHARING_API void print_blakely_instance(struct blakely *);
 
 #endif
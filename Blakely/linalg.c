@@ -0,0 +1,430 @@
+#include "linalg.h"
+
+// The arithmetic an elimination runs on: the field layer's kernels, with
+// entries in Montgomery form, when p fits it, and plain mpn calls on
+// residues otherwise.
+struct modulus
+{
+  struct field f;
+  int fits;           // f is usable
+  int w;              // limbs per entry
+  const mp_limb_t *p; // p on w limbs
+};
+
+static void init_modulus(struct modulus *mod, const mpz_t p)
+{
+  mod->fits = field_init(&mod->f, p);
+  if (mod->fits)
+  {
+    mod->w = mod->f.limbs;
+    mod->p = mod->f.p;
+  }
+  else
+  {
+    mod->w = (int)mpz_size(p);
+    mod->p = mpz_limbs_read(p);
+  }
+}
+
+// limbs per matrix entry for the prime p
+int matrix_limbs(const mpz_t p)
+{
+  struct modulus mod;
+  init_modulus(&mod, p);
+  return mod.w;
+}
+
+// m = rows x cols zero entries of limbs limbs each, in one allocation
+void init_matrix(struct matrix *m, int rows, int cols, int limbs)
+{
+  m->rows = rows;
+  m->cols = cols;
+  m->limbs = limbs;
+  m->data = (mp_limb_t *)calloc((size_t)rows * cols * limbs, sizeof(mp_limb_t));
+}
+
+void free_matrix(struct matrix *m)
+{
+  free(m->data);
+  m->data = NULL;
+}
+
+// entry (i, j) = v for 0 <= v < 2^(64 limbs)
+void matrix_set(struct matrix *m, int i, int j, const mpz_t v)
+{
+  mp_limb_t *e = matrix_entry(m, i, j);
+  size_t size = mpz_size(v);
+  memcpy(e, mpz_limbs_read(v), size * sizeof(mp_limb_t));
+  memset(e + size, 0, (m->limbs - size) * sizeof(mp_limb_t));
+}
+
+void matrix_get(mpz_t v, const struct matrix *m, int i, int j)
+{
+  mpz_t e;
+  mpz_set(v, mpz_roinit_n(e, matrix_entry(m, i, j), m->limbs));
+}
+
+static void to_working(mp_limb_t *e, const struct modulus *mod)
+{
+  if (mod->fits)
+  {
+    field_to_mont(e, e, &mod->f);
+  }
+}
+
+static void from_working(mp_limb_t *e, const struct modulus *mod)
+{
+  if (mod->fits)
+  {
+    field_from_mont(e, e, &mod->f);
+  }
+}
+
+// r = a * b mod p in working form
+static void mul_entry(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct modulus *mod)
+{
+  if (mod->fits)
+  {
+    mod->f.ops->mul(r, a, b, &mod->f);
+    return;
+  }
+  int w = mod->w;
+  mp_limb_t *t = (mp_limb_t *)malloc((3 * w + 1) * sizeof(mp_limb_t));
+  mpn_mul_n(t, a, b, w);
+  mpn_tdiv_qr(t + 2 * w, r, 0, t, 2 * w, mod->p, w);
+  free(t);
+}
+
+// y[k] = a * y[k] - b * x[k] mod p for 0 <= k < len, in working form
+static void combine_entries(mp_limb_t *y, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *x, int len,
+                            const struct modulus *mod)
+{
+  if (mod->fits)
+  {
+    mod->f.ops->combine(y, a, b, x, len, &mod->f);
+    return;
+  }
+  // a * y + (p - b) * x < 2p^2, reduced once
+  int w = mod->w;
+  mp_limb_t *nb = (mp_limb_t *)malloc((8 * w + 3) * sizeof(mp_limb_t));
+  mp_limb_t *t = nb + w;
+  mp_limb_t *u = t + 2 * w + 1;
+  mp_limb_t *q = u + 2 * w;
+  mpn_sub_n(nb, mod->p, b, w);
+  for (int k = 0; k < len; k++)
+  {
+    mp_limb_t *yk = y + (size_t)k * w;
+    mpn_mul_n(t, a, yk, w);
+    mpn_mul_n(u, nb, x + (size_t)k * w, w);
+    t[2 * w] = mpn_add_n(t, t, u, 2 * w);
+    mpn_tdiv_qr(q, yk, 0, t, 2 * w + 1, mod->p, w);
+  }
+  free(nb);
+}
+
+static void swap_entries(mp_limb_t *a, mp_limb_t *b, size_t limbs)
+{
+  for (size_t k = 0; k < limbs; k++)
+  {
+    mp_limb_t tmp = a[k];
+    a[k] = b[k];
+    b[k] = tmp;
+  }
+}
+
+// Applies the pivots first ... first+width-1 of a panel to the columns right
+// of it in rows begin ... end-1, which have their multipliers in the panel's
+// columns. The columns go by slices of about ELIMINATION_SLICE bytes, so that
+// a row's slice stays in cache while all of the panel's pivot rows update it.
+// Rows inside the panel only take the pivots above them.
+static void update_rows(struct matrix *a, const struct modulus *mod, int first, int width, int begin, int end)
+{
+  int w = mod->w;
+  int slice = ELIMINATION_SLICE / (w * (int)sizeof(mp_limb_t));
+  if (slice < 1)
+  {
+    slice = 1;
+  }
+  for (int c = first + width; c < a->cols; c += slice)
+  {
+    int len = a->cols - c < slice ? a->cols - c : slice;
+    for (int j = begin; j < end; j++)
+    {
+      for (int k = first; k < first + width && k < j; k++)
+      {
+        const mp_limb_t *entry = matrix_entry(a, j, k);
+        if (!mpn_zero_p(entry, w))
+        {
+          combine_entries(matrix_entry(a, j, c), matrix_entry(a, k, k), entry, matrix_entry(a, k, c), len, mod);
+        }
+      }
+    }
+  }
+}
+
+struct panel_job
+{
+  struct matrix *a;
+  const struct modulus *mod;
+  int first; // first column of the panel
+  int width; // columns in the panel
+  int rows;  // first row below the panel
+};
+
+static void update_range(void *arg, int begin, int end)
+{
+  struct panel_job *job = (struct panel_job *)arg;
+  update_rows(job->a, job->mod, job->first, job->width, job->rows + begin, job->rows + end);
+}
+
+// Brings columns 0 ... n-1 of the first n rows of a, in working form, to
+// upper triangular form in place; the entries below the diagonal are left as
+// they are and must not be read. Returns 0 as soon as a column has no pivot.
+// *swaps flips with every row swap, and scale, if not NULL, is multiplied by
+// the pivot once for every row it scales.
+//
+// Every row update is row_j = pivot * row_j - row_j[i] * row_i, which leaves
+// row_j[i] alone, so it keeps the multiplier. That lets the columns go by
+// panels of ELIMINATION_PANEL: the panel's columns are eliminated first, and
+// then the rows below take all of the panel's updates on the columns to the
+// right in one pass, split across pool's threads (NULL for serial). Every
+// entry goes through the same updates in the same order either way.
+static int triangularize(struct matrix *a, int n, const struct modulus *mod, int *swaps, mp_limb_t *scale,
+                         struct thread_pool *pool)
+{
+  int w = mod->w;
+  for (int first = 0; first < n; first += ELIMINATION_PANEL)
+  {
+    int width = n - first < ELIMINATION_PANEL ? n - first : ELIMINATION_PANEL;
+    for (int i = first; i < first + width; i++)
+    {
+      int index = i;
+      while (index < n && mpn_zero_p(matrix_entry(a, index, i), w))
+      {
+        index++;
+      }
+      if (index == n)
+      {
+        return 0;
+      }
+      if (index != i)
+      {
+        // the multipliers in the panel's columns go with their rows, the
+        // columns left of the panel are done in both rows
+        swap_entries(matrix_entry(a, i, first), matrix_entry(a, index, first), (size_t)(a->cols - first) * w);
+        *swaps ^= 1;
+      }
+
+      // row_j = pivot * row_j - row_j[i] * row_i on the panel's columns
+      // right of i
+      const mp_limb_t *pivot = matrix_entry(a, i, i);
+      for (int j = i + 1; j < n; j++)
+      {
+        const mp_limb_t *entry = matrix_entry(a, j, i);
+        if (mpn_zero_p(entry, w))
+        {
+          continue;
+        }
+        combine_entries(matrix_entry(a, j, i + 1), pivot, entry, matrix_entry(a, i, i + 1), first + width - i - 1, mod);
+        if (scale != NULL)
+        {
+          mul_entry(scale, scale, pivot, mod);
+        }
+      }
+    }
+
+    // the panel's own rows first, each one takes the pivots above it and is
+    // then a pivot row for the rest
+    update_rows(a, mod, first, width, first + 1, first + width);
+    struct panel_job job;
+    job.a = a;
+    job.mod = mod;
+    job.first = first;
+    job.width = width;
+    job.rows = first + width;
+    thread_pool_run(pool, n - first - width, update_range, &job);
+  }
+  return 1;
+}
+
+// x = num / den mod p for plain residues num and den != 0 on w limbs
+static void divide_entries(mpz_t x, const mp_limb_t *num, const mp_limb_t *den, int w, const mpz_t p)
+{
+  mpz_t n, d, inv;
+  mpz_init(inv);
+  mpz_invert(inv, mpz_roinit_n(d, den, w), p);
+  mpz_mul(x, mpz_roinit_n(n, num, w), inv);
+  mpz_fdiv_r(x, x, p);
+  mpz_clear(inv);
+}
+
+// Solves the n x n system with row i a[i][0] x[0] + ... + a[i][n-1] x[n-1]
+// = a[i][n] mod p, for the n x (n+1) matrix a of residues below p with
+// matrix_limbs(p) limbs, and sets x to x[n-1]. a is used as the elimination's
+// scratch space and overwritten. The elimination is split across pool's
+// threads, NULL for serial. Returns 0, leaving x alone, if the system is
+// singular.
+int solve_last_mod(mpz_t x, struct matrix *a, const mpz_t p, struct thread_pool *pool)
+{
+  struct modulus mod;
+  init_modulus(&mod, p);
+  int n = a->rows;
+  for (size_t k = 0; k < (size_t)n * a->cols; k++)
+  {
+    to_working(a->data + k * mod.w, &mod);
+  }
+  int swaps = 0;
+  if (!triangularize(a, n, &mod, &swaps, NULL, pool))
+  {
+    return 0;
+  }
+  mp_limb_t *num = matrix_entry(a, n - 1, n);
+  mp_limb_t *den = matrix_entry(a, n - 1, n - 1);
+  from_working(num, &mod);
+  from_working(den, &mod);
+  divide_entries(x, num, den, mod.w, p);
+  return 1;
+}
+
+// The same system as solve_last_mod, but sets x[0 ... n-1] to the whole
+// solution, by back substitution on the triangular matrix. Returns 0, leaving
+// x alone, if the system is singular.
+int solve_mod(mpz_t *x, struct matrix *a, const mpz_t p, struct thread_pool *pool)
+{
+  struct modulus mod;
+  init_modulus(&mod, p);
+  int n = a->rows;
+  int w = mod.w;
+  for (size_t k = 0; k < (size_t)n * a->cols; k++)
+  {
+    to_working(a->data + k * w, &mod);
+  }
+  int swaps = 0;
+  if (!triangularize(a, n, &mod, &swaps, NULL, pool))
+  {
+    return 0;
+  }
+
+  // x[i] = (a[i][n] - a[i][i+1] x[i+1] - ... - a[i][n-1] x[n-1]) / a[i][i]
+  mpz_t sum, inv, e;
+  mpz_init(sum);
+  mpz_init(inv);
+  for (int i = n - 1; i >= 0; i--)
+  {
+    for (int k = i; k <= n; k++)
+    {
+      from_working(matrix_entry(a, i, k), &mod);
+    }
+    mpz_set(sum, mpz_roinit_n(e, matrix_entry(a, i, n), w));
+    for (int k = i + 1; k < n; k++)
+    {
+      mpz_submul(sum, mpz_roinit_n(e, matrix_entry(a, i, k), w), x[k]);
+    }
+    mpz_invert(inv, mpz_roinit_n(e, matrix_entry(a, i, i), w), p);
+    mpz_mul(x[i], sum, inv);
+    mpz_fdiv_r(x[i], x[i], p);
+  }
+  mpz_clear(sum);
+  mpz_clear(inv);
+  return 1;
+}
+
+// Find the determinant of the top left n x n block of matrix mod p, with
+// entries below p, and return in result.
+void determinant_mod(const struct matrix *matrix, mpz_t *result, int n, mpz_t p)
+{
+  struct modulus mod;
+  init_modulus(&mod, p);
+  int w = mod.w;
+  struct matrix m_copy;
+  init_matrix(&m_copy, n, n, w);
+  for (int i = 0; i < n; i++)
+  {
+    memcpy(matrix_entry(&m_copy, i, 0), matrix_entry(matrix, i, 0), (size_t)n * w * sizeof(mp_limb_t));
+  }
+  for (size_t k = 0; k < (size_t)n * n; k++)
+  {
+    to_working(m_copy.data + k * w, &mod);
+  }
+
+  // every row update multiplied the determinant by its pivot, which scale
+  // collects, so det = product of the diagonal / scale
+  mp_limb_t *scale = (mp_limb_t *)calloc(2 * w, sizeof(mp_limb_t));
+  mp_limb_t *det = scale + w;
+  scale[0] = 1;
+  to_working(scale, &mod);
+  memcpy(det, scale, w * sizeof(mp_limb_t));
+  int negative = 0;
+  if (!triangularize(&m_copy, n, &mod, &negative, scale, NULL))
+  {
+    mpz_set_ui(*result, (unsigned long int)0);
+  }
+  else
+  {
+    for (int i = 0; i < n; i++)
+    {
+      mul_entry(det, det, matrix_entry(&m_copy, i, i), &mod);
+    }
+    from_working(det, &mod);
+    from_working(scale, &mod);
+    divide_entries(*result, det, scale, w, p);
+    if (negative)
+    {
+      mpz_neg(*result, *result);
+      mpz_fdiv_r(*result, *result, p);
+    }
+  }
+  free(scale);
+  free_matrix(&m_copy);
+}
+
+// Function to get the cofactor of the top left n x n block of matrix at
+// position (x, y) and return as result.
+void get_cofactor(const struct matrix *matrix, mpz_t *result, int x, int y, int n, mpz_t p)
+{
+  struct matrix minor;
+  init_matrix(&minor, n - 1, n - 1, matrix->limbs);
+  for (int row = 0, i = 0; row < n; row++)
+  {
+    if (row == x)
+    {
+      continue;
+    }
+    for (int col = 0, j = 0; col < n; col++)
+    {
+      if (col != y)
+      {
+        memcpy(matrix_entry(&minor, i, j++), matrix_entry(matrix, row, col), matrix->limbs * sizeof(mp_limb_t));
+      }
+    }
+    i++;
+  }
+
+  determinant_mod(&minor, result, n - 1, p);
+
+  // result = result * (-1)^(x+y)
+  if ((x + y) % 2 == 1)
+  {
+    mpz_neg(*result, *result);
+    mpz_fdiv_r(*result, *result, p);
+  }
+  free_matrix(&minor);
+}
+
+// print the matrix, one row per line
+void print_matrix(const struct matrix *matrix)
+{
+  mpz_t e;
+  mpz_init(e);
+  for (int i = 0; i < matrix->rows; i++)
+  {
+    for (int j = 0; j < matrix->cols; j++)
+    {
+      matrix_get(e, matrix, i, j);
+      char *str = mpz_get_str(NULL, 10, e);
+      printf(j == matrix->cols - 1 ? "%s\n" : "%s, ", str);
+      free(str);
+    }
+  }
+  mpz_clear(e);
+}
@@ -0,0 +1,63 @@
+// Modular linear algebra for Blakely recovery.
+//
+// The shares of a quorum are t hyperplanes whose intersection is the point
+// (s[0], ..., s[t-1]), so recovery is one t x t linear system mod p. It is
+// solved by Gaussian elimination on the augmented matrix: a row with a
+// nonzero entry is pivoted into place for each column, and every row below
+// is updated as pivot * row - entry * pivot row, which needs no inverse. The
+// caller puts the unknown it wants in the last column, so once the matrix is
+// triangular that unknown is the last right hand side over the last pivot and
+// there is no back substitution.
+//
+// Matrices are one row-major block of fixed-width entries, matrix_limbs(p)
+// limbs each: the field layer's element size when p fits it, so that rows go
+// straight into its kernels, and p's size otherwise.
+#ifndef BLAKELY_LINALG_HEADER
+#define BLAKELY_LINALG_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../common/field.h"
+#include "../common/threadpool.h"
+
+// columns eliminated together, the rows below take their updates in one pass
+#define ELIMINATION_PANEL 16
+
+// bytes of a row updated by a whole panel while it stays in cache
+#define ELIMINATION_SLICE 4096
+
+struct matrix {
+  int rows;
+  int cols;
+  int limbs;       // limbs per entry
+  mp_limb_t *data; // entry (i, j) at data + (i * cols + j) * limbs, NULL before init_matrix
+};
+
+static inline mp_limb_t *matrix_entry(const struct matrix *m, int i, int j)
+{
+  return m->data + ((size_t)i * m->cols + j) * m->limbs;
+}
+
+int matrix_limbs(const mpz_t);
+
+void init_matrix(struct matrix *, int, int, int);
+
+void free_matrix(struct matrix *);
+
+void matrix_set(struct matrix *, int, int, const mpz_t);
+
+void matrix_get(mpz_t, const struct matrix *, int, int);
+
+int solve_last_mod(mpz_t, struct matrix *, const mpz_t, struct thread_pool *);
+
+int solve_mod(mpz_t *, struct matrix *, const mpz_t, struct thread_pool *);
+
+void determinant_mod(const struct matrix *, mpz_t *, int, mpz_t);
+
+void get_cofactor(const struct matrix *, mpz_t *, int, int, int, mpz_t);
+
+void print_matrix(const struct matrix *);
+
+#endif
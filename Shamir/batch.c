@@ -0,0 +1,321 @@
+#include "batch.h"
+
+void free_batch(struct shamir_batch *batch)
+{
+	if (batch->passedInit != 1) { // nothing aside from the struct was allocated
+		free(batch);
+		return;
+	}
+
+	memset(&(batch->rng), 0, sizeof(batch->rng));
+	if (batch->hasSecrets) {
+		memset(batch->secrets, 0, (size_t) batch->count * batch->f.limbs * sizeof(mp_limb_t));
+		memset(batch->coeffs, 0, (size_t) batch->t * batch->count * batch->f.limbs * sizeof(mp_limb_t));
+	}
+	free(batch->secrets);
+	free(batch->coeffs);
+	free(batch->shares);
+	mpz_clear(batch->p);
+	free(batch);
+}
+
+// Allocates a batch of count secrets, each shared (t,n) with security lambda.
+// The arrays are only allocated once the secrets fix the prime.
+struct shamir_batch *init_batch(int t, int n, int lambda, int count)
+{
+	struct shamir_batch *batch;
+	batch = (struct shamir_batch *) malloc(1 * sizeof(struct shamir_batch));
+	batch->passedInit = 0;
+	batch->hasSecrets = 0;
+	batch->hasShares = 0;
+
+	if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > MAX_PARTICIPANTS || count < 1) {
+		printf("Shamir batch of %d (%d,%d) secrets with security %d is not valid.\n", count, t, n, lambda);
+		free_batch(batch);
+		exit(EXIT_FAILURE);
+	}
+
+	batch->t = t;
+	batch->n = n;
+	batch->lambda = lambda;
+	batch->count = count;
+	batch->words = (lambda + 63) / 64;
+	chacha20_seed(&(batch->rng));
+	batch->pool = NULL;
+	mpz_init(batch->p);
+	batch->secrets = NULL;
+	batch->coeffs = NULL;
+	batch->shares = NULL;
+
+	batch->passedInit = 1;
+	return batch;
+}
+
+// Splits share generation across pool's threads, which is not owned by the
+// batch. NULL goes back to serial.
+void set_batch_thread_pool(struct shamir_batch *batch, struct thread_pool *pool)
+{
+	batch->pool = pool;
+}
+
+// Fixes the prime and allocates the arrays for it: the table prime below
+// 2^lambda, or below 2^(lambda + 1) if some secret is not below that.
+static int batch_field(struct shamir_batch *batch, int wide)
+{
+	table_prime(batch->p, wide ? batch->lambda + 1 : batch->lambda);
+	if (!field_init(&(batch->f), batch->p)) {
+		return 0;
+	}
+	size_t elements = (size_t) batch->count * batch->f.limbs;
+	batch->secrets = (mp_limb_t *) malloc(elements * sizeof(mp_limb_t));
+	batch->coeffs = (mp_limb_t *) malloc(batch->t * elements * sizeof(mp_limb_t));
+	batch->shares = (mp_limb_t *) malloc(batch->n * elements * sizeof(mp_limb_t));
+	batch->hasSecrets = 1;
+	return 1;
+}
+
+// r = uniform element below p, by rejection from p's limbs with the bits
+// above its top bit masked off
+static void random_below(mp_limb_t *r, struct chacha20 *rng, const struct field *f)
+{
+	mp_limb_t mask = ~(mp_limb_t) 0 >> __builtin_clzll(f->p[f->psize - 1]);
+	do {
+		chacha20_bytes(rng, (uint8_t *) r, (size_t) f->psize * sizeof(mp_limb_t));
+		r[f->psize - 1] &= mask;
+	} while (mpn_cmp(r, f->p, f->psize) >= 0);
+	for (int k = f->psize; k < f->limbs; k++) {
+		r[k] = 0;
+	}
+}
+
+// Takes the secrets as count consecutive blocks of batch->words limbs, least
+// significant limb first, each below 2^lambda.
+void set_batch_secrets(struct shamir_batch *batch, const mp_limb_t *secrets)
+{
+	if (batch->passedInit != 1 || batch->hasSecrets != 0) {
+		printf("Batch has not been initialized or already has secrets.\n");
+		return;
+	}
+
+	mpz_t s;
+	int wide = 0;
+	table_prime(batch->p, batch->lambda);
+	for (int i = 0; i < batch->count; i++) {
+		mpz_roinit_n(s, secrets + (size_t) i * batch->words, batch->words);
+		if (mpz_sizeinbase(s, 2) > (size_t) batch->lambda) {
+			printf("Secret %d of the batch is longer than %d bits.\n", i, batch->lambda);
+			return;
+		}
+		if (mpz_cmp(s, batch->p) >= 0) {
+			wide = 1;
+		}
+	}
+	batch_field(batch, wide);
+
+	int L = batch->f.limbs;
+	for (int i = 0; i < batch->count; i++) {
+		mp_limb_t *r = batch->secrets + (size_t) i * L;
+		int w = batch->words < L ? batch->words : L;
+		memcpy(r, secrets + (size_t) i * batch->words, w * sizeof(mp_limb_t));
+		memset(r + w, 0, (L - w) * sizeof(mp_limb_t));
+	}
+}
+
+// Draws count random secrets below the table prime of lambda bits.
+void generate_batch_secrets(struct shamir_batch *batch)
+{
+	if (batch->passedInit != 1 || batch->hasSecrets != 0) {
+		printf("Batch has not been initialized or already has secrets.\n");
+		return;
+	}
+
+	batch_field(batch, 0);
+	for (int i = 0; i < batch->count; i++) {
+		random_below(batch->secrets + (size_t) i * batch->f.limbs, &(batch->rng), &(batch->f));
+	}
+}
+
+struct batch_job {
+	struct shamir_batch *batch;
+	uint8_t key[32];           // key of the per-chunk coefficient streams
+	mp_limb_t scale[FIELD_MAX_LIMBS]; // turns a secret into its horner coefficient
+};
+
+// Chunks begin ... end-1 of BATCH_CHUNK secrets each: draw the random
+// coefficients of the chunk from its own ChaCha20 stream, nonce = chunk index,
+// then evaluate the chunk for every participant while its coefficients are
+// still in cache. The output only depends on the key, not on the threads.
+static void chunk_range(void *arg, int begin, int end)
+{
+	struct batch_job *job = (struct batch_job *) arg;
+	struct shamir_batch *batch = job->batch;
+	const struct field *f = &(batch->f);
+	int L = f->limbs;
+	struct chacha20 rng;
+
+	for (int c = begin; c < end; c++) {
+		int s0 = c * BATCH_CHUNK;
+		int cn = batch->count - s0 < BATCH_CHUNK ? batch->count - s0 : BATCH_CHUNK;
+
+		// the random coefficients are uniform below p, and so is any fixed
+		// multiple of them, so they are drawn directly in horner layout
+		chacha20_init(&rng, job->key, (uint64_t) c);
+		for (int s = s0; s < s0 + cn; s++) {
+			f->ops->mul(batch->coeffs + (size_t) s * L, batch->secrets + (size_t) s * L, job->scale, f);
+		}
+		for (int j = 1; j < batch->t; j++) {
+			for (int s = s0; s < s0 + cn; s++) {
+				random_below(batch->coeffs + ((size_t) j * batch->count + s) * L, &rng, f);
+			}
+		}
+
+		for (int i = 0; i < batch->n; i++) {
+			f->ops->horner_batch(batch->shares + ((size_t) i * batch->count + s0) * L, batch->coeffs + (size_t) s0 * L,
+			                     batch->t, cn, batch->count, (mp_limb_t) (i + 1), f);
+		}
+	}
+	memset(&rng, 0, sizeof(rng));
+}
+
+void generate_batch_shares(struct shamir_batch *batch)
+{
+	if (batch->hasSecrets != 1 || batch->hasShares != 0) {
+		printf("Cannot generate shares on a batch without secrets or that already has shares.\n");
+		return;
+	}
+
+	struct batch_job job;
+	job.batch = batch;
+	chacha20_bytes(&(batch->rng), job.key, sizeof(job.key));
+
+	// the horner kernels want c[0] * 2^64 mod p for Montgomery fields, which
+	// a Montgomery multiplication by 2^64 * R gives; special fields take c[0]
+	if (batch->f.special) {
+		memcpy(job.scale, batch->f.one, sizeof(job.scale));
+	} else {
+		mpz_t scale;
+		mpz_init(scale);
+		mpz_setbit(scale, (mp_bitcnt_t) 64 * (batch->f.limbs + 1));
+		mpz_mod(scale, scale, batch->p);
+		field_import(job.scale, scale, &(batch->f));
+		mpz_clear(scale);
+	}
+
+	int chunks = (batch->count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+	thread_pool_run(batch->pool, chunks, chunk_range, &job);
+	memset(job.key, 0, sizeof(job.key));
+
+	batch->hasShares = 1;
+}
+
+// Chunks begin ... end-1 of a refresh: draws the chunk's update polynomials
+// with zero constant terms from the chunk's own stream and adds them to the
+// coefficients and their values to every participant's shares.
+static void refresh_range(void *arg, int begin, int end)
+{
+	struct batch_job *job = (struct batch_job *) arg;
+	struct shamir_batch *batch = job->batch;
+	const struct field *f = &(batch->f);
+	int L = f->limbs;
+	mp_limb_t *delta = (mp_limb_t *) malloc((size_t) batch->t * BATCH_CHUNK * L * sizeof(mp_limb_t));
+	mp_limb_t *values = (mp_limb_t *) malloc((size_t) BATCH_CHUNK * L * sizeof(mp_limb_t));
+	struct chacha20 rng;
+
+	for (int c = begin; c < end; c++) {
+		int s0 = c * BATCH_CHUNK;
+		int cn = batch->count - s0 < BATCH_CHUNK ? batch->count - s0 : BATCH_CHUNK;
+
+		// delta is drawn in horner layout like the coefficients, which it is
+		// added to, and its constant terms are zero in any layout
+		chacha20_init(&rng, job->key, (uint64_t) c);
+		memset(delta, 0, (size_t) cn * L * sizeof(mp_limb_t));
+		for (int j = 1; j < batch->t; j++) {
+			for (int s = 0; s < cn; s++) {
+				mp_limb_t *d = delta + ((size_t) j * cn + s) * L;
+				mp_limb_t *coeff = batch->coeffs + ((size_t) j * batch->count + s0 + s) * L;
+				random_below(d, &rng, f);
+				f->ops->add(coeff, coeff, d, f);
+			}
+		}
+
+		for (int i = 0; i < batch->n; i++) {
+			f->ops->horner_batch(values, delta, batch->t, cn, cn, (mp_limb_t) (i + 1), f);
+			mp_limb_t *share = batch->shares + ((size_t) i * batch->count + s0) * L;
+			for (int s = 0; s < cn; s++) {
+				f->ops->add(share + (size_t) s * L, share + (size_t) s * L, values + (size_t) s * L, f);
+			}
+		}
+	}
+	memset(&rng, 0, sizeof(rng));
+	memset(delta, 0, (size_t) batch->t * BATCH_CHUNK * L * sizeof(mp_limb_t));
+	free(delta);
+	free(values);
+}
+
+// Proactive refresh of every secret of the batch: each one gets a fresh
+// random polynomial with a zero constant term added, so all shares change
+// and no secret does. The prime and the secrets are never touched.
+void refresh_batch(struct shamir_batch *batch)
+{
+	if (batch->hasShares != 1) {
+		printf("Cannot refresh a batch without shares.\n");
+		return;
+	}
+
+	struct batch_job job;
+	job.batch = batch;
+	chacha20_bytes(&(batch->rng), job.key, sizeof(job.key));
+	int chunks = (batch->count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+	thread_pool_run(batch->pool, chunks, refresh_range, &job);
+	memset(job.key, 0, sizeof(job.key));
+}
+
+// share = participant i's share of secret s
+void get_batch_share(mpz_t share, const struct shamir_batch *batch, int i, int s)
+{
+	field_export(share, batch->shares + ((size_t) i * batch->count + s) * batch->f.limbs, &(batch->f));
+}
+
+// Recovers count secrets at once from the quorum's shares, laid out like
+// batch->shares: ys[(i * count + s) * L] is the share of secret s held by the
+// participant with x-coordinate context->x[i]. Secret s goes to out[s * L].
+// The context must be for the batch's prime.
+void recover_batch_with(mp_limb_t *out, const struct shamir_recovery *context, const mp_limb_t *ys, int count)
+{
+	const struct field *f = &(context->f);
+	int L = f->limbs;
+	mp_limb_t *y = (mp_limb_t *) malloc((size_t) context->k * L * sizeof(mp_limb_t));
+	for (int s = 0; s < count; s++) {
+		for (int i = 0; i < context->k; i++) {
+			memcpy(y + (size_t) i * L, ys + ((size_t) i * count + s) * L, L * sizeof(mp_limb_t));
+		}
+		f->ops->dot(out + (size_t) s * L, y, context->coeff_limbs, context->k, f);
+	}
+	free(y);
+}
+
+// Recovers every secret from participants 1, ..., t. Returns 1 if all match.
+int recover_batch_secrets(struct shamir_batch *batch)
+{
+	if (batch->hasShares != 1) {
+		printf("Cannot recover secrets if no shares exist.\n");
+		return 0;
+	}
+
+	int *x = (int *) malloc(batch->t * sizeof(int));
+	for (int i = 0; i < batch->t; i++) {
+		x[i] = i + 1;
+	}
+	struct shamir_recovery *context = init_shamir_recovery(x, batch->t, batch->p);
+	free(x);
+
+	// participants 1 ... t hold the first t blocks of shares
+	size_t size = (size_t) batch->count * batch->f.limbs * sizeof(mp_limb_t);
+	mp_limb_t *out = (mp_limb_t *) malloc(size);
+	recover_batch_with(out, context, batch->shares, batch->count);
+	int found = memcmp(out, batch->secrets, size) == 0;
+
+	free(out);
+	free_shamir_recovery(context);
+	return found;
+}
@@ -0,0 +1,70 @@
+// Shamir sharing of many secrets at once under one prime and one set of
+// participants.
+//
+// Everything is kept on the fixed-limb field layer in structure-of-arrays
+// form, so the evaluation loop runs across secrets with the polynomial
+// coefficients of a chunk of secrets in cache. With L = f.limbs limbs per
+// element:
+//
+// 	secrets[s * L]                  secret s
+// 	coeffs[(j * count + s) * L]     coefficient j of secret s's polynomial
+// 	shares[(i * count + s) * L]     participant i's share of secret s, at x = i + 1
+//
+// so participant i's shares of every secret are one contiguous block.
+#ifndef SHAMIR_BATCH_HEADER
+#define SHAMIR_BATCH_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "shamir.h"
+#include "../common/chacha20.h"
+#include "../common/visibility.h"
+
+// secrets whose coefficients are drawn and evaluated together, by one thread
+#define BATCH_CHUNK 1024
+
+struct shamir_batch {
+  int t;
+  int n;
+  int lambda;
+  int count;  // number of secrets
+  int words;  // limbs per secret passed to set_batch_secrets, lambda / 64 rounded up
+
+  // flags
+  int passedInit;
+  int hasSecrets;
+  int hasShares;
+
+  struct chacha20 rng; // secrets and the keys of the per-chunk coefficient streams
+  struct thread_pool *pool; // NULL for serial
+
+  mpz_t p;
+  struct field f;
+  mp_limb_t *secrets;
+  mp_limb_t *coeffs; // stored the way the horner kernels want them, see field_horner_coeffs
+  mp_limb_t *shares;
+};
+
+SECRET_SHARING_API struct shamir_batch *init_batch(int, int, int, int);
+
+SECRET_SHARING_API void free_batch(struct shamir_batch *);
+
+SECRET_SHARING_API void set_batch_thread_pool(struct shamir_batch *, struct thread_pool *);
+
+SECRET_SHARING_API void set_batch_secrets(struct shamir_batch *, const mp_limb_t *);
+
+SECRET_SHARING_API void generate_batch_secrets(struct shamir_batch *);
+
+SECRET_SHARING_API void generate_batch_shares(struct shamir_batch *);
+
+SECRET_SHARING_API void refresh_batch(struct shamir_batch *);
+
+SECRET_SHARING_API void get_batch_share(mpz_t, const struct shamir_batch *, int, int);
+
+SECRET_SHARING_API void recover_batch_with(mp_limb_t *, const struct shamir_recovery *, const mp_limb_t *, int);
+
+SECRET_SHARING_API int recover_batch_secrets(struct shamir_batch *);
+
+#endif
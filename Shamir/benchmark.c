@@ -1,6 +1,515 @@
+#define _POSIX_C_SOURCE 199309L
 #include "shamir.h"
+#include "batch.h"
+#include "packed.h"
+#include "feldman.h"
+#include "reshare.h"
+#include "stream.h"
+#include "decode.h"
 #include <stdio.h>
 #include <gmp.h>
+#include <time.h>
+
+// prime sizes compared by "compare": 64, the special form prime sizes and 512
+static const int compare_lambdas[] = {64, 89, 127, 192, 255, 384, 512};
+
+// average milliseconds for a whole init, share and recover run with primes
+// from source, repeated for at least 0.2 seconds
+static double time_runs(int t, int n, int lambda, enum prime_source source)
+{
+  struct timespec start, now;
+  double elapsed;
+  int runs = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    struct shamir *instance = init_shamir_instance(t, n, lambda);
+    set_shamir_prime_source(instance, source, NULL);
+    generate_shamir_secret(instance);
+    generate_shamir_shares(instance);
+    if (recover_shamir_secret(instance) != 1)
+    {
+      printf("Secret not recovered at lambda %d.\n", lambda);
+    }
+    free_shamir_instance(instance);
+    runs++;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+  } while (elapsed < 0.2);
+  return elapsed * 1000 / runs;
+}
+
+// prints the time per run with random, table and special form primes
+static void compare_primes(int t, int n)
+{
+  printf("lambda   random ms   table ms   special ms   random/special\n");
+  for (size_t i = 0; i < sizeof(compare_lambdas) / sizeof(compare_lambdas[0]); i++)
+  {
+    int lambda = compare_lambdas[i];
+    double random = time_runs(t, n, lambda, PRIME_RANDOM);
+    double table = time_runs(t, n, lambda, PRIME_TABLE);
+    double special = time_runs(t, n, lambda, PRIME_SPECIAL);
+    printf("%6d %11.3f %10.3f %12.3f %16.1f\n", lambda, random, table, special, random / special);
+  }
+}
+
+static double seconds_since(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// shares count secrets one instance at a time and then as one batch, and
+// prints the secrets per second of both
+static void compare_batch(int t, int n, int lambda, int count, struct thread_pool *pool)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < count; i++)
+  {
+    struct shamir *instance = init_shamir_instance(t, n, lambda);
+    set_shamir_thread_pool(instance, pool);
+    generate_shamir_secret(instance);
+    generate_shamir_shares(instance);
+    free_shamir_instance(instance);
+  }
+  double single = seconds_since(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct shamir_batch *batch = init_batch(t, n, lambda, count);
+  set_batch_thread_pool(batch, pool);
+  generate_batch_secrets(batch);
+  generate_batch_shares(batch);
+  double batched = seconds_since(&start);
+
+  printf("%d secrets: %.0f secrets/s one instance each, %.0f secrets/s as a batch (%.1fx)\n",
+         count, count / single, count / batched, single / batched);
+  printf("Secrets recovered: %d\n", recover_batch_secrets(batch));
+  free_batch(batch);
+}
+
+// shares k secrets with k plain (t,n) instances and then with one packed
+// instance that any t + k - 1 participants recover, and prints the time and
+// the number of shares of both
+static void compare_packed(int t, int n, int lambda, int k, struct thread_pool *pool)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int found = 1;
+  for (int j = 0; j < k; j++)
+  {
+    struct shamir *instance = init_shamir_instance(t, n, lambda);
+    set_shamir_thread_pool(instance, pool);
+    generate_shamir_secret(instance);
+    generate_shamir_shares(instance);
+    found &= recover_shamir_secret(instance);
+    free_shamir_instance(instance);
+  }
+  double plain = seconds_since(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct shamir_packed *packed = init_packed(t, k, n, lambda);
+  set_packed_thread_pool(packed, pool);
+  generate_packed_secrets(packed);
+  generate_packed_shares(packed);
+  int packed_found = recover_packed_secrets(packed);
+  double time = seconds_since(&start);
+  free_packed(packed);
+
+  printf("%d secrets: %d plain instances %.3f ms, %d shares; packed %.3f ms, %d shares (%.1fx)\n",
+         k, k, plain * 1000, k * n, time * 1000, n, plain / time);
+  printf("Secrets recovered: %d plain, %d packed\n", found, packed_found);
+}
+
+// times Feldman commitments and share verification in a group of bits bits,
+// in units of one exponentiation g^y mod P
+static void time_feldman(int t, int n, int lambda, int bits)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct feldman *vss = init_feldman(instance, bits);
+  double setup = seconds_since(&start);
+
+  mpz_t r;
+  mpz_init(r);
+  int reps = 20;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < reps; i++)
+  {
+    mpz_powm(r, vss->g, (instance->shares)[i % n], vss->P);
+  }
+  double one = seconds_since(&start) / reps;
+  mpz_clear(r);
+
+  int ok = 1;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < reps; i++)
+  {
+    ok &= verify_share(vss, i % n + 1, (instance->shares)[i % n]);
+  }
+  double single = seconds_since(&start) / reps;
+
+  int *x = (int *)malloc(n * sizeof(int));
+  for (int i = 0; i < n; i++)
+  {
+    x[i] = i + 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ok &= verify_shares(vss, x, instance->shares, n, instance->state);
+  double batch = seconds_since(&start);
+
+  // one bad share must fail the combined check
+  mpz_add_ui((instance->shares)[n / 2], (instance->shares)[n / 2], 1);
+  int caught = !verify_shares(vss, x, instance->shares, n, instance->state);
+
+  printf("%d bit group: one exponentiation %.3f ms, group and commitments %.1f ms\n", (int)mpz_sizeinbase(vss->P, 2),
+         one * 1000, setup * 1000);
+  printf("verify one share %.3f ms (%.1f exps), all %d shares at once %.3f ms (%.1f exps, %.1f per share)\n",
+         single * 1000, single / one, n, batch * 1000, batch / one, batch / one / n);
+  printf("Shares verified: %d, bad share caught: %d\n", ok, caught);
+
+  free(x);
+  free_feldman(vss);
+  free_shamir_instance(instance);
+}
+
+// rotates the shares of count secrets by redealing them from recovered
+// secrets and then with refresh_batch, and prints the secrets per second
+static void compare_refresh(int t, int n, int lambda, int count, struct thread_pool *pool)
+{
+  struct shamir_batch *batch = init_batch(t, n, lambda, count);
+  set_batch_thread_pool(batch, pool);
+  generate_batch_secrets(batch);
+  generate_batch_shares(batch);
+
+  // redeal: recover every secret from participants 1 ... t and share it anew
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int *x = (int *)malloc(t * sizeof(int));
+  for (int i = 0; i < t; i++)
+  {
+    x[i] = i + 1;
+  }
+  struct shamir_recovery *context = init_shamir_recovery(x, t, batch->p);
+  mp_limb_t *secrets = (mp_limb_t *)malloc((size_t)count * batch->f.limbs * sizeof(mp_limb_t));
+  recover_batch_with(secrets, context, batch->shares, count);
+  struct shamir_batch *redealt = init_batch(t, n, lambda, count);
+  set_batch_thread_pool(redealt, pool);
+  generate_batch_secrets(redealt);
+  memcpy(redealt->secrets, secrets, (size_t)count * batch->f.limbs * sizeof(mp_limb_t));
+  generate_batch_shares(redealt);
+  double redeal = seconds_since(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  refresh_batch(batch);
+  double refresh = seconds_since(&start);
+
+  printf("%d secrets: redealt %.0f secrets/s, refreshed %.0f secrets/s (%.1fx)\n", count, count / redeal,
+         count / refresh, redeal / refresh);
+  printf("Secrets recovered after refresh: %d\n", recover_batch_secrets(batch));
+
+  free(x);
+  free(secrets);
+  free_shamir_recovery(context);
+  free_batch(redealt);
+  free_batch(batch);
+}
+
+// the secret the last t shares of instance recover, whether or not instance
+// has its polynomial
+static void recover_last(mpz_t secret, const struct shamir *instance)
+{
+  int *x = (int *)malloc(instance->t * sizeof(int));
+  for (int i = 0; i < instance->t; i++)
+  {
+    x[i] = instance->n - instance->t + i + 1;
+  }
+  struct shamir_recovery *context = init_shamir_recovery(x, instance->t, instance->p);
+  shamir_recover_with(secret, context, instance->shares + (instance->n - instance->t));
+  free_shamir_recovery(context);
+  free(x);
+}
+
+// whether instance has its secret anywhere in its polynomial
+static int holds_secret(const struct shamir *instance, const mpz_t secret)
+{
+  int holds = instance->hasSecret;
+  for (int j = 0; j < instance->t; j++)
+  {
+    holds |= mpz_cmp((instance->s)[j], secret) == 0;
+  }
+  return holds;
+}
+
+// moves the secret of a (t,n) instance to (t2,n2) by recovering and redealing
+// it and by resharing it, then reshares it back to (t,n). Returns whether the
+// secret came through both reshares without either new instance holding it.
+static int compare_reshare(int t, int n, int lambda, int t2, int n2, struct thread_pool *pool)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  set_shamir_thread_pool(instance, pool);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  recover_shamir_secret(instance);
+  struct shamir *redealt = init_shamir_instance(t2, n2, lambda);
+  set_shamir_thread_pool(redealt, pool);
+  mpz_set((redealt->s)[0], (instance->s)[0]);
+  redealt->hasSecret = 1;
+  generate_shamir_shares(redealt);
+  double redeal = seconds_since(&start);
+
+  int *x = (int *)malloc(t * sizeof(int));
+  for (int i = 0; i < t; i++)
+  {
+    x[i] = n - t + i + 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct shamir *reshared = reshare_instance(instance, x, t, t2, n2);
+  double reshare = seconds_since(&start);
+
+  // and back, from shares only
+  int *x2 = (int *)malloc(t2 * sizeof(int));
+  for (int i = 0; i < t2; i++)
+  {
+    x2[i] = i + 1;
+  }
+  struct shamir *back = reshare_instance(reshared, x2, t2, t, n);
+
+  mpz_t secret, secret2;
+  mpz_init(secret);
+  mpz_init(secret2);
+  recover_last(secret, reshared);
+  recover_last(secret2, back);
+  int held = holds_secret(reshared, (instance->s)[0]) || holds_secret(back, (instance->s)[0]);
+  int kept = mpz_cmp(secret, (instance->s)[0]) == 0 && mpz_cmp(secret2, (instance->s)[0]) == 0;
+
+  printf("(%d,%d) to (%d,%d): redealt %.3f ms, reshared %.3f ms (%.1fx)\n", t, n, t2, n2, redeal * 1000,
+         reshare * 1000, redeal / reshare);
+  printf("Secret recovered from the new shares and after resharing back: %d, held by a new instance: %d\n", kept,
+         held);
+
+  mpz_clear(secret);
+  mpz_clear(secret2);
+  free(x);
+  free(x2);
+  free_shamir_instance(back);
+  free_shamir_instance(reshared);
+  free_shamir_instance(redealt);
+  free_shamir_instance(instance);
+  return kept && !held;
+}
+
+// evaluates the polynomial of a (t,n) instance at 1 ... n with Horner's rule
+// and on the subproduct tree, checks both against the instance's shares and
+// prints their times, which is what SUBPRODUCT_THRESHOLD is measured from
+static void compare_evaluate(int t, int n, int lambda)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  mpz_t *horner = (mpz_t *)malloc(n * sizeof(mpz_t));
+  mpz_t *tree = (mpz_t *)malloc(n * sizeof(mpz_t));
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init(horner[i]);
+    mpz_init(tree[i]);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  evaluate_shares(horner, instance->s, t, 0, n, instance->p, 0, NULL);
+  double serial = seconds_since(&start);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  tree_evaluate_shares(tree, instance->s, t, n, instance->p);
+  double fast = seconds_since(&start);
+
+  int same = 1;
+  for (int i = 0; i < n; i++)
+  {
+    same &= mpz_cmp(horner[i], (instance->shares)[i]) == 0 && mpz_cmp(tree[i], (instance->shares)[i]) == 0;
+  }
+  int limbs = (int)mpz_size(instance->p);
+  printf("%d limbs: Horner %.3f ms, subproduct tree %.3f ms, shares generated with %s\n", limbs, serial * 1000,
+         fast * 1000, uses_subproduct_tree(t, n, limbs) ? "the tree" : "Horner");
+  printf("Shares agree: %d, secret recovered: %d\n", same, recover_shamir_secret(instance));
+
+  for (int i = 0; i < n; i++)
+  {
+    mpz_clear(horner[i]);
+    mpz_clear(tree[i]);
+  }
+  free(horner);
+  free(tree);
+  free_shamir_instance(instance);
+}
+
+// enrolls k participants one at a time into a (t,n) instance, compares that
+// with generating all n + k shares, and recovers from the last t participants
+static void time_enroll(int t, int n, int lambda, int k)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < k; i++)
+  {
+    add_shamir_participants(instance, 1);
+  }
+  double enroll = seconds_since(&start);
+
+  struct shamir *full = init_shamir_instance(t, n + k, lambda);
+  generate_shamir_secret(full);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  generate_shamir_shares(full);
+  double regenerate = seconds_since(&start);
+
+  int *x = (int *)malloc(t * sizeof(int));
+  for (int i = 0; i < t; i++)
+  {
+    x[i] = instance->n - i;
+  }
+  struct shamir_recovery *context = init_shamir_recovery(x, t, instance->p);
+  mpz_t *ys = (mpz_t *)malloc(t * sizeof(mpz_t));
+  for (int i = 0; i < t; i++)
+  {
+    mpz_init_set(ys[i], (instance->shares)[x[i] - 1]);
+  }
+  mpz_t secret;
+  mpz_init(secret);
+  shamir_recover_with(secret, context, ys);
+
+  printf("%d participants added: %.3f us each, all %d shares generated in %.3f ms\n", k, enroll * 1e6 / k, n + k,
+         regenerate * 1000);
+  printf("Secret recovered from the last %d participants: %d\n", t, mpz_cmp(secret, (instance->s)[0]) == 0);
+
+  mpz_clear(secret);
+  for (int i = 0; i < t; i++)
+  {
+    mpz_clear(ys[i]);
+  }
+  free(ys);
+  free(x);
+  free_shamir_recovery(context);
+  free_shamir_instance(full);
+  free_shamir_instance(instance);
+}
+
+// counts the secrets a stream hands to its callback
+static void count_secret(const mpz_t secret, void *arg)
+{
+  (void)secret;
+  (*(int *)arg)++;
+}
+
+// feeds the shares of participants n, n-1, ..., n-t+1 to a stream one at a
+// time and compares the work left when the t-th one arrives with a whole
+// Lagrange recovery from the same t shares
+static void time_stream(int t, int n, int lambda)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  int *x = (int *)malloc(t * sizeof(int));
+  for (int i = 0; i < t; i++)
+  {
+    x[i] = n - i;
+  }
+  mpz_t *ys = (mpz_t *)malloc(t * sizeof(mpz_t));
+  for (int i = 0; i < t; i++)
+  {
+    mpz_init_set(ys[i], (instance->shares)[x[i] - 1]);
+  }
+
+  mpz_t secret;
+  mpz_init(secret);
+  int reps = 20, found = 1, called = 0;
+  double last = 0, arrivals = 0, lagrange = 0;
+  struct timespec start;
+  for (int r = 0; r < reps; r++)
+  {
+    struct shamir_stream *stream = init_shamir_stream(t, instance->p);
+    set_stream_callback(stream, count_secret, &called);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < t - 1; i++)
+    {
+      add_stream_share(stream, x[i], ys[i]);
+    }
+    arrivals += seconds_since(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    add_stream_share(stream, x[t - 1], ys[t - 1]);
+    last += seconds_since(&start);
+    wait_stream_secret(secret, stream);
+    found &= mpz_cmp(secret, (instance->s)[0]) == 0;
+    free_shamir_stream(stream);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct shamir_recovery *context = init_shamir_recovery(x, t, instance->p);
+    shamir_recover_with(secret, context, ys);
+    free_shamir_recovery(context);
+    lagrange += seconds_since(&start);
+  }
+
+  printf("t = %d: first %d shares %.3f ms, t-th share %.3f ms, whole Lagrange recovery %.3f ms\n", t, t - 1,
+         arrivals * 1000 / reps, last * 1000 / reps, lagrange * 1000 / reps);
+  printf("Secret recovered: %d, callbacks: %d of %d\n", found, called, reps);
+
+  mpz_clear(secret);
+  for (int i = 0; i < t; i++)
+  {
+    mpz_clear(ys[i]);
+  }
+  free(ys);
+  free(x);
+  free_shamir_instance(instance);
+}
+
+// corrupts e of the n shares and decodes the secret from all of them, which
+// works for e <= (n - t) / 2
+static void time_decode(int t, int n, int lambda, int e)
+{
+  struct shamir *instance = init_shamir_instance(t, n, lambda);
+  generate_shamir_secret(instance);
+  generate_shamir_shares(instance);
+
+  // every (n / e)-th participant gets a wrong share
+  int *bad = (int *)calloc(n, sizeof(int));
+  for (int j = 0; j < e; j++)
+  {
+    int i = (int)((long)j * n / e);
+    bad[i] = 1;
+    mpz_add_ui((instance->shares)[i], (instance->shares)[i], (unsigned long int)(j + 1));
+  }
+
+  int *faulty = (int *)malloc(n * sizeof(int));
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int wrong = robust_recover_secret(instance, faulty);
+  double decode = seconds_since(&start);
+
+  int named = wrong == e;
+  for (int j = 0; j < wrong; j++)
+  {
+    named &= bad[faulty[j] - 1];
+  }
+  printf("%d shares, %d wrong (up to %d correctable): decoded in %.3f ms\n", n, e, (n - t) / 2, decode * 1000);
+  printf("Secret recovered: %d, wrong shares named: %d\n", wrong >= 0, named);
+
+  free(faulty);
+  free(bad);
+  free_shamir_instance(instance);
+}
 
 int main(int argc, char *argv[])
 {
@@ -12,8 +521,13 @@ int main(int argc, char *argv[])
   {
     t = (int)strtol(argv[1], NULL, 10);
     n = (int)strtol(argv[2], NULL, 10);
+    if (strcmp(argv[3], "compare") == 0 && t <= n && t >= 2 && n <= MAX_PARTICIPANTS)
+    {
+      compare_primes(t, n);
+      return 0;
+    }
     lambda = (int)strtol(argv[3], NULL, 10);
-    if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
+    if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > MAX_PARTICIPANTS)
     {
       printf("Shamir (%d,%d) scheme is not valid.\n", t, n);
       exit(EXIT_FAILURE);
@@ -22,17 +536,111 @@ int main(int argc, char *argv[])
   else
   {
     printf("Must input a threshold, number of parties, and security parameter.\n");
+    printf("An optional fourth argument picks the prime source: table (default), special, cache or random.\n");
+    printf("An optional fifth argument is the number of share generation threads, 0 for one per processor.\n");
+    printf("With \"compare\" as the security parameter, times random, table and special form primes.\n");
+    printf("With \"batch\" and a count as fourth and fifth arguments, compares sharing that many secrets one by one and as a batch.\n");
+    printf("With \"packed\" and a count k instead, compares k plain instances with one packed instance of k secrets.\n");
+    printf("With \"feldman\" and an optional group size in bits (2048), times Feldman share verification.\n");
+    printf("With \"decode\" and a count e, corrupts e shares and decodes the secret from all of them.\n");
+    printf("With \"stream\", times recovering from shares that arrive one at a time.\n");
+    printf("With \"enroll\" and a count k, times adding k participants one at a time.\n");
+    printf("With \"refresh\" and a count, compares redealing that many secrets with refreshing their shares.\n");
+    printf("With \"reshare\" and a new t and n, compares redealing the secret with resharing it.\n");
+    printf("With \"evaluate\", times Horner's rule and the subproduct tree on the same shares.\n");
     exit(EXIT_FAILURE);
   }
 
-  instance = init_instance(t, n, lambda);
-  generate_secret(instance);
-	generate_shares(instance);
-  printf("Secret recovered: %d\n", recover_secret(instance));
+  if (argc > 5 && strcmp(argv[4], "batch") == 0)
+  {
+    struct thread_pool *pool = argc > 6 ? start_thread_pool((int)strtol(argv[6], NULL, 10)) : NULL;
+    compare_batch(t, n, lambda, (int)strtol(argv[5], NULL, 10), pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+  if (argc > 5 && strcmp(argv[4], "decode") == 0)
+  {
+    time_decode(t, n, lambda, (int)strtol(argv[5], NULL, 10));
+    return 0;
+  }
+  if (argc > 4 && strcmp(argv[4], "stream") == 0)
+  {
+    time_stream(t, n, lambda);
+    return 0;
+  }
+  if (argc > 5 && strcmp(argv[4], "enroll") == 0)
+  {
+    time_enroll(t, n, lambda, (int)strtol(argv[5], NULL, 10));
+    return 0;
+  }
+  if (argc > 5 && strcmp(argv[4], "refresh") == 0)
+  {
+    struct thread_pool *pool = argc > 6 ? start_thread_pool((int)strtol(argv[6], NULL, 10)) : NULL;
+    compare_refresh(t, n, lambda, (int)strtol(argv[5], NULL, 10), pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
+  if (argc > 6 && strcmp(argv[4], "reshare") == 0)
+  {
+    struct thread_pool *pool = argc > 7 ? start_thread_pool((int)strtol(argv[7], NULL, 10)) : NULL;
+    int ok = compare_reshare(t, n, lambda, (int)strtol(argv[5], NULL, 10), (int)strtol(argv[6], NULL, 10), pool);
+    stop_thread_pool(pool);
+    return ok ? 0 : EXIT_FAILURE;
+  }
+  if (argc > 4 && strcmp(argv[4], "feldman") == 0)
+  {
+    time_feldman(t, n, lambda, argc > 5 ? (int)strtol(argv[5], NULL, 10) : 2048);
+    return 0;
+  }
+  if (argc > 5 && strcmp(argv[4], "packed") == 0)
+  {
+    struct thread_pool *pool = argc > 6 ? start_thread_pool((int)strtol(argv[6], NULL, 10)) : NULL;
+    compare_packed(t, n, lambda, (int)strtol(argv[5], NULL, 10), pool);
+    stop_thread_pool(pool);
+    return 0;
+  }
 
-  //print_instance(instance);
+  if (argc > 4 && strcmp(argv[4], "evaluate") == 0)
+  {
+    compare_evaluate(t, n, lambda);
+    return 0;
+  }
+  instance = init_shamir_instance(t, n, lambda);
 
-  free_instance(instance);
+  struct prime_cache *cache = NULL;
+  if (argc > 4 && strcmp(argv[4], "cache") == 0)
+  {
+    cache = start_prime_cache(lambda, 4);
+    set_shamir_prime_source(instance, PRIME_CACHE, cache);
+  }
+  else if (argc > 4 && strcmp(argv[4], "special") == 0)
+  {
+    set_shamir_prime_source(instance, PRIME_SPECIAL, NULL);
+  }
+  else if (argc > 4 && strcmp(argv[4], "random") == 0)
+  {
+    set_shamir_prime_source(instance, PRIME_RANDOM, NULL);
+  }
+
+  struct thread_pool *pool = NULL;
+  if (argc > 5)
+  {
+    pool = start_thread_pool((int)strtol(argv[5], NULL, 10));
+    set_shamir_thread_pool(instance, pool);
+  }
+
+  generate_shamir_secret(instance);
+	generate_shamir_shares(instance);
+  printf("Secret recovered: %d\n", recover_shamir_secret(instance));
+
+  //print_shamir_instance(instance);
+
+  free_shamir_instance(instance);
+  if (cache != NULL)
+  {
+    stop_prime_cache(cache);
+  }
+  stop_thread_pool(pool);
 
   return 0;
 }
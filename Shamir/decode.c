@@ -0,0 +1,123 @@
+#include "decode.h"
+
+// Recovers the secret of a threshold t sharing over GF(p) from m >= t shares
+// ys[i] of the participants with x-coordinates x[i], correcting up to
+// (m - t) / 2 wrong shares. Returns the number of wrong shares and writes
+// their x-coordinates to faulty (room for m entries), or -1 if the shares are
+// not valid or too many of them are wrong to decode.
+//
+// The interpolation and the final check run on the subproduct tree of the x
+// coordinates. The Euclidean steps each divide by a remainder one degree
+// lower than the last, so they are O(m^2) coefficient operations in all.
+int decode_secret(mpz_t secret, int *faulty, const int *x, const mpz_t *ys, int m, int t, const mpz_t p)
+{
+	if (m < t || t < 1) {
+		printf("Decoding a threshold %d secret needs at least %d shares, got %d.\n", t, t, m);
+		return -1;
+	}
+	if (check_quorum(x, m, p) == 0) {
+		return -1;
+	}
+
+	mpz_t *points = (mpz_t *) malloc(m * sizeof(mpz_t));
+	mpz_t *values = (mpz_t *) malloc(m * sizeof(mpz_t));
+	for (int i = 0; i < m; i++) {
+		mpz_init_set_ui(points[i], (unsigned long int) x[i]);
+		mpz_init(values[i]);
+		mpz_mod(values[i], ys[i], p);
+	}
+	struct subproduct_tree tree;
+	build_subproduct_tree(&tree, points, m, p);
+
+	// r0 = g0, r1 = g1 and their cofactors v0 = 0, v1 = 1 of g1
+	struct poly r0, r1, r2, v0, v1, v2, q;
+	poly_init(&r0, m + 1);
+	poly_init(&r1, m);
+	poly_init(&r2, m);
+	poly_init(&v0, m);
+	poly_init(&v1, m);
+	poly_init(&v2, m);
+	poly_init(&q, m);
+	poly_set(&r0, &((tree.node)[0]));
+	poly_interpolate(&r1, values, &tree, p);
+	poly_fit(&v1, 1);
+	mpz_set_ui((v1.c)[0], (unsigned long int) 1);
+
+	// stop at the first remainder of degree below (m + t) / 2,
+	// and rotate the polynomials by swapping their structs, not coefficients
+	struct poly swap;
+	while (r1.len > 0 && 2 * (r1.len - 1) >= m + t) {
+		poly_divrem(&q, &r2, &r0, &r1, p);
+		poly_mul(&q, &q, &v1, p);
+		poly_sub(&v2, &v0, &q, p);
+		swap = r0, r0 = r1, r1 = r2, r2 = swap;
+		swap = v0, v0 = v1, v1 = v2, v2 = swap;
+	}
+
+	// f = g / v must divide exactly and have degree below t
+	int wrong = -1;
+	poly_divrem(&q, &r2, &r1, &v1, p);
+	if (r2.len == 0 && q.len <= t) {
+		if (q.len == 0) {
+			mpz_set_ui(secret, (unsigned long int) 0);
+		} else {
+			mpz_set(secret, (q.c)[0]);
+		}
+
+		// the wrong shares are the ones f does not go through
+		multipoint_evaluate(points, &q, &tree, p);
+		wrong = 0;
+		for (int i = 0; i < m; i++) {
+			if (mpz_cmp(points[i], values[i]) != 0) {
+				faulty[wrong++] = x[i];
+			}
+		}
+		if (2 * wrong > m - t) {
+			wrong = -1;
+		}
+	}
+	if (wrong < 0) {
+		printf("Too many of the %d shares are wrong to decode a threshold %d secret.\n", m, t);
+	}
+
+	poly_clear(&r0);
+	poly_clear(&r1);
+	poly_clear(&r2);
+	poly_clear(&v0);
+	poly_clear(&v1);
+	poly_clear(&v2);
+	poly_clear(&q);
+	free_subproduct_tree(&tree);
+	for (int i = 0; i < m; i++) {
+		mpz_clear(points[i]);
+		mpz_clear(values[i]);
+	}
+	free(points);
+	free(values);
+	return wrong;
+}
+
+// Decodes the instance's secret from all n shares, writing the x-coordinates
+// of the wrong ones to faulty (room for n entries). Returns the number of
+// wrong shares if the decoded secret is the instance's, -1 otherwise.
+int robust_recover_secret(struct shamir *instance, int *faulty)
+{
+	if (instance->hasShares != 1) {
+		printf("Cannot recover secret if no shares exist.\n");
+		return -1;
+	}
+
+	int *x = (int *) malloc(instance->n * sizeof(int));
+	for (int i = 0; i < instance->n; i++) {
+		x[i] = i + 1;
+	}
+	mpz_t secret;
+	mpz_init(secret);
+	int wrong = decode_secret(secret, faulty, x, instance->shares, instance->n, instance->t, instance->p);
+	if (wrong >= 0 && mpz_cmp(secret, (instance->s)[0]) != 0) {
+		wrong = -1;
+	}
+	mpz_clear(secret);
+	free(x);
+	return wrong;
+}
@@ -0,0 +1,25 @@
+// Error-correcting recovery of a Shamir secret (Gao's decoder).
+//
+// Shares are the values of a polynomial of degree below t at the
+// participants' x-coordinates, i.e. a Reed-Solomon codeword, so m >= t shares
+// determine the secret even if up to (m - t) / 2 of them are wrong, and the
+// wrong ones can be named. Gao's decoder gets there without trying subsets:
+// interpolate all m shares to g1, run the extended Euclidean algorithm on
+// g0 = prod (x - x_i) and g1 until the remainder g drops below degree
+// (m + t) / 2, and divide g by the cofactor v of g1. If v divides g, the
+// quotient is the sharing polynomial and v vanishes exactly at the bad shares.
+#ifndef SHAMIR_DECODE_HEADER
+#define SHAMIR_DECODE_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "shamir.h"
+#include "poly.h"
+#include "../common/visibility.h"
+
+SECRET_SHARING_API int decode_secret(mpz_t, int *, const int *, const mpz_t *, int, int, const mpz_t);
+
+SECRET_SHARING_API int robust_recover_secret(struct shamir *, int *);
+
+#endif
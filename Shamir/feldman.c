@@ -0,0 +1,320 @@
+#include "feldman.h"
+
+// r = a * b mod m
+static void mulmod(mpz_t r, const mpz_t a, const mpz_t b, const mpz_t m)
+{
+	mpz_mul(r, a, b);
+	mpz_tdiv_r(r, r, m);
+}
+
+// bits pos ... pos + w - 1 of e
+static unsigned int window_digit(const mpz_t e, long pos, int w)
+{
+	unsigned int d = 0;
+	for (int b = w - 1; b >= 0; b--) {
+		d = (d << 1) | (pos + b >= 0 ? (unsigned int) mpz_tstbit(e, (mp_bitcnt_t) (pos + b)) : 0);
+	}
+	return d;
+}
+
+// Straus: a table of b^1 ... b^15 per base and one pass over 4 bit windows
+// shared by all bases, so the squarings are paid once instead of per base.
+static void straus(mpz_t r, const mpz_t *bases, const mpz_t *exps, int count, long bits, const mpz_t m)
+{
+	const int w = 4;
+	mpz_t *table = (mpz_t *) malloc((size_t) count * 16 * sizeof(mpz_t));
+	for (int i = 0; i < count; i++) {
+		mpz_t *row = table + (size_t) i * 16;
+		mpz_init_set_ui(row[0], 1);
+		mpz_init(row[1]);
+		mpz_tdiv_r(row[1], bases[i], m);
+		for (int d = 2; d < 16; d++) {
+			mpz_init(row[d]);
+			mulmod(row[d], row[d - 1], row[1], m);
+		}
+	}
+
+	mpz_set_ui(r, 1);
+	for (long pos = ((bits + w - 1) / w - 1) * w; pos >= 0; pos -= w) {
+		for (int s = 0; s < w; s++) {
+			mulmod(r, r, r, m);
+		}
+		for (int i = 0; i < count; i++) {
+			unsigned int d = window_digit(exps[i], pos, w);
+			if (d != 0) {
+				mulmod(r, r, table[(size_t) i * 16 + d], m);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < (size_t) count * 16; i++) {
+		mpz_clear(table[i]);
+	}
+	free(table);
+}
+
+// Pippenger: per c bit window, every base goes into the bucket of its digit,
+// and prod_d bucket[d]^d comes out of two running products, so a window
+// costs count + 2^(c+1) multiplications whatever the digits are.
+static void pippenger(mpz_t r, const mpz_t *bases, const mpz_t *exps, int count, long bits, const mpz_t m)
+{
+	// the window that minimizes windows * (count + 2^(c+1)) multiplications
+	int c = 1;
+	double best = 0;
+	for (int w = 1; w <= 16; w++) {
+		double cost = (double) ((bits + w - 1) / w) * (count + (2 << w));
+		if (w == 1 || cost < best) {
+			best = cost;
+			c = w;
+		}
+	}
+
+	int buckets = 1 << c;
+	mpz_t *bucket = (mpz_t *) malloc(buckets * sizeof(mpz_t));
+	char *used = (char *) malloc(buckets);
+	for (int d = 0; d < buckets; d++) {
+		mpz_init(bucket[d]);
+	}
+	mpz_t running, sum;
+	mpz_init(running);
+	mpz_init(sum);
+
+	mpz_set_ui(r, 1);
+	for (long pos = ((bits + c - 1) / c - 1) * c; pos >= 0; pos -= c) {
+		for (int s = 0; s < c; s++) {
+			mulmod(r, r, r, m);
+		}
+
+		memset(used, 0, buckets);
+		for (int i = 0; i < count; i++) {
+			unsigned int d = window_digit(exps[i], pos, c);
+			if (d == 0) {
+				continue;
+			}
+			if (used[d]) {
+				mulmod(bucket[d], bucket[d], bases[i], m);
+			} else {
+				mpz_tdiv_r(bucket[d], bases[i], m);
+				used[d] = 1;
+			}
+		}
+
+		// sum = prod_d bucket[d]^d = prod_d (prod_{e >= d} bucket[e])
+		int have_running = 0, have_sum = 0;
+		for (int d = buckets - 1; d >= 1; d--) {
+			if (used[d]) {
+				if (have_running) {
+					mulmod(running, running, bucket[d], m);
+				} else {
+					mpz_set(running, bucket[d]);
+					have_running = 1;
+				}
+			}
+			if (have_running) {
+				if (have_sum) {
+					mulmod(sum, sum, running, m);
+				} else {
+					mpz_set(sum, running);
+					have_sum = 1;
+				}
+			}
+		}
+		if (have_sum) {
+			mulmod(r, r, sum, m);
+		}
+	}
+
+	for (int d = 0; d < buckets; d++) {
+		mpz_clear(bucket[d]);
+	}
+	free(bucket);
+	free(used);
+	mpz_clear(running);
+	mpz_clear(sum);
+}
+
+// r = prod bases[i]^exps[i] mod m for nonnegative exponents
+void multi_exp(mpz_t r, const mpz_t *bases, const mpz_t *exps, int count, const mpz_t m)
+{
+	long bits = 0;
+	for (int i = 0; i < count; i++) {
+		long b = mpz_sgn(exps[i]) == 0 ? 0 : (long) mpz_sizeinbase(exps[i], 2);
+		if (b > bits) {
+			bits = b;
+		}
+	}
+	if (bits == 0) {
+		mpz_set_ui(r, 1);
+		mpz_tdiv_r(r, r, m);
+		return;
+	}
+
+	if (count < MULTI_EXP_PIPPENGER) {
+		straus(r, bases, exps, count, bits, m);
+	} else {
+		pippenger(r, bases, exps, count, bits, m);
+	}
+}
+
+// P = m * p + 1 prime of about bits bits, and g = h^((P-1)/p) != 1, which
+// generates the subgroup of order p since p is prime
+static void make_group(mpz_t P, mpz_t g, const mpz_t p, int bits, gmp_randstate_t state)
+{
+	int pbits = (int) mpz_sizeinbase(p, 2);
+	if (bits < pbits + 64) {
+		bits = pbits + 64;
+	}
+
+	// m even with its top bit set, then step P by 2p until it is prime
+	mpz_t m, step, e, h;
+	mpz_init(m);
+	mpz_init(step);
+	mpz_init(e);
+	mpz_init(h);
+	mpz_urandomb(m, state, (mp_bitcnt_t) (bits - pbits));
+	mpz_setbit(m, (mp_bitcnt_t) (bits - pbits - 1));
+	mpz_clrbit(m, 0);
+	mpz_mul(P, m, p);
+	mpz_add_ui(P, P, 1);
+	mpz_mul_2exp(step, p, 1);
+	while (mpz_probab_prime_p(P, 30) == 0) {
+		mpz_add(P, P, step);
+	}
+
+	mpz_sub_ui(e, P, 1);
+	mpz_divexact(e, e, p);
+	for (unsigned long int base = 2;; base++) {
+		mpz_set_ui(h, base);
+		mpz_powm(g, h, e, P);
+		if (mpz_cmp_ui(g, 1) != 0) {
+			break;
+		}
+	}
+
+	mpz_clear(m);
+	mpz_clear(step);
+	mpz_clear(e);
+	mpz_clear(h);
+}
+
+// Publishes commitments to the coefficients of a shared instance, in a group
+// whose modulus has bits bits (at least 64 more than p). Returns NULL if the
+// instance has no shares yet.
+struct feldman *init_feldman(struct shamir *instance, int bits)
+{
+	if (instance->hasShares != 1 || instance->hasSecret != 1) {
+		printf("Cannot commit to an instance without shares and their polynomial.\n");
+		return NULL;
+	}
+
+	struct feldman *vss;
+	vss = (struct feldman *) malloc(1 * sizeof(struct feldman));
+	vss->t = instance->t;
+	mpz_init_set(vss->p, instance->p);
+	mpz_init(vss->P);
+	mpz_init(vss->g);
+	make_group(vss->P, vss->g, vss->p, bits, instance->state);
+
+	vss->commitments = (mpz_t *) malloc(vss->t * sizeof(mpz_t));
+	for (int j = 0; j < vss->t; j++) {
+		mpz_init(vss->commitments[j]);
+		mpz_powm(vss->commitments[j], vss->g, (instance->s)[j], vss->P);
+	}
+	return vss;
+}
+
+void free_feldman(struct feldman *vss)
+{
+	for (int j = 0; j < vss->t; j++) {
+		mpz_clear(vss->commitments[j]);
+	}
+	free(vss->commitments);
+	mpz_clear(vss->p);
+	mpz_clear(vss->P);
+	mpz_clear(vss->g);
+	free(vss);
+}
+
+// Returns 1 if y is the share of participant x (x-coordinate, 1 ... n) the
+// commitments promise, i.e. g^y = prod_j C[j]^(x^j). The right side is
+// evaluated by Horner's rule in the exponent, ((C[t-1]^x C[t-2])^x ...) C[0],
+// which for a word-sized x is t short exponentiations: cheaper than a
+// multi-exponentiation with the full size exponents x^j mod p.
+int verify_share(const struct feldman *vss, int x, const mpz_t y)
+{
+	mpz_t lhs, rhs, ymod;
+	mpz_init(lhs);
+	mpz_init(rhs);
+	mpz_init(ymod);
+	mpz_mod(ymod, y, vss->p);
+	mpz_powm(lhs, vss->g, ymod, vss->P);
+
+	mpz_set(rhs, vss->commitments[vss->t - 1]);
+	for (int j = vss->t - 2; j >= 0; j--) {
+		mpz_powm_ui(rhs, rhs, (unsigned long int) x, vss->P);
+		mulmod(rhs, rhs, vss->commitments[j], vss->P);
+	}
+	int ok = mpz_cmp(lhs, rhs) == 0;
+
+	mpz_clear(lhs);
+	mpz_clear(rhs);
+	mpz_clear(ymod);
+	return ok;
+}
+
+// Checks count shares ys[i] of participants x[i] at once. With random weights
+// r[i], all of them are valid when
+// 	g^(sum_i r[i] y[i]) = prod_j C[j]^(sum_i r[i] x[i]^j)
+// and a single bad share makes that fail except with probability about
+// 2^-FELDMAN_CHECK_BITS. This costs one exponentiation and one
+// multi-exponentiation over the t commitments, whatever count is. Returns 1
+// if the check passes; if it does not, verify_share tells the bad shares.
+int verify_shares(const struct feldman *vss, const int *x, const mpz_t *ys, int count, gmp_randstate_t state)
+{
+	int t = vss->t;
+	size_t limit = mpz_size(vss->p) + 1;
+	mpz_t *e = (mpz_t *) malloc(t * sizeof(mpz_t));
+	for (int j = 0; j < t; j++) {
+		mpz_init(e[j]);
+	}
+	mpz_t r, power, exponent, lhs, rhs;
+	mpz_init(r);
+	mpz_init(power);
+	mpz_init(exponent);
+	mpz_init(lhs);
+	mpz_init(rhs);
+
+	// e[j] = sum_i r[i] x[i]^j and exponent = sum_i r[i] y[i], summed
+	// unreduced and reduced mod p once at the end
+	for (int i = 0; i < count; i++) {
+		mpz_urandomb(r, state, FELDMAN_CHECK_BITS);
+		mpz_addmul(exponent, r, ys[i]);
+		mpz_set(power, r);
+		for (int j = 0; j < t; j++) {
+			mpz_add(e[j], e[j], power);
+			mpz_mul_ui(power, power, (unsigned long int) x[i]);
+			if (mpz_size(power) > limit) {
+				mpz_mod(power, power, vss->p);
+			}
+		}
+	}
+	for (int j = 0; j < t; j++) {
+		mpz_mod(e[j], e[j], vss->p);
+	}
+	mpz_mod(exponent, exponent, vss->p);
+
+	mpz_powm(lhs, vss->g, exponent, vss->P);
+	multi_exp(rhs, vss->commitments, e, t, vss->P);
+	int ok = mpz_cmp(lhs, rhs) == 0;
+
+	for (int j = 0; j < t; j++) {
+		mpz_clear(e[j]);
+	}
+	free(e);
+	mpz_clear(r);
+	mpz_clear(power);
+	mpz_clear(exponent);
+	mpz_clear(lhs);
+	mpz_clear(rhs);
+	return ok;
+}
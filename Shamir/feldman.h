@@ -0,0 +1,46 @@
+// Feldman verifiable secret sharing on top of a Shamir instance.
+//
+// The commitments live in the subgroup of order p (the instance's prime) of
+// the integers mod a larger prime P = m * p + 1, generated by g. The dealer
+// publishes C[j] = g^s[j] mod P for every coefficient s[j], and participant
+// x checks its share y against them with
+// 	g^y = prod_j C[j]^(x^j mod p) mod P
+// verify_share does that for one share, and verify_shares folds any number of
+// shares into a single randomized check that costs one multi-exponentiation
+// over the t commitments.
+#ifndef SHAMIR_FELDMAN_HEADER
+#define SHAMIR_FELDMAN_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "shamir.h"
+#include "../common/visibility.h"
+
+// bits of the random weights of the combined check in verify_shares; a bad
+// share slips through it with probability about 2^-FELDMAN_CHECK_BITS
+#define FELDMAN_CHECK_BITS 128
+
+// below this many bases multi_exp interleaves fixed windows (Straus), from
+// it on it sorts the bases into buckets per window (Pippenger)
+#define MULTI_EXP_PIPPENGER 32
+
+struct feldman {
+  int t;
+  mpz_t p;            // order of the commitment group, the Shamir prime
+  mpz_t P;            // group modulus, P = m * p + 1
+  mpz_t g;            // generator of the order p subgroup
+  mpz_t *commitments; // C[j] = g^s[j] mod P, 0 <= j < t
+};
+
+void multi_exp(mpz_t, const mpz_t *, const mpz_t *, int, const mpz_t);
+
+SECRET_SHARING_API struct feldman *init_feldman(struct shamir *, int);
+
+SECRET_SHARING_API void free_feldman(struct feldman *);
+
+SECRET_SHARING_API int verify_share(const struct feldman *, int, const mpz_t);
+
+SECRET_SHARING_API int verify_shares(const struct feldman *, const int *, const mpz_t *, int, gmp_randstate_t);
+
+#endif
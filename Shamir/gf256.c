@@ -0,0 +1,526 @@
+#include "gf256.h"
+#include <immintrin.h>
+#include <pthread.h>
+
+// bytes of every share processed per pass over the coefficients, small enough
+// that the coefficient blocks and the share block stay in L1/L2
+#define GF256_BLOCK 4096
+
+// x^8 + x^4 + x^3 + x + 1
+#define GF256_POLY 0x1b
+
+uint8_t gf256_mul(uint8_t a, uint8_t b)
+{
+  uint8_t r = 0;
+  while (b)
+  {
+    if (b & 1)
+      r ^= a;
+    a = (uint8_t) ((a << 1) ^ ((a & 0x80) ? GF256_POLY : 0));
+    b >>= 1;
+  }
+  return r;
+}
+
+// a^254 = a^-1, and 0 maps to 0
+uint8_t gf256_inv(uint8_t a)
+{
+  uint8_t r = 1;
+  for (int e = 254; e; e >>= 1)
+  {
+    if (e & 1)
+      r = gf256_mul(r, a);
+    a = gf256_mul(a, a);
+  }
+  return r;
+}
+
+// Multiplication by a constant c is linear over GF(2), so c * a splits into
+// c * (a & 15) ^ c * (a & 240). tab[0..15] holds c * i and tab[16..31] holds
+// c * (i << 4); the kernels look both up 16, 32 or 64 bytes at a time with
+// pshufb. The tables follow from the eight products c * 2^k alone.
+static void nibble_tables(uint8_t *tab, uint8_t c)
+{
+  uint8_t m[8];
+  m[0] = c;
+  for (int k = 1; k < 8; k++)
+    m[k] = (uint8_t) ((m[k - 1] << 1) ^ ((m[k - 1] & 0x80) ? GF256_POLY : 0));
+
+  tab[0] = 0;
+  tab[16] = 0;
+  for (int i = 1; i < 16; i++)
+  {
+    int k = __builtin_ctz(i);
+    tab[i] = tab[i & (i - 1)] ^ m[k];
+    tab[16 + i] = tab[16 + (i & (i - 1))] ^ m[k + 4];
+  }
+}
+
+static void mul_xor_tail(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *tab, size_t i, size_t len)
+{
+  for (; i < len; i++)
+    out[i] = tab[a[i] & 15] ^ tab[16 + (a[i] >> 4)] ^ b[i];
+}
+
+static void mul_xor_scalar(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *tab, size_t len)
+{
+  mul_xor_tail(out, a, b, tab, 0, len);
+}
+
+__attribute__((target("ssse3")))
+static void mul_xor_ssse3(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *tab, size_t len)
+{
+  __m128i tlo = _mm_loadu_si128((const __m128i *) tab);
+  __m128i thi = _mm_loadu_si128((const __m128i *) (tab + 16));
+  __m128i mask = _mm_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) (a + i));
+    __m128i l = _mm_shuffle_epi8(tlo, _mm_and_si128(v, mask));
+    __m128i h = _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(v, 4), mask));
+    __m128i w = _mm_loadu_si128((const __m128i *) (b + i));
+    _mm_storeu_si128((__m128i *) (out + i), _mm_xor_si128(_mm_xor_si128(l, h), w));
+  }
+  mul_xor_tail(out, a, b, tab, i, len);
+}
+
+// two independent 32 byte lanes per iteration to hide the shuffle latency
+__attribute__((target("avx2")))
+static void mul_xor_avx2(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *tab, size_t len)
+{
+  __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) tab));
+  __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (tab + 16)));
+  __m256i mask = _mm256_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64)
+  {
+    __m256i v0 = _mm256_loadu_si256((const __m256i *) (a + i));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *) (a + i + 32));
+    __m256i l0 = _mm256_shuffle_epi8(tlo, _mm256_and_si256(v0, mask));
+    __m256i l1 = _mm256_shuffle_epi8(tlo, _mm256_and_si256(v1, mask));
+    __m256i h0 = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(v0, 4), mask));
+    __m256i h1 = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(v1, 4), mask));
+    __m256i w0 = _mm256_loadu_si256((const __m256i *) (b + i));
+    __m256i w1 = _mm256_loadu_si256((const __m256i *) (b + i + 32));
+    _mm256_storeu_si256((__m256i *) (out + i), _mm256_xor_si256(_mm256_xor_si256(l0, h0), w0));
+    _mm256_storeu_si256((__m256i *) (out + i + 32), _mm256_xor_si256(_mm256_xor_si256(l1, h1), w1));
+  }
+  for (; i + 32 <= len; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) (a + i));
+    __m256i l = _mm256_shuffle_epi8(tlo, _mm256_and_si256(v, mask));
+    __m256i h = _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(v, 4), mask));
+    __m256i w = _mm256_loadu_si256((const __m256i *) (b + i));
+    _mm256_storeu_si256((__m256i *) (out + i), _mm256_xor_si256(_mm256_xor_si256(l, h), w));
+  }
+  mul_xor_tail(out, a, b, tab, i, len);
+}
+
+__attribute__((target("avx512bw")))
+static void mul_xor_avx512(uint8_t *out, const uint8_t *a, const uint8_t *b, const uint8_t *tab, size_t len)
+{
+  __m512i tlo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) tab));
+  __m512i thi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) (tab + 16)));
+  __m512i mask = _mm512_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64)
+  {
+    __m512i v = _mm512_loadu_si512((const void *) (a + i));
+    __m512i l = _mm512_shuffle_epi8(tlo, _mm512_and_si512(v, mask));
+    __m512i h = _mm512_shuffle_epi8(thi, _mm512_and_si512(_mm512_srli_epi64(v, 4), mask));
+    __m512i w = _mm512_loadu_si512((const void *) (b + i));
+    _mm512_storeu_si512((void *) (out + i), _mm512_xor_si512(_mm512_xor_si512(l, h), w));
+  }
+  mul_xor_tail(out, a, b, tab, i, len);
+}
+
+#define MUL512(v) _mm512_xor_si512(_mm512_shuffle_epi8(tlo, _mm512_and_si512(v, mask)), \
+                                    _mm512_shuffle_epi8(thi, _mm512_and_si512(_mm512_srli_epi64(v, 4), mask)))
+
+#define MUL256(v) _mm256_xor_si256(_mm256_shuffle_epi8(tlo, _mm256_and_si256(v, mask)), \
+                                    _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(v, 4), mask)))
+
+// The fused kernels below keep the running value in registers for a whole
+// Horner evaluation or dot product, instead of one load/store pass over memory
+// per step, and run two chunks side by side so the shuffle chains overlap.
+
+// out[k] = c0[k] + x * (c[k] + x * (c[stride + k] + ... + x * c[(t-2) * stride + k]))
+static void horner_tail(uint8_t *out, const uint8_t *c0, const uint8_t *c, size_t stride, int t, const uint8_t *tab, size_t k, size_t len)
+{
+  for (; k < len; k++)
+  {
+    uint8_t v = c[(size_t) (t - 2) * stride + k];
+    for (int j = t - 2; j >= 1; j--)
+      v = tab[v & 15] ^ tab[16 + (v >> 4)] ^ c[(size_t) (j - 1) * stride + k];
+    out[k] = tab[v & 15] ^ tab[16 + (v >> 4)] ^ c0[k];
+  }
+}
+
+__attribute__((target("avx512bw")))
+static void horner_avx512(uint8_t *out, const uint8_t *c0, const uint8_t *c, size_t stride, int t, const uint8_t *tab, size_t len)
+{
+  __m512i tlo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) tab));
+  __m512i thi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) (tab + 16)));
+  __m512i mask = _mm512_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 128 <= len; i += 128)
+  {
+    const uint8_t *cj = c + (size_t) (t - 2) * stride + i;
+    __m512i v0 = _mm512_loadu_si512((const void *) cj);
+    __m512i v1 = _mm512_loadu_si512((const void *) (cj + 64));
+    for (int j = t - 2; j >= 1; j--)
+    {
+      cj -= stride;
+      v0 = _mm512_xor_si512(MUL512(v0), _mm512_loadu_si512((const void *) cj));
+      v1 = _mm512_xor_si512(MUL512(v1), _mm512_loadu_si512((const void *) (cj + 64)));
+    }
+    _mm512_storeu_si512((void *) (out + i), _mm512_xor_si512(MUL512(v0), _mm512_loadu_si512((const void *) (c0 + i))));
+    _mm512_storeu_si512((void *) (out + i + 64), _mm512_xor_si512(MUL512(v1), _mm512_loadu_si512((const void *) (c0 + i + 64))));
+  }
+  horner_tail(out, c0, c, stride, t, tab, i, len);
+}
+
+__attribute__((target("avx2")))
+static void horner_avx2(uint8_t *out, const uint8_t *c0, const uint8_t *c, size_t stride, int t, const uint8_t *tab, size_t len)
+{
+  __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) tab));
+  __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (tab + 16)));
+  __m256i mask = _mm256_set1_epi8(0x0f);
+
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64)
+  {
+    const uint8_t *cj = c + (size_t) (t - 2) * stride + i;
+    __m256i v0 = _mm256_loadu_si256((const __m256i *) cj);
+    __m256i v1 = _mm256_loadu_si256((const __m256i *) (cj + 32));
+    for (int j = t - 2; j >= 1; j--)
+    {
+      cj -= stride;
+      v0 = _mm256_xor_si256(MUL256(v0), _mm256_loadu_si256((const __m256i *) cj));
+      v1 = _mm256_xor_si256(MUL256(v1), _mm256_loadu_si256((const __m256i *) (cj + 32)));
+    }
+    _mm256_storeu_si256((__m256i *) (out + i), _mm256_xor_si256(MUL256(v0), _mm256_loadu_si256((const __m256i *) (c0 + i))));
+    _mm256_storeu_si256((__m256i *) (out + i + 32), _mm256_xor_si256(MUL256(v1), _mm256_loadu_si256((const __m256i *) (c0 + i + 32))));
+  }
+  horner_tail(out, c0, c, stride, t, tab, i, len);
+}
+
+// out[k] = sum_i tabs[i] * ys[i][off + k], one 32 byte table per term
+static void dot_tail(uint8_t *out, const uint8_t *const *ys, size_t off, const uint8_t *tabs, int n, size_t k, size_t len)
+{
+  for (; k < len; k++)
+  {
+    uint8_t v = 0;
+    for (int i = 0; i < n; i++)
+    {
+      uint8_t y = ys[i][off + k];
+      v ^= tabs[32 * i + (y & 15)] ^ tabs[32 * i + 16 + (y >> 4)];
+    }
+    out[k] = v;
+  }
+}
+
+__attribute__((target("avx512bw")))
+static void dot_avx512(uint8_t *out, const uint8_t *const *ys, size_t off, const uint8_t *tabs, int n, size_t len)
+{
+  __m512i mask = _mm512_set1_epi8(0x0f);
+
+  size_t k = 0;
+  for (; k + 128 <= len; k += 128)
+  {
+    __m512i v0 = _mm512_setzero_si512(), v1 = _mm512_setzero_si512();
+    for (int i = 0; i < n; i++)
+    {
+      __m512i tlo = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) (tabs + 32 * i)));
+      __m512i thi = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *) (tabs + 32 * i + 16)));
+      const uint8_t *y = ys[i] + off + k;
+      v0 = _mm512_xor_si512(v0, MUL512(_mm512_loadu_si512((const void *) y)));
+      v1 = _mm512_xor_si512(v1, MUL512(_mm512_loadu_si512((const void *) (y + 64))));
+    }
+    _mm512_storeu_si512((void *) (out + k), v0);
+    _mm512_storeu_si512((void *) (out + k + 64), v1);
+  }
+  dot_tail(out, ys, off, tabs, n, k, len);
+}
+
+__attribute__((target("avx2")))
+static void dot_avx2(uint8_t *out, const uint8_t *const *ys, size_t off, const uint8_t *tabs, int n, size_t len)
+{
+  __m256i mask = _mm256_set1_epi8(0x0f);
+
+  size_t k = 0;
+  for (; k + 64 <= len; k += 64)
+  {
+    __m256i v0 = _mm256_setzero_si256(), v1 = _mm256_setzero_si256();
+    for (int i = 0; i < n; i++)
+    {
+      __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (tabs + 32 * i)));
+      __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (tabs + 32 * i + 16)));
+      const uint8_t *y = ys[i] + off + k;
+      v0 = _mm256_xor_si256(v0, MUL256(_mm256_loadu_si256((const __m256i *) y)));
+      v1 = _mm256_xor_si256(v1, MUL256(_mm256_loadu_si256((const __m256i *) (y + 32))));
+    }
+    _mm256_storeu_si256((__m256i *) (out + k), v0);
+    _mm256_storeu_si256((__m256i *) (out + k + 32), v1);
+  }
+  dot_tail(out, ys, off, tabs, n, k, len);
+}
+
+typedef void (*mul_xor_fn)(uint8_t *, const uint8_t *, const uint8_t *, const uint8_t *, size_t);
+typedef void (*horner_fn)(uint8_t *, const uint8_t *, const uint8_t *, size_t, int, const uint8_t *, size_t);
+typedef void (*dot_fn)(uint8_t *, const uint8_t *const *, size_t, const uint8_t *, int, size_t);
+
+static mul_xor_fn mul_xor_kernel;
+
+// SSSE3 and scalar evaluate step by step through mul_xor_kernel
+static void horner_steps(uint8_t *out, const uint8_t *c0, const uint8_t *c, size_t stride, int t, const uint8_t *tab, size_t len)
+{
+  memcpy(out, c + (size_t) (t - 2) * stride, len);
+  for (int j = t - 2; j >= 1; j--)
+    mul_xor_kernel(out, out, c + (size_t) (j - 1) * stride, tab, len);
+  mul_xor_kernel(out, out, c0, tab, len);
+}
+
+static void dot_steps(uint8_t *out, const uint8_t *const *ys, size_t off, const uint8_t *tabs, int n, size_t len)
+{
+  memset(out, 0, len);
+  for (int i = 0; i < n; i++)
+    mul_xor_kernel(out, ys[i] + off, out, tabs + 32 * i, len);
+}
+
+static horner_fn horner_kernel;
+static dot_fn dot_kernel;
+static const char *mul_xor_name;
+
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+// the widest kernels the CPU runs
+static void choose_kernels(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw"))
+  {
+    mul_xor_name = "avx512bw";
+    horner_kernel = horner_avx512;
+    dot_kernel = dot_avx512;
+    mul_xor_kernel = mul_xor_avx512;
+  }
+  else if (__builtin_cpu_supports("avx2"))
+  {
+    mul_xor_name = "avx2";
+    horner_kernel = horner_avx2;
+    dot_kernel = dot_avx2;
+    mul_xor_kernel = mul_xor_avx2;
+  }
+  else if (__builtin_cpu_supports("ssse3"))
+  {
+    mul_xor_name = "ssse3";
+    horner_kernel = horner_steps;
+    dot_kernel = dot_steps;
+    mul_xor_kernel = mul_xor_ssse3;
+  }
+  else
+  {
+    mul_xor_name = "scalar";
+    horner_kernel = horner_steps;
+    dot_kernel = dot_steps;
+    mul_xor_kernel = mul_xor_scalar;
+  }
+}
+
+// picks the kernels once, safely from any number of threads
+static void select_kernel(void)
+{
+  pthread_once(&kernel_once, choose_kernels);
+}
+
+const char *gf256_kernel_name(void)
+{
+  select_kernel();
+  return mul_xor_name;
+}
+
+// out[i] = c * a[i] ^ b[i] for 0 <= i < len. out may alias a or b.
+void gf256_mul_xor(uint8_t *out, const uint8_t *a, const uint8_t *b, uint8_t c, size_t len)
+{
+  uint8_t tab[32];
+  nibble_tables(tab, c);
+  select_kernel();
+  mul_xor_kernel(out, a, b, tab, len);
+}
+
+void free_gf256_instance(struct shamir_gf256 *instance)
+{
+  if (instance->passedInit != 1)
+  { // nothing aside from the struct was allocated
+    free(instance);
+    return;
+  }
+
+  free(instance->secret);
+  free(instance->coeffs);
+  free(instance->shares);
+  free(instance);
+}
+
+struct shamir_gf256 *init_gf256_instance(int t, int n, size_t len)
+{
+  struct shamir_gf256 *instance;
+  instance = (struct shamir_gf256 *) malloc(sizeof(struct shamir_gf256));
+
+  // set instance state flags
+  instance->passedInit = 0;
+  instance->hasSecret = 0;
+  instance->hasShares = 0;
+
+  if (t > n || t < 2 || n > GF256_MAX_PARTICIPANTS || len == 0)
+  {
+    printf("GF(256) Shamir (%d,%d) scheme over %zu bytes is not valid.\n", t, n, len);
+    free_gf256_instance(instance);
+    exit(EXIT_FAILURE);
+  }
+
+  instance->t = t;
+  instance->n = n;
+  instance->len = len;
+
+  instance->secret = (uint8_t *) malloc(len);
+  instance->coeffs = (uint8_t *) malloc((size_t) (t - 1) * len);
+  instance->shares = (uint8_t *) malloc((size_t) n * len);
+
+  chacha20_seed(&instance->rng);
+  select_kernel();
+
+  instance->passedInit = 1;
+  return instance;
+}
+
+void set_gf256_secret(struct shamir_gf256 *instance, const uint8_t *secret)
+{
+  memcpy(instance->secret, secret, instance->len);
+  instance->hasSecret = 1;
+  instance->hasShares = 0;
+}
+
+void generate_gf256_secret(struct shamir_gf256 *instance)
+{
+  chacha20_bytes(&instance->rng, instance->secret, instance->len);
+  instance->hasSecret = 1;
+  instance->hasShares = 0;
+}
+
+// Share byte k of participant i is f_k(i+1), with f_k(x) = secret[k] +
+// coeffs[k] x + ... All the byte polynomials are evaluated at the same x, so
+// one kernel call runs Horner for a whole block of bytes.
+void generate_gf256_shares(struct shamir_gf256 *instance)
+{
+  if (instance->hasSecret != 1)
+  {
+    printf("Instance does not have a secret.\n");
+    return;
+  }
+
+  int t = instance->t;
+  size_t len = instance->len;
+  uint8_t *tab = (uint8_t *) malloc((size_t) instance->n * 32);
+  for (int i = 0; i < instance->n; i++)
+    nibble_tables(tab + 32 * i, (uint8_t) (i + 1));
+
+  for (size_t off = 0; off < len; off += GF256_BLOCK)
+  {
+    size_t b = len - off < GF256_BLOCK ? len - off : GF256_BLOCK;
+    // draw this block's coefficients right before they are used
+    for (int j = 1; j < t; j++)
+      chacha20_bytes(&instance->rng, instance->coeffs + (size_t) (j - 1) * len + off, b);
+
+    for (int i = 0; i < instance->n; i++)
+      horner_kernel(instance->shares + (size_t) i * len + off, instance->secret + off,
+                    instance->coeffs + off, len, t, tab + 32 * i, b);
+  }
+
+  free(tab);
+  instance->hasShares = 1;
+}
+
+// Recovers len secret bytes from the k shares ys[i] at the points x[i], as
+// sum L_i(0) ys[i] with L_i(0) = prod_{j != i} x_j / (x_j + x_i). Returns 1,
+// or 0 without touching out if an x is 0 or appears twice, which would make a
+// denominator zero.
+int combine_gf256_shares(uint8_t *out, const uint8_t *x, const uint8_t *const *ys, int k, size_t len)
+{
+  for (int i = 0; i < k; i++)
+  {
+    if (x[i] == 0)
+    {
+      printf("Share x-coordinate 0 is not in 1 ... 255.\n");
+      return 0;
+    }
+    for (int j = 0; j < i; j++)
+    {
+      if (x[i] == x[j])
+      {
+        printf("Share x-coordinate %d appears twice in the quorum.\n", x[i]);
+        return 0;
+      }
+    }
+  }
+
+  uint8_t *l = (uint8_t *) malloc((size_t) k * 32);
+
+  for (int i = 0; i < k; i++)
+  {
+    uint8_t num = 1, den = 1;
+    for (int j = 0; j < k; j++)
+    {
+      if (j == i)
+        continue;
+      num = gf256_mul(num, x[j]);
+      den = gf256_mul(den, x[j] ^ x[i]);
+    }
+    nibble_tables(l + 32 * i, gf256_mul(num, gf256_inv(den)));
+  }
+
+  select_kernel();
+  for (size_t off = 0; off < len; off += GF256_BLOCK)
+  {
+    size_t b = len - off < GF256_BLOCK ? len - off : GF256_BLOCK;
+    dot_kernel(out + off, ys, off, l, k, b);
+  }
+
+  free(l);
+  return 1;
+}
+
+// returns 1 if the secret was recovered from the first t shares and 0 otherwise
+int recover_gf256_secret(struct shamir_gf256 *instance)
+{
+  if (instance->hasShares != 1)
+  {
+    printf("Instance does not have shares.\n");
+    return 0;
+  }
+
+  int t = instance->t;
+  uint8_t *x = (uint8_t *) malloc((size_t) t);
+  const uint8_t **ys = (const uint8_t **) malloc(t * sizeof(uint8_t *));
+  uint8_t *result = (uint8_t *) malloc(instance->len);
+
+  for (int i = 0; i < t; i++)
+  {
+    x[i] = (uint8_t) (i + 1);
+    ys[i] = instance->shares + (size_t) i * instance->len;
+  }
+
+  int ok = combine_gf256_shares(result, x, ys, t, instance->len) &&
+           memcmp(result, instance->secret, instance->len) == 0;
+
+  free(x);
+  free(ys);
+  free(result);
+  return ok;
+}
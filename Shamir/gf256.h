@@ -0,0 +1,56 @@
+// Byte-oriented Shamir secret sharing over GF(2^8) for secrets of any length.
+// Every byte of the secret is shared with its own polynomial, and the
+// polynomials are evaluated side by side with pshufb nibble-multiply kernels.
+#ifndef GF256_HEADER
+#define GF256_HEADER
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../common/chacha20.h"
+#include "../common/visibility.h"
+
+// x-coordinates are the nonzero bytes
+#define GF256_MAX_PARTICIPANTS 255
+
+struct shamir_gf256 {
+  int t;
+  int n;
+  size_t len; // bytes in the secret and in every share
+
+  // flags
+  int passedInit;
+  int hasSecret;
+  int hasShares;
+
+  struct chacha20 rng; // coefficient stream, keyed from getrandom at init
+
+  uint8_t *secret; // the secret buffer
+  uint8_t *coeffs; // coefficient j of byte k is coeffs[(j-1) * len + k], 1 <= j < t
+  uint8_t *shares; // participant i's share is (i+1, shares[i * len ... (i+1) * len - 1])
+};
+
+uint8_t gf256_mul(uint8_t, uint8_t);
+
+uint8_t gf256_inv(uint8_t);
+
+SECRET_SHARING_API const char *gf256_kernel_name(void);
+
+void gf256_mul_xor(uint8_t *, const uint8_t *, const uint8_t *, uint8_t, size_t);
+
+SECRET_SHARING_API void free_gf256_instance(struct shamir_gf256 *);
+
+SECRET_SHARING_API struct shamir_gf256 *init_gf256_instance(int, int, size_t);
+
+SECRET_SHARING_API void set_gf256_secret(struct shamir_gf256 *, const uint8_t *);
+
+SECRET_SHARING_API void generate_gf256_secret(struct shamir_gf256 *);
+
+SECRET_SHARING_API void generate_gf256_shares(struct shamir_gf256 *);
+
+SECRET_SHARING_API int combine_gf256_shares(uint8_t *, const uint8_t *, const uint8_t *const *, int, size_t);
+
+SECRET_SHARING_API int recover_gf256_secret(struct shamir_gf256 *);
+
+#endif
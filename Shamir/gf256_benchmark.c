@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 199309L
+#include "gf256.h"
+#include <time.h>
+
+// seconds each measurement repeats for
+#define MIN_SECONDS 0.5
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+  struct shamir_gf256 *instance;
+  int t, n;
+  size_t len;
+
+  // Make sure we have parameters t and n such that t <= n
+  if (argc > 3)
+  {
+    t = (int)strtol(argv[1], NULL, 10);
+    n = (int)strtol(argv[2], NULL, 10);
+    len = (size_t)strtoull(argv[3], NULL, 10);
+    if (t > n || t < 2 || n > GF256_MAX_PARTICIPANTS || len == 0)
+    {
+      printf("GF(256) Shamir (%d,%d) scheme is not valid.\n", t, n);
+      exit(EXIT_FAILURE);
+    }
+  }
+  else
+  {
+    printf("Must input a threshold, number of parties, and secret length in bytes.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  instance = init_gf256_instance(t, n, len);
+  generate_gf256_secret(instance);
+
+  // throughput is counted in secret bytes, so splitting writes n times and
+  // combining reads t times as much
+  int reps = 0;
+  double start = now(), elapsed;
+  do
+  {
+    generate_gf256_shares(instance);
+    reps++;
+    elapsed = now() - start;
+  } while (elapsed < MIN_SECONDS);
+  double split = (double) len * reps / elapsed / 1e9;
+
+  int ok = 1;
+  reps = 0;
+  start = now();
+  do
+  {
+    ok &= recover_gf256_secret(instance);
+    reps++;
+    elapsed = now() - start;
+  } while (elapsed < MIN_SECONDS);
+  double combine = (double) len * reps / elapsed / 1e9;
+
+  printf("Kernel: %s\n", gf256_kernel_name());
+  printf("Split: %.3f GB/s\n", split);
+  printf("Combine: %.3f GB/s\n", combine);
+  printf("Secret recovered: %d\n", ok);
+
+  free_gf256_instance(instance);
+
+  return 0;
+}
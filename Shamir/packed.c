@@ -0,0 +1,425 @@
+#include "packed.h"
+
+void free_packed(struct shamir_packed *instance)
+{
+	if (instance->passedInit != 1) { // nothing aside from the struct was allocated
+		free(instance);
+		return;
+	}
+
+	gmp_randclear(instance->state);
+	for (int j = 0; j < instance->k; j++) {
+		mpz_clear((instance->secrets)[j]);
+	}
+	for (int i = 0; i < instance->t + instance->k - 1; i++) {
+		mpz_clear((instance->c)[i]);
+	}
+	for (int i = 0; i < instance->n; i++) {
+		mpz_clear((instance->shares)[i]);
+	}
+	free(instance->secrets);
+	free(instance->c);
+	free(instance->shares);
+	mpz_clear(instance->p);
+	free(instance);
+}
+
+// Allocates a packed instance for k secrets among n participants, recovered
+// by any t + k - 1 of them. Exits on parameters that do not make sense.
+struct shamir_packed *init_packed(int t, int k, int n, int lambda)
+{
+	struct shamir_packed *instance;
+	instance = (struct shamir_packed *) malloc(1 * sizeof(struct shamir_packed));
+	instance->passedInit = 0;
+	instance->hasSecret = 0;
+	instance->hasShares = 0;
+
+	if (t < 2 || k < 1 || k > n - t + 1 || lambda < 64 || lambda > 512 || n > MAX_PARTICIPANTS) {
+		printf("Packed Shamir (%d,%d) scheme of %d secrets with security %d is not valid.\n", t, n, k, lambda);
+		free_packed(instance);
+		exit(EXIT_FAILURE);
+	}
+
+	instance->t = t;
+	instance->k = k;
+	instance->n = n;
+	instance->lambda = lambda;
+
+	// RNG init
+	// get secure random long seed
+	unsigned long int seed;
+	getrandom(&seed, sizeof(unsigned long int), GRND_RANDOM);
+	gmp_randinit_default(instance->state);
+	gmp_randseed_ui(instance->state, seed);
+
+	instance->secrets = (mpz_t *) malloc(k * sizeof(mpz_t));
+	for (int j = 0; j < k; j++) {
+		mpz_init((instance->secrets)[j]);
+	}
+	instance->c = (mpz_t *) malloc((t + k - 1) * sizeof(mpz_t));
+	for (int i = 0; i < t + k - 1; i++) {
+		mpz_init((instance->c)[i]);
+	}
+	instance->shares = (mpz_t *) malloc(n * sizeof(mpz_t));
+	for (int i = 0; i < n; i++) {
+		mpz_init((instance->shares)[i]);
+	}
+
+	mpz_init(instance->p);
+	instance->primes.source = PRIME_TABLE;
+	instance->primes.cache = NULL;
+	instance->primes.secretBelowP = 0;
+	instance->pool = NULL;
+
+	instance->passedInit = 1;
+	return instance;
+}
+
+// Same as set_shamir_prime_source for a plain instance.
+void set_packed_prime_source(struct shamir_packed *instance, enum prime_source source, struct prime_cache *cache)
+{
+	instance->primes.source = source;
+	instance->primes.cache = cache;
+}
+
+// Same as set_shamir_thread_pool for a plain instance.
+void set_packed_thread_pool(struct shamir_packed *instance, struct thread_pool *pool)
+{
+	instance->pool = pool;
+}
+
+// Takes k secrets of at most lambda bits.
+void set_packed_secrets(struct shamir_packed *instance, const mpz_t *secrets)
+{
+	if (instance->hasSecret == 1) {
+		printf("Instance already has secrets.\n");
+		return;
+	}
+	for (int j = 0; j < instance->k; j++) {
+		if (mpz_sgn(secrets[j]) < 0 || mpz_sizeinbase(secrets[j], 2) > (size_t) instance->lambda) {
+			printf("Secret %d is not a %d bit number.\n", j, instance->lambda);
+			return;
+		}
+	}
+	for (int j = 0; j < instance->k; j++) {
+		mpz_set((instance->secrets)[j], secrets[j]);
+	}
+	instance->hasSecret = 1;
+}
+
+void generate_packed_secrets(struct shamir_packed *instance)
+{
+	if (instance->hasSecret == 1) {
+		printf("Instance already has secrets.\n");
+		return;
+	}
+	for (int j = 0; j < instance->k; j++) {
+		mpz_urandomb((instance->secrets)[j], instance->state, instance->lambda);
+	}
+	instance->hasSecret = 1;
+}
+
+// Sets c to the coefficients of the polynomial of degree len - 1 with value
+// v[m] at x = -(m+1). The points are 1 apart, so every divided difference of
+// order j divides by the same -j, and Newton's form becomes a chain of
+// multiplications by the small (x + m + 1).
+static void interpolate_negative(mpz_t *c, const mpz_t *v, int len, const mpz_t p)
+{
+	mpz_t *inv = (mpz_t *) malloc(len * sizeof(mpz_t));
+	for (int i = 0; i < len; i++) {
+		mpz_init(inv[i]);
+	}
+	if (len > 1) {
+		small_inverses(inv, len - 1, p);
+	}
+
+	// Newton coefficients, d[i] = (d[i-1] - d[i]) / j at order j
+	mpz_t *d = (mpz_t *) malloc(len * sizeof(mpz_t));
+	for (int i = 0; i < len; i++) {
+		mpz_init_set(d[i], v[i]);
+	}
+	for (int j = 1; j < len; j++) {
+		for (int i = len - 1; i >= j; i--) {
+			mpz_sub(d[i], d[i - 1], d[i]);
+			mpz_mul(d[i], d[i], inv[j]);
+			mpz_mod(d[i], d[i], p);
+		}
+	}
+
+	// c = d[len-1], then c = c * (x + m + 1) + d[m] for m = len-2 ... 0
+	mpz_set(c[0], d[len - 1]);
+	for (int m = len - 2, deg = 0; m >= 0; m--, deg++) {
+		unsigned long int u = (unsigned long int) (m + 1);
+		mpz_set(c[deg + 1], c[deg]);
+		for (int i = deg; i > 0; i--) {
+			mpz_mul_ui(c[i], c[i], u);
+			mpz_add(c[i], c[i], c[i - 1]);
+			mpz_mod(c[i], c[i], p);
+		}
+		mpz_mul_ui(c[0], c[0], u);
+		mpz_add(c[0], c[0], d[m]);
+		mpz_mod(c[0], c[0], p);
+	}
+
+	for (int i = 0; i < len; i++) {
+		mpz_clear(inv[i]);
+		mpz_clear(d[i]);
+	}
+	free(inv);
+	free(d);
+}
+
+struct packed_job {
+	struct shamir_packed *instance;
+	struct field *f;          // NULL if p does not fit the field layer
+	const mp_limb_t *coeffs;
+};
+
+// shares[i] = poly(i + 1) for begin <= i < end
+static void packed_range(void *arg, int begin, int end)
+{
+	struct packed_job *job = (struct packed_job *) arg;
+	struct shamir_packed *instance = job->instance;
+	int len = instance->t + instance->k - 1;
+	if (job->f != NULL) {
+		mp_limb_t share[FIELD_MAX_LIMBS];
+		for (int i = begin; i < end; i++) {
+			job->f->ops->horner(share, job->coeffs, len, (mp_limb_t) (i + 1), job->f);
+			field_export((instance->shares)[i], share, job->f);
+		}
+		return;
+	}
+
+	struct poly f;
+	f.len = len;
+	f.size = len;
+	f.c = instance->c;
+	mpz_t x;
+	mpz_init(x);
+	for (int i = begin; i < end; i++) {
+		mpz_set_ui(x, (unsigned long int) (i + 1));
+		poly_eval((instance->shares)[i], &f, x, instance->p);
+	}
+	mpz_clear(x);
+}
+
+void generate_packed_shares(struct shamir_packed *instance)
+{
+	if (instance->hasSecret != 1 || instance->hasShares != 0) {
+		printf("Cannot generate shares on a packed instance without secrets or that already has shares.\n");
+		return;
+	}
+
+	// p above every secret, from the instance's prime source
+	mpz_t bound;
+	mpz_init(bound);
+	for (int j = 0; j < instance->k; j++) {
+		if (mpz_cmp((instance->secrets)[j], bound) > 0) {
+			mpz_set(bound, (instance->secrets)[j]);
+		}
+	}
+	provide_prime(instance->p, &(instance->primes), instance->lambda, bound, instance->state);
+	mpz_clear(bound);
+
+	// values at -1 ... -(t+k-1): the secrets, then t - 1 random ones
+	int len = instance->t + instance->k - 1;
+	mpz_t *v = (mpz_t *) malloc(len * sizeof(mpz_t));
+	for (int m = 0; m < len; m++) {
+		mpz_init(v[m]);
+		if (m < instance->k) {
+			mpz_set(v[m], (instance->secrets)[m]);
+		} else {
+			mpz_urandomm(v[m], instance->state, instance->p);
+		}
+	}
+	interpolate_negative(instance->c, v, len, instance->p);
+	for (int m = 0; m < len; m++) {
+		mpz_clear(v[m]);
+	}
+	free(v);
+
+	// one evaluation pass gives every participant a share of all k secrets
+	struct field f;
+	struct packed_job job;
+	job.instance = instance;
+	job.f = NULL;
+	job.coeffs = NULL;
+	mp_limb_t *coeffs = NULL;
+	if (field_init(&f, instance->p)) {
+		coeffs = (mp_limb_t *) malloc((size_t) len * f.limbs * sizeof(mp_limb_t));
+		field_horner_coeffs(coeffs, instance->c, len, &f);
+		job.f = &f;
+		job.coeffs = coeffs;
+	}
+	thread_pool_run(instance->pool, instance->n, packed_range, &job);
+	free(coeffs);
+
+	instance->hasShares = 1;
+}
+
+// Precomputes the weights of shares x[0], ..., x[q-1] in each of the k
+// secrets. The Lagrange coefficient of share i at x = -j is
+// 	prod_{m != i} (-j - x[m]) / (x[i] - x[m]) = P_j * (j + x[i])^-1 * d[i]^-1,
+// 	P_j = prod_m (j + x[m]),  d[i] = prod_{m != i} (x[m] - x[i])
+// so, as for init_shamir_recovery, only the d[i] need a (single, shared) inversion.
+// Recovery is exact when q is at least t + k - 1.
+struct shamir_packed_recovery *init_packed_recovery(const int *x, int q, int k, const mpz_t p)
+{
+	int max_x = check_quorum(x, q, p);
+	if (max_x == 0) {
+		return NULL;
+	}
+	if (mpz_cmp_ui(p, (unsigned long int) (max_x + k)) <= 0) {
+		printf("p is too small for %d packed secrets.\n", k);
+		return NULL;
+	}
+
+	struct shamir_packed_recovery *context;
+	context = (struct shamir_packed_recovery *) malloc(1 * sizeof(struct shamir_packed_recovery));
+	context->q = q;
+	context->k = k;
+	context->x = (int *) malloc(q * sizeof(int));
+	memcpy(context->x, x, q * sizeof(int));
+	mpz_init_set(context->p, p);
+	context->coeff = (mpz_t *) malloc((size_t) k * q * sizeof(mpz_t));
+	for (int i = 0; i < k * q; i++) {
+		mpz_init(context->coeff[i]);
+	}
+
+	mpz_t *dinv = (mpz_t *) malloc(q * sizeof(mpz_t));
+	for (int i = 0; i < q; i++) {
+		mpz_init(dinv[i]);
+	}
+	lagrange_denominators(dinv, x, q, p);
+
+	mpz_t *inv = (mpz_t *) malloc((max_x + k + 1) * sizeof(mpz_t));
+	for (int i = 0; i <= max_x + k; i++) {
+		mpz_init(inv[i]);
+	}
+	small_inverses(inv, max_x + k, p);
+
+	size_t limit = mpz_size(p) + 1;
+	mpz_t product;
+	mpz_init(product);
+	for (int j = 1; j <= k; j++) {
+		// product = P_j
+		mpz_set_ui(product, (unsigned long int) 1);
+		for (int m = 0; m < q; m++) {
+			mpz_mul_ui(product, product, (unsigned long int) (j + x[m]));
+			if (mpz_size(product) > limit) {
+				mpz_mod(product, product, p);
+			}
+		}
+		mpz_mod(product, product, p);
+
+		for (int i = 0; i < q; i++) {
+			mpz_ptr coeff = context->coeff[(size_t) (j - 1) * q + i];
+			mpz_mul(coeff, product, inv[j + x[i]]);
+			mpz_mod(coeff, coeff, p);
+			mpz_mul(coeff, coeff, dinv[i]);
+			mpz_mod(coeff, coeff, p);
+		}
+	}
+
+	// keep a fixed-limb copy of the coefficients for packed_recover_with
+	context->coeff_limbs = NULL;
+	if (field_init(&(context->f), p)) {
+		int L = context->f.limbs;
+		context->coeff_limbs = (mp_limb_t *) malloc((size_t) k * q * L * sizeof(mp_limb_t));
+		for (int i = 0; i < k * q; i++) {
+			field_import(context->coeff_limbs + (size_t) i * L, context->coeff[i], &(context->f));
+		}
+	}
+
+	mpz_clear(product);
+	for (int i = 0; i <= max_x + k; i++) {
+		mpz_clear(inv[i]);
+	}
+	free(inv);
+	for (int i = 0; i < q; i++) {
+		mpz_clear(dinv[i]);
+	}
+	free(dinv);
+	return context;
+}
+
+void free_packed_recovery(struct shamir_packed_recovery *context)
+{
+	for (int i = 0; i < context->k * context->q; i++) {
+		mpz_clear(context->coeff[i]);
+	}
+	free(context->coeff);
+	free(context->coeff_limbs);
+	free(context->x);
+	mpz_clear(context->p);
+	free(context);
+}
+
+// Recovers all k secrets from the quorum's shares, ys[i] being the share of
+// the participant with x-coordinate context->x[i]: one dot product each.
+void packed_recover_with(mpz_t *secrets, const struct shamir_packed_recovery *context, const mpz_t *ys)
+{
+	int q = context->q;
+	if (context->coeff_limbs != NULL) {
+		const struct field *f = &(context->f);
+		int L = f->limbs;
+		mp_limb_t *y = (mp_limb_t *) malloc((size_t) q * L * sizeof(mp_limb_t));
+		mp_limb_t result[FIELD_MAX_LIMBS];
+		for (int i = 0; i < q; i++) {
+			field_import(y + (size_t) i * L, ys[i], f);
+		}
+		for (int j = 0; j < context->k; j++) {
+			f->ops->dot(result, y, context->coeff_limbs + (size_t) j * q * L, q, f);
+			field_export(secrets[j], result, f);
+		}
+		free(y);
+		return;
+	}
+
+	for (int j = 0; j < context->k; j++) {
+		mpz_set_ui(secrets[j], (unsigned long int) 0);
+		for (int i = 0; i < q; i++) {
+			mpz_addmul(secrets[j], ys[i], context->coeff[(size_t) j * q + i]);
+		}
+		mpz_mod(secrets[j], secrets[j], context->p);
+	}
+}
+
+// Recovers the secrets from participants 1, ..., t + k - 1. Returns 1 if all
+// of them match, 0 if not or if the quorum's context could not be built.
+int recover_packed_secrets(struct shamir_packed *instance)
+{
+	if (instance->hasShares != 1) {
+		printf("Cannot recover secrets if no shares exist.\n");
+		return 0;
+	}
+
+	int q = instance->t + instance->k - 1;
+	int *x = (int *) malloc(q * sizeof(int));
+	for (int i = 0; i < q; i++) {
+		x[i] = i + 1;
+	}
+	struct shamir_packed_recovery *context = init_packed_recovery(x, q, instance->k, instance->p);
+	free(x);
+	if (context == NULL) {
+		printf("Cannot recover secrets without a recovery context.\n");
+		return 0;
+	}
+
+	mpz_t *result = (mpz_t *) malloc(instance->k * sizeof(mpz_t));
+	for (int j = 0; j < instance->k; j++) {
+		mpz_init(result[j]);
+	}
+	packed_recover_with(result, context, instance->shares);
+
+	int found = 1;
+	for (int j = 0; j < instance->k; j++) {
+		if (mpz_cmp(result[j], (instance->secrets)[j]) != 0) {
+			found = 0;
+		}
+		mpz_clear(result[j]);
+	}
+	free(result);
+	free_packed_recovery(context);
+	return found;
+}
@@ -0,0 +1,76 @@
+// Packed (Franklin-Yung) Shamir sharing: k secrets in one polynomial.
+//
+// The secrets sit at the points x = -1, ..., -k of a polynomial of degree
+// t + k - 2 whose values at -k-1, ..., -(t+k-1) are random. Participant i
+// gets its value at x = i + 1, as in plain Shamir. Any t + k - 1 shares
+// recover all k secrets and any t - 1 reveal nothing about them, so k = 1 is
+// exactly the (t,n) scheme with its secret at -1 instead of 0. One share per
+// participant carries all k secrets.
+#ifndef SHAMIR_PACKED_HEADER
+#define SHAMIR_PACKED_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/random.h>
+#include "shamir.h"
+#include "../common/visibility.h"
+
+struct shamir_packed {
+  int t; // t - 1 shares reveal nothing
+  int k; // secrets per polynomial
+  int n;
+  int lambda;
+  gmp_randstate_t state; // RNG
+
+  // flags
+  int passedInit;
+  int hasSecret;
+  int hasShares;
+
+  // big ints
+  mpz_t *secrets; // secrets[j] is the value at x = -(j+1), 0 <= j < k
+  mpz_t *c;       // the t + k - 1 coefficients, c[i] of x^i
+  mpz_t p;
+  struct prime_provider primes; // where p comes from, the prime table by default
+  struct thread_pool *pool;     // splits the share evaluation, NULL for serial
+  mpz_t *shares;  // participant i's share is (i + 1, shares[i])
+};
+
+// Lagrange coefficients from a fixed quorum to the k secret points.
+struct shamir_packed_recovery {
+  int q;        // shares in the quorum, at least t + k - 1
+  int k;
+  int *x;       // x-coordinates of the quorum's shares
+  mpz_t p;
+  mpz_t *coeff; // coeff[j * q + i] is share i's weight in secret j
+
+  // the same coefficients on the fixed-limb field layer, NULL if p does not fit
+  struct field f;
+  mp_limb_t *coeff_limbs;
+};
+
+SECRET_SHARING_API void free_packed(struct shamir_packed *);
+
+SECRET_SHARING_API struct shamir_packed *init_packed(int, int, int, int);
+
+SECRET_SHARING_API void set_packed_prime_source(struct shamir_packed *, enum prime_source, struct prime_cache *);
+
+SECRET_SHARING_API void set_packed_thread_pool(struct shamir_packed *, struct thread_pool *);
+
+SECRET_SHARING_API void set_packed_secrets(struct shamir_packed *, const mpz_t *);
+
+SECRET_SHARING_API void generate_packed_secrets(struct shamir_packed *);
+
+SECRET_SHARING_API void generate_packed_shares(struct shamir_packed *);
+
+SECRET_SHARING_API struct shamir_packed_recovery *init_packed_recovery(const int *, int, int, const mpz_t);
+
+SECRET_SHARING_API void free_packed_recovery(struct shamir_packed_recovery *);
+
+SECRET_SHARING_API void packed_recover_with(mpz_t *, const struct shamir_packed_recovery *, const mpz_t *);
+
+SECRET_SHARING_API int recover_packed_secrets(struct shamir_packed *);
+
+#endif
@@ -0,0 +1,708 @@
+// Polynomial arithmetic over GF(p) used by the Shamir share engine.
+// Large products are done by Kronecker substitution so that GMP's own
+// FFT multiplication does the heavy lifting.
+
+#include "poly.h"
+
+// Allocate a polynomial with room for size coefficients and length 0
+void poly_init(struct poly *f, int size)
+{
+  if (size < 1)
+  {
+    size = 1;
+  }
+  f->len = 0;
+  f->size = size;
+  f->c = (mpz_t *)malloc(size * sizeof(mpz_t));
+  for (int i = 0; i < size; i++)
+  {
+    mpz_init((f->c)[i]);
+  }
+}
+
+void poly_clear(struct poly *f)
+{
+  for (int i = 0; i < f->size; i++)
+  {
+    mpz_clear((f->c)[i]);
+  }
+  free(f->c);
+  f->c = NULL;
+  f->len = 0;
+  f->size = 0;
+}
+
+// Resize f to len coefficients. Coefficients past the old length are zero.
+void poly_fit(struct poly *f, int len)
+{
+  if (len > f->size)
+  {
+    f->c = (mpz_t *)realloc(f->c, len * sizeof(mpz_t));
+    for (int i = f->size; i < len; i++)
+    {
+      mpz_init((f->c)[i]);
+    }
+    f->size = len;
+  }
+  for (int i = f->len; i < len; i++)
+  {
+    mpz_set_ui((f->c)[i], (unsigned long int)0);
+  }
+  f->len = len;
+}
+
+// Strip zero leading coefficients
+void poly_normalize(struct poly *f)
+{
+  while (f->len > 0 && mpz_sgn((f->c)[f->len - 1]) == 0)
+  {
+    f->len--;
+  }
+}
+
+void poly_set(struct poly *r, const struct poly *f)
+{
+  if (r == f)
+  {
+    return;
+  }
+  poly_fit(r, f->len);
+  for (int i = 0; i < f->len; i++)
+  {
+    mpz_set((r->c)[i], (f->c)[i]);
+  }
+}
+
+// r = a + sign * b mod p for sign = 1 or -1
+static void poly_add_signed(struct poly *r, const struct poly *a, const struct poly *b, int sign, const mpz_t p)
+{
+  int len = a->len > b->len ? a->len : b->len;
+  struct poly out;
+  struct poly *dest = r;
+  if (r == b)
+  {
+    poly_init(&out, len);
+    dest = &out;
+  }
+
+  poly_set(dest, a);
+  poly_fit(dest, len);
+  for (int i = 0; i < b->len; i++)
+  {
+    if (sign > 0)
+    {
+      mpz_add((dest->c)[i], (dest->c)[i], (b->c)[i]);
+    }
+    else
+    {
+      mpz_sub((dest->c)[i], (dest->c)[i], (b->c)[i]);
+    }
+    mpz_mod((dest->c)[i], (dest->c)[i], p);
+  }
+  poly_normalize(dest);
+
+  if (dest != r)
+  {
+    poly_set(r, dest);
+    poly_clear(&out);
+  }
+}
+
+// r = a + b mod p
+void poly_add(struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  poly_add_signed(r, a, b, 1, p);
+}
+
+// r = a - b mod p
+void poly_sub(struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  poly_add_signed(r, a, b, -1, p);
+}
+
+// Pack the coefficients of f into slots of w limbs each
+static mp_limb_t *kronecker_pack(const struct poly *f, int w)
+{
+  mp_limb_t *packed = (mp_limb_t *)calloc((size_t)f->len * w, sizeof(mp_limb_t));
+  for (int i = 0; i < f->len; i++)
+  {
+    size_t size = mpz_size((f->c)[i]);
+    memcpy(packed + (size_t)i * w, mpz_limbs_read((f->c)[i]), size * sizeof(mp_limb_t));
+  }
+  return packed;
+}
+
+// r = a * b mod p by Kronecker substitution. r must not be a or b.
+static void kronecker_mul(struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  // every coefficient of a*b is below min(len) * p^2, so 2 * size(p) + 1
+  // limbs per slot can never carry into the next slot
+  int w = 2 * (int)mpz_size(p) + 1;
+  mpz_t az, bz, product, slot;
+  mp_limb_t *ap, *bp;
+
+  ap = kronecker_pack(a, w);
+  mpz_roinit_n(az, ap, (mp_size_t)a->len * w);
+  mpz_init(product);
+  if (a == b)
+  {
+    mpz_mul(product, az, az);
+    bp = NULL;
+  }
+  else
+  {
+    bp = kronecker_pack(b, w);
+    mpz_roinit_n(bz, bp, (mp_size_t)b->len * w);
+    mpz_mul(product, az, bz);
+  }
+
+  // unpack, every slot is reduced mod p on the way out
+  const mp_limb_t *pp = mpz_limbs_read(product);
+  size_t psize = mpz_size(product);
+  poly_fit(r, a->len + b->len - 1);
+  for (int k = 0; k < r->len; k++)
+  {
+    size_t offset = (size_t)k * w;
+    if (offset >= psize)
+    {
+      mpz_set_ui((r->c)[k], (unsigned long int)0);
+      continue;
+    }
+    size_t count = psize - offset < (size_t)w ? psize - offset : (size_t)w;
+    mpz_roinit_n(slot, pp + offset, (mp_size_t)count);
+    mpz_mod((r->c)[k], slot, p);
+  }
+
+  mpz_clear(product);
+  free(ap);
+  free(bp);
+}
+
+// r = a * b mod p
+void poly_mul(struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  if (a->len == 0 || b->len == 0)
+  {
+    r->len = 0;
+    return;
+  }
+
+  // write into a temporary if r aliases an operand
+  struct poly out;
+  struct poly *dest = r;
+  if (r == a || r == b)
+  {
+    poly_init(&out, a->len + b->len - 1);
+    dest = &out;
+  }
+
+  if (a->len < POLY_KRONECKER_THRESHOLD || b->len < POLY_KRONECKER_THRESHOLD)
+  {
+    // schoolbook with one reduction per coefficient
+    poly_fit(dest, a->len + b->len - 1);
+    for (int k = 0; k < dest->len; k++)
+    {
+      mpz_set_ui((dest->c)[k], (unsigned long int)0);
+    }
+    for (int i = 0; i < a->len; i++)
+    {
+      for (int j = 0; j < b->len; j++)
+      {
+        mpz_addmul((dest->c)[i + j], (a->c)[i], (b->c)[j]);
+      }
+    }
+    for (int k = 0; k < dest->len; k++)
+    {
+      mpz_mod((dest->c)[k], (dest->c)[k], p);
+    }
+  }
+  else
+  {
+    kronecker_mul(dest, a, b, p);
+  }
+  poly_normalize(dest);
+
+  if (dest != r)
+  {
+    poly_set(r, dest);
+    poly_clear(&out);
+  }
+}
+
+// h = g^-1 mod x^n by Newton iteration. g[0] must be invertible mod p.
+static void poly_inv_series(struct poly *h, const struct poly *g, int n, const mpz_t p)
+{
+  struct poly low, e;
+  poly_init(&low, n);
+  poly_init(&e, 2 * n);
+
+  poly_fit(h, 1);
+  mpz_invert((h->c)[0], (g->c)[0], p);
+
+  // h <- h * (2 - g * h) mod x^k doubles the number of correct terms
+  for (int k = 1; k < n;)
+  {
+    k = 2 * k < n ? 2 * k : n;
+
+    poly_fit(&low, k < g->len ? k : g->len);
+    for (int i = 0; i < low.len; i++)
+    {
+      mpz_set((low.c)[i], (g->c)[i]);
+    }
+    poly_mul(&e, &low, h, p);
+    if (e.len > k)
+    {
+      e.len = k;
+    }
+    for (int i = 0; i < e.len; i++)
+    {
+      mpz_neg((e.c)[i], (e.c)[i]);
+    }
+    if (e.len == 0)
+    {
+      poly_fit(&e, 1);
+    }
+    mpz_add_ui((e.c)[0], (e.c)[0], (unsigned long int)2);
+    for (int i = 0; i < e.len; i++)
+    {
+      mpz_mod((e.c)[i], (e.c)[i], p);
+    }
+    poly_normalize(&e);
+    poly_mul(h, h, &e, p);
+    if (h->len > k)
+    {
+      h->len = k;
+    }
+  }
+
+  poly_clear(&low);
+  poly_clear(&e);
+}
+
+// Schoolbook a mod b into r, and a / b into quot unless it is NULL. b must be
+// normalized.
+static void poly_divrem_basecase(struct poly *quot, struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  int m = b->len - 1; // deg b
+  mpz_t q, lead_inv;
+  mpz_init(q);
+  mpz_init(lead_inv);
+  mpz_invert(lead_inv, (b->c)[m], p);
+
+  poly_set(r, a);
+  if (quot != NULL)
+  {
+    poly_fit(quot, r->len - m);
+  }
+  for (int i = r->len - 1; i >= m; i--)
+  {
+    // everything below the top coefficient is reduced lazily
+    mpz_mod((r->c)[i], (r->c)[i], p);
+    mpz_mul(q, (r->c)[i], lead_inv);
+    mpz_mod(q, q, p);
+    if (quot != NULL)
+    {
+      mpz_set((quot->c)[i - m], q);
+    }
+    for (int j = 0; j < m; j++)
+    {
+      mpz_submul((r->c)[i - m + j], q, (b->c)[j]);
+    }
+  }
+  if (quot != NULL)
+  {
+    poly_normalize(quot);
+  }
+  r->len = m;
+  for (int i = 0; i < r->len; i++)
+  {
+    mpz_mod((r->c)[i], (r->c)[i], p);
+  }
+  poly_normalize(r);
+
+  mpz_clear(q);
+  mpz_clear(lead_inv);
+}
+
+// inv = rev(b)^-1 mod x^n, where rev(b) is b with its coefficients reversed
+void poly_rev_inverse(struct poly *inv, const struct poly *b, int n, const mpz_t p)
+{
+  struct poly rev_b;
+  poly_init(&rev_b, n);
+  poly_fit(&rev_b, n < b->len ? n : b->len);
+  for (int i = 0; i < rev_b.len; i++)
+  {
+    mpz_set((rev_b.c)[i], (b->c)[b->len - 1 - i]);
+  }
+  poly_normalize(&rev_b);
+  poly_inv_series(inv, &rev_b, n, p);
+  poly_clear(&rev_b);
+}
+
+// r = a mod b and quot = a / b unless quot is NULL, given inv = rev(b)^-1 mod
+// x^terms. If inv is NULL or has fewer than the deg(a) - deg(b) + 1 terms
+// needed, the inverse is computed here. r must not alias b or quot.
+static void poly_divrem_precomp(struct poly *quot, struct poly *r, const struct poly *a, const struct poly *b,
+                                const struct poly *inv, int terms, const mpz_t p)
+{
+  if (a->len < b->len)
+  {
+    poly_set(r, a);
+    if (quot != NULL)
+    {
+      quot->len = 0;
+    }
+    return;
+  }
+
+  int ql = a->len - b->len + 1; // length of the quotient
+  if (b->len < POLY_KRONECKER_THRESHOLD || ql < POLY_KRONECKER_THRESHOLD)
+  {
+    poly_divrem_basecase(quot, r, a, b, p);
+    return;
+  }
+
+  // rev(q) = rev(a) * rev(b)^-1 mod x^ql
+  struct poly rev_a, low_inv, q, qb;
+  poly_init(&rev_a, ql);
+  poly_init(&q, ql);
+  poly_init(&qb, a->len);
+
+  poly_fit(&rev_a, ql);
+  for (int i = 0; i < ql; i++)
+  {
+    mpz_set((rev_a.c)[i], (a->c)[a->len - 1 - i]);
+  }
+  poly_normalize(&rev_a);
+
+  // only the low ql terms of the inverse take part
+  if (inv == NULL || terms < ql)
+  {
+    inv = NULL;
+    poly_init(&low_inv, ql);
+    poly_rev_inverse(&low_inv, b, ql, p);
+  }
+  else
+  {
+    low_inv = *inv;
+    low_inv.len = inv->len < ql ? inv->len : ql;
+  }
+
+  poly_mul(&qb, &rev_a, &low_inv, p);
+  poly_fit(&q, ql);
+  for (int i = 0; i < ql; i++)
+  {
+    if (ql - 1 - i < qb.len)
+    {
+      mpz_set((q.c)[i], (qb.c)[ql - 1 - i]);
+    }
+    else
+    {
+      mpz_set_ui((q.c)[i], (unsigned long int)0);
+    }
+  }
+  poly_normalize(&q);
+
+  // r = a - q * b, only the low deg(b) coefficients survive
+  poly_mul(&qb, &q, b, p);
+  int m = b->len - 1;
+  poly_fit(r, m);
+  for (int i = 0; i < m; i++)
+  {
+    if (i < qb.len)
+    {
+      mpz_sub((r->c)[i], (a->c)[i], (qb.c)[i]);
+      mpz_mod((r->c)[i], (r->c)[i], p);
+    }
+    else
+    {
+      mpz_set((r->c)[i], (a->c)[i]);
+    }
+  }
+  poly_normalize(r);
+  if (quot != NULL)
+  {
+    poly_set(quot, &q);
+  }
+
+  if (inv == NULL)
+  {
+    poly_clear(&low_inv);
+  }
+  poly_clear(&rev_a);
+  poly_clear(&q);
+  poly_clear(&qb);
+}
+
+// r = a mod b, given inv = rev(b)^-1 mod x^terms. If inv is NULL or has fewer
+// than the deg(a) - deg(b) + 1 terms needed, the inverse is computed here.
+void poly_rem_precomp(struct poly *r, const struct poly *a, const struct poly *b, const struct poly *inv, int terms, const mpz_t p)
+{
+  poly_divrem_precomp(NULL, r, a, b, inv, terms, p);
+}
+
+// r = a mod b. b must be normalized and not zero.
+void poly_rem(struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  poly_divrem_precomp(NULL, r, a, b, NULL, 0, p);
+}
+
+// quot = a / b and r = a mod b. b must be normalized and not zero, and r must
+// not alias b or quot.
+void poly_divrem(struct poly *quot, struct poly *r, const struct poly *a, const struct poly *b, const mpz_t p)
+{
+  poly_divrem_precomp(quot, r, a, b, NULL, 0, p);
+}
+
+// result = f(x) mod p by Horner's rule. For a word-sized x the accumulator is
+// only reduced once it has grown a limb past p.
+void poly_eval(mpz_t result, const struct poly *f, const mpz_t x, const mpz_t p)
+{
+  mpz_set_ui(result, (unsigned long int)0);
+  if (!mpz_fits_ulong_p(x))
+  {
+    for (int i = f->len - 1; i >= 0; i--)
+    {
+      mpz_mul(result, result, x);
+      mpz_add(result, result, (f->c)[i]);
+      mpz_mod(result, result, p);
+    }
+    return;
+  }
+
+  unsigned long int small = mpz_get_ui(x);
+  size_t limit = mpz_size(p) + 1;
+  for (int i = f->len - 1; i >= 0; i--)
+  {
+    mpz_mul_ui(result, result, small);
+    mpz_add(result, result, (f->c)[i]);
+    if (mpz_size(result) > limit)
+    {
+      mpz_mod(result, result, p);
+    }
+  }
+  mpz_mod(result, result, p);
+}
+
+// Build node k of the tree over points lo ... hi-1
+static void build_node(struct subproduct_tree *tree, int k, int lo, int hi, const mpz_t p)
+{
+  struct poly *node = &((tree->node)[k]);
+  poly_init(node, hi - lo + 1);
+  (tree->lo)[k] = lo;
+  (tree->hi)[k] = hi;
+
+  if (hi - lo <= POLY_TREE_LEAF)
+  {
+    // multiply out the linear factors (x - x_i) directly
+    poly_fit(node, 1);
+    mpz_set_ui((node->c)[0], (unsigned long int)1);
+    for (int i = lo; i < hi; i++)
+    {
+      poly_fit(node, node->len + 1);
+      for (int j = node->len - 1; j > 0; j--)
+      {
+        mpz_submul((node->c)[j], (node->c)[j - 1], (tree->x)[i]);
+        mpz_mod((node->c)[j], (node->c)[j], p);
+      }
+    }
+    // coefficients were built highest degree first, flip them
+    for (int i = 0, j = node->len - 1; i < j; i++, j--)
+    {
+      mpz_swap((node->c)[i], (node->c)[j]);
+    }
+    return;
+  }
+
+  int mid = (lo + hi) / 2;
+  build_node(tree, 2 * k + 1, lo, mid, p);
+  build_node(tree, 2 * k + 2, mid, hi, p);
+  poly_mul(node, &((tree->node)[2 * k + 1]), &((tree->node)[2 * k + 2]), p);
+
+  // a child is only ever asked to reduce a remainder of its parent, whose
+  // quotient has at most deg(sibling) + 1 <= deg(child) + 2 terms
+  for (int c = 2 * k + 1; c <= 2 * k + 2; c++)
+  {
+    struct poly *child = &((tree->node)[c]);
+    (tree->terms)[c] = child->len + 1;
+    poly_init(&((tree->inv)[c]), (tree->terms)[c]);
+    poly_rev_inverse(&((tree->inv)[c]), child, (tree->terms)[c], p);
+  }
+}
+
+// Build the subproduct tree of prod (x - points[i]) for 0 <= i < n
+void build_subproduct_tree(struct subproduct_tree *tree, const mpz_t *points, int n, const mpz_t p)
+{
+  // a heap over at most 2n/POLY_TREE_LEAF + 1 leaves never needs more than
+  // 4 times that many slots
+  int leaves = 2 * (n / POLY_TREE_LEAF) + 1;
+  tree->n = n;
+  tree->nodes = 4 * leaves;
+  tree->lo = (int *)malloc(tree->nodes * sizeof(int));
+  tree->hi = (int *)malloc(tree->nodes * sizeof(int));
+  tree->node = (struct poly *)calloc(tree->nodes, sizeof(struct poly));
+  tree->inv = (struct poly *)calloc(tree->nodes, sizeof(struct poly));
+  tree->terms = (int *)calloc(tree->nodes, sizeof(int));
+  tree->x = (mpz_t *)malloc(n * sizeof(mpz_t));
+  for (int i = 0; i < n; i++)
+  {
+    mpz_init_set((tree->x)[i], points[i]);
+  }
+
+  build_node(tree, 0, 0, n, p);
+}
+
+void free_subproduct_tree(struct subproduct_tree *tree)
+{
+  for (int k = 0; k < tree->nodes; k++)
+  {
+    if ((tree->node)[k].c != NULL)
+    {
+      poly_clear(&((tree->node)[k]));
+    }
+    if ((tree->inv)[k].c != NULL)
+    {
+      poly_clear(&((tree->inv)[k]));
+    }
+  }
+  for (int i = 0; i < tree->n; i++)
+  {
+    mpz_clear((tree->x)[i]);
+  }
+  free(tree->node);
+  free(tree->inv);
+  free(tree->terms);
+  free(tree->lo);
+  free(tree->hi);
+  free(tree->x);
+}
+
+// Push f down from node k, writing f(x_i) to values[i] at the leaves
+static void evaluate_node(mpz_t *values, const struct poly *f, const struct subproduct_tree *tree, int k, const mpz_t p)
+{
+  const struct poly *node = &((tree->node)[k]);
+  struct poly r;
+  poly_init(&r, node->len);
+  if ((tree->inv)[k].c != NULL)
+  {
+    poly_rem_precomp(&r, f, node, &((tree->inv)[k]), (tree->terms)[k], p);
+  }
+  else
+  {
+    poly_rem(&r, f, node, p);
+  }
+
+  int lo = (tree->lo)[k];
+  int hi = (tree->hi)[k];
+  if (hi - lo <= POLY_TREE_LEAF)
+  {
+    for (int i = lo; i < hi; i++)
+    {
+      poly_eval(values[i], &r, (tree->x)[i], p);
+    }
+  }
+  else
+  {
+    evaluate_node(values, &r, tree, 2 * k + 1, p);
+    evaluate_node(values, &r, tree, 2 * k + 2, p);
+  }
+
+  poly_clear(&r);
+}
+
+// values[i] = f(x_i) mod p for every point of the tree
+void multipoint_evaluate(mpz_t *values, const struct poly *f, const struct subproduct_tree *tree, const mpz_t p)
+{
+  evaluate_node(values, f, tree, 0, p);
+}
+
+// Push the weighted basis polynomials up from node k: f = sum_i w[i] *
+// node[k] / (x - x_i) over the node's points, combined at inner nodes as
+// f = f_left * node[right] + f_right * node[left].
+static void interpolate_node(struct poly *f, const mpz_t *w, const struct subproduct_tree *tree, int k, const mpz_t p)
+{
+  const struct poly *node = &((tree->node)[k]);
+  int lo = (tree->lo)[k];
+  int hi = (tree->hi)[k];
+  if (hi - lo <= POLY_TREE_LEAF)
+  {
+    // node / (x - x_i) by synthetic division, accumulated with weight w[i]
+    poly_fit(f, node->len - 1);
+    for (int j = 0; j < f->len; j++)
+    {
+      mpz_set_ui((f->c)[j], (unsigned long int)0);
+    }
+    mpz_t q;
+    mpz_init(q);
+    for (int i = lo; i < hi; i++)
+    {
+      mpz_set_ui(q, (unsigned long int)0);
+      for (int j = node->len - 1; j >= 1; j--)
+      {
+        // q = coefficient j-1 of the quotient
+        mpz_mul(q, q, (tree->x)[i]);
+        mpz_add(q, q, (node->c)[j]);
+        mpz_mod(q, q, p);
+        mpz_addmul((f->c)[j - 1], q, w[i]);
+      }
+    }
+    for (int j = 0; j < f->len; j++)
+    {
+      mpz_mod((f->c)[j], (f->c)[j], p);
+    }
+    poly_normalize(f);
+    mpz_clear(q);
+    return;
+  }
+
+  struct poly left, right;
+  poly_init(&left, hi - lo);
+  poly_init(&right, hi - lo);
+  interpolate_node(&left, w, tree, 2 * k + 1, p);
+  interpolate_node(&right, w, tree, 2 * k + 2, p);
+  poly_mul(&left, &left, &((tree->node)[2 * k + 2]), p);
+  poly_mul(&right, &right, &((tree->node)[2 * k + 1]), p);
+  poly_add(f, &left, &right, p);
+  poly_clear(&left);
+  poly_clear(&right);
+}
+
+// f = the polynomial of degree below n with f(x_i) = values[i] at the n
+// distinct points of the tree. With M = prod (x - x_i),
+// f = sum_i values[i] / M'(x_i) * M / (x - x_i), where the M'(x_i) come from
+// one multipoint evaluation and the sum is collected up the tree.
+void poly_interpolate(struct poly *f, const mpz_t *values, const struct subproduct_tree *tree, const mpz_t p)
+{
+  const struct poly *root = &((tree->node)[0]);
+  struct poly derivative;
+  poly_init(&derivative, root->len - 1);
+  poly_fit(&derivative, root->len - 1);
+  for (int i = 1; i < root->len; i++)
+  {
+    mpz_mul_ui((derivative.c)[i - 1], (root->c)[i], (unsigned long int)i);
+    mpz_mod((derivative.c)[i - 1], (derivative.c)[i - 1], p);
+  }
+  poly_normalize(&derivative);
+
+  mpz_t *w = (mpz_t *)malloc(tree->n * sizeof(mpz_t));
+  for (int i = 0; i < tree->n; i++)
+  {
+    mpz_init(w[i]);
+  }
+  multipoint_evaluate(w, &derivative, tree, p);
+  for (int i = 0; i < tree->n; i++)
+  {
+    mpz_invert(w[i], w[i], p);
+    mpz_mul(w[i], w[i], values[i]);
+    mpz_mod(w[i], w[i], p);
+  }
+
+  interpolate_node(f, w, tree, 0, p);
+
+  for (int i = 0; i < tree->n; i++)
+  {
+    mpz_clear(w[i]);
+  }
+  free(w);
+  poly_clear(&derivative);
+}
@@ -0,0 +1,69 @@
+// Polynomial arithmetic over GF(p) used by the Shamir share engine.
+#ifndef POLY_HEADER
+#define POLY_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+// below this many coefficients products and remainders are done schoolbook,
+// above it products go through Kronecker substitution and mpz_mul
+#define POLY_KRONECKER_THRESHOLD 16
+
+// below this degree the subproduct tree stops dividing and runs Horner
+#define POLY_TREE_LEAF 32
+
+struct poly {
+  int len;  // number of coefficients, c[len-1] is the leading one
+  int size; // number of allocated coefficients
+  mpz_t *c; // c[i] is the coefficient of x^i
+};
+
+// Binary tree of products prod (x - x_i) over a set of points.
+// node[0] is the root, the children of node[k] are node[2k+1] and node[2k+2].
+struct subproduct_tree {
+  int n;         // number of points
+  int nodes;     // number of nodes in the tree
+  int *lo;       // node k covers points lo[k] ... hi[k]-1
+  int *hi;
+  mpz_t *x;      // the points
+  struct poly *node;
+  struct poly *inv; // inv[k] = rev(node[k])^-1 mod x^terms[k], used to divide
+  int *terms;
+};
+
+void poly_init(struct poly *, int);
+
+void poly_clear(struct poly *);
+
+void poly_fit(struct poly *, int);
+
+void poly_normalize(struct poly *);
+
+void poly_set(struct poly *, const struct poly *);
+
+void poly_add(struct poly *, const struct poly *, const struct poly *, const mpz_t);
+
+void poly_sub(struct poly *, const struct poly *, const struct poly *, const mpz_t);
+
+void poly_mul(struct poly *, const struct poly *, const struct poly *, const mpz_t);
+
+void poly_rev_inverse(struct poly *, const struct poly *, int, const mpz_t);
+
+void poly_rem_precomp(struct poly *, const struct poly *, const struct poly *, const struct poly *, int, const mpz_t);
+
+void poly_rem(struct poly *, const struct poly *, const struct poly *, const mpz_t);
+
+void poly_divrem(struct poly *, struct poly *, const struct poly *, const struct poly *, const mpz_t);
+
+void poly_eval(mpz_t, const struct poly *, const mpz_t, const mpz_t);
+
+void build_subproduct_tree(struct subproduct_tree *, const mpz_t *, int, const mpz_t);
+
+void free_subproduct_tree(struct subproduct_tree *);
+
+void multipoint_evaluate(mpz_t *, const struct poly *, const struct subproduct_tree *, const mpz_t);
+
+void poly_interpolate(struct poly *, const mpz_t *, const struct subproduct_tree *, const mpz_t);
+
+#endif
@@ -0,0 +1,104 @@
+#include "reshare.h"
+
+// Refreshes every share in one pass: draws delta(x) = d[1] x + ... +
+// d[t-1] x^(t-1) and adds delta(i + 1) to share i and d[j] to s[j], keeping p
+// and the secret. Commitments of an earlier init_feldman no longer match.
+void refresh_shares(struct shamir *instance)
+{
+	if (instance->hasShares != 1) {
+		printf("Cannot refresh the shares of an instance without shares.\n");
+		return;
+	}
+
+	int t = instance->t;
+	mpz_t *delta = (mpz_t *) malloc(t * sizeof(mpz_t));
+	mpz_init(delta[0]);
+	for (int j = 1; j < t; j++) {
+		mpz_init(delta[j]);
+		mpz_urandomm(delta[j], instance->state, instance->p);
+		mpz_add((instance->s)[j], (instance->s)[j], delta[j]);
+		mpz_mod((instance->s)[j], (instance->s)[j], instance->p);
+	}
+
+	evaluate_shares(instance->shares, delta, t, 0, instance->n, instance->p, 1, instance->pool);
+
+	for (int j = 0; j < t; j++) {
+		mpz_clear(delta[j]);
+	}
+	free(delta);
+}
+
+// Reshares the secret of instance to a new (t2,n2) instance over the same p,
+// from the shares of the q old participants with x-coordinates x[0 ... q-1],
+// q >= t. Returns the new instance with its shares set, or NULL if the quorum
+// is not valid. The old instance is left as it is.
+//
+// Neither the secret nor any polynomial with it as constant term is formed:
+// quorum member i deals its share with its own g[i], and every new
+// participant k adds up l[i] g[i](k) over the sub-shares it receives. The new
+// instance therefore has shares but no polynomial, its s stays zero and
+// hasSecret 0. The work is q evaluations of a degree t2 - 1 polynomial at n2
+// points, split across the instance's pool.
+struct shamir *reshare_instance(struct shamir *instance, const int *x, int q, int t2, int n2)
+{
+	if (instance->hasShares != 1) {
+		printf("Cannot reshare an instance without shares.\n");
+		return NULL;
+	}
+	if (q < instance->t) {
+		printf("Resharing needs at least %d shares, got %d.\n", instance->t, q);
+		return NULL;
+	}
+	for (int i = 0; i < q; i++) {
+		if (x[i] > instance->n) {
+			printf("Share x-coordinate %d is not one of the %d participants.\n", x[i], instance->n);
+			return NULL;
+		}
+	}
+	struct shamir_recovery *context = init_shamir_recovery(x, q, instance->p);
+	if (context == NULL) {
+		return NULL;
+	}
+
+	struct shamir *reshared = init_shamir_instance(t2, n2, instance->lambda);
+	mpz_set(reshared->p, instance->p);
+	reshared->primes = instance->primes;
+	reshared->pool = instance->pool;
+
+	// g is the sub-polynomial of one quorum member, sub[k] its sub-share for
+	// new participant k + 1
+	mpz_t *g = (mpz_t *) malloc(t2 * sizeof(mpz_t));
+	mpz_t *sub = (mpz_t *) malloc(n2 * sizeof(mpz_t));
+	for (int j = 0; j < t2; j++) {
+		mpz_init(g[j]);
+	}
+	for (int k = 0; k < n2; k++) {
+		mpz_init(sub[k]);
+	}
+
+	for (int i = 0; i < q; i++) {
+		mpz_set(g[0], (instance->shares)[x[i] - 1]);
+		for (int j = 1; j < t2; j++) {
+			mpz_urandomm(g[j], reshared->state, reshared->p);
+		}
+		evaluate_shares(sub, g, t2, 0, n2, reshared->p, 0, reshared->pool);
+		for (int k = 0; k < n2; k++) {
+			mpz_addmul((reshared->shares)[k], sub[k], context->coeff[i]);
+		}
+	}
+	for (int k = 0; k < n2; k++) {
+		mpz_mod((reshared->shares)[k], (reshared->shares)[k], reshared->p);
+	}
+	reshared->hasShares = 1;
+
+	for (int j = 0; j < t2; j++) {
+		mpz_clear(g[j]);
+	}
+	for (int k = 0; k < n2; k++) {
+		mpz_clear(sub[k]);
+	}
+	free(g);
+	free(sub);
+	free_shamir_recovery(context);
+	return reshared;
+}
@@ -0,0 +1,30 @@
+// Share refresh and resharing of a Shamir instance without interpolating the
+// secret and without a new prime.
+//
+// refresh_shares adds a random polynomial with a zero constant term to the
+// instance, so every share changes and the secret does not: old shares are
+// useless together with new ones, and t - 1 old shares of an adversary are no
+// help against the refreshed instance.
+//
+// reshare_instance moves a secret from a (t,n) to a (t',n') sharing by
+// sub-sharing. Every member i of a quorum of old participants shares its own
+// share y[i] with a random polynomial g[i] of degree t' - 1 and g[i](0) = y[i],
+// and new participant k keeps sum_i l[i] g[i](k), with l[i] the quorum's
+// Lagrange coefficients at 0. That is the new participants' share of the
+// polynomial sum_i l[i] g[i], whose constant term is the old secret, but
+// neither that polynomial nor the secret is ever formed: the new instance
+// holds shares only.
+#ifndef SHAMIR_RESHARE_HEADER
+#define SHAMIR_RESHARE_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "shamir.h"
+#include "../common/visibility.h"
+
+SECRET_SHARING_API void refresh_shares(struct shamir *);
+
+SECRET_SHARING_API struct shamir *reshare_instance(struct shamir *, const int *, int, int, int);
+
+#endif
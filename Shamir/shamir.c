@@ -1,6 +1,6 @@
 #include "shamir.h"
 
-void free_instance(struct shamir *instance)
+void free_shamir_instance(struct shamir *instance)
 {
   if (instance->passedInit != 1)
   { // nothing aside from the struct was allocated
@@ -14,6 +14,8 @@ void free_instance(struct shamir *instance)
 	// clear s and shares array
 	for (int i = 0; i < instance->t; i++) {
 		mpz_clear((instance->s)[i]);
+	}
+	for (int i = 0; i < instance->n; i++) {
 		mpz_clear((instance->shares)[i]);
 	}
 	free(instance->s);
@@ -26,7 +28,7 @@ void free_instance(struct shamir *instance)
   return;
 }
 
-struct shamir *init_instance(int t, int n, int lambda)
+struct shamir *init_shamir_instance(int t, int n, int lambda)
 {
   struct shamir *instance;
   instance = (struct shamir *) malloc(1 * sizeof(struct shamir));
@@ -36,10 +38,10 @@ struct shamir *init_instance(int t, int n, int lambda)
   instance->hasSecret = 0;
   instance->hasShares = 0;
 
-  if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > 1000)
+  if (t > n || t < 2 || lambda < 64 || lambda > 512 || n > MAX_PARTICIPANTS)
   {
     printf("Shamir (%d,%d) scheme with security %d is not valid.\n", t, n, lambda);
-    free_instance(instance);
+    free_shamir_instance(instance);
     exit(EXIT_FAILURE);
   }
 
@@ -61,6 +63,7 @@ struct shamir *init_instance(int t, int n, int lambda)
 
 	// shares allocation
 	instance->shares = (mpz_t *) malloc(n * sizeof(mpz_t));
+	instance->capacity = n;
 
   // init s and shares values to 0
 	for (int i = 0; i < instance->t; i++) {
@@ -72,18 +75,46 @@ struct shamir *init_instance(int t, int n, int lambda)
 
 	// init p to 0
 	mpz_init(instance->p);
+	instance->primes.source = PRIME_TABLE;
+	instance->primes.cache = NULL;
+	instance->primes.secretBelowP = 0;
+	instance->pool = NULL;
 	
 	instance->passedInit = 1;
 
   return instance;
 }
 
-void generate_secret(struct shamir *instance)
+// Selects where generate_shamir_shares takes p from. cache is only used with
+// PRIME_CACHE, must have been started for the instance's lambda, and is not
+// owned by the instance.
+void set_shamir_prime_source(struct shamir *instance, enum prime_source source, struct prime_cache *cache)
+{
+  instance->primes.source = source;
+  instance->primes.cache = cache;
+}
+
+// With a table or special form prime, draw the secret uniformly below p
+// instead of below 2^lambda, so p never has to be replaced by a larger one.
+void set_shamir_secret_below_p(struct shamir *instance, int on)
+{
+  instance->primes.secretBelowP = on;
+}
+
+// Splits the evaluation of the shares across pool's threads. The pool is not
+// owned by the instance and can be shared by any number of them, as long as
+// they do not generate shares at the same time. NULL goes back to serial.
+void set_shamir_thread_pool(struct shamir *instance, struct thread_pool *pool)
+{
+  instance->pool = pool;
+}
+
+void generate_shamir_secret(struct shamir *instance)
 {
   if (instance->passedInit != 1)
   {
     printf("Failed trying to generate secret before instance init.\n");
-    free_instance(instance);
+    free_shamir_instance(instance);
     exit(EXIT_FAILURE);
   }
   else if (instance->hasSecret == 1)
@@ -93,13 +124,136 @@ void generate_secret(struct shamir *instance)
   }
 
   // generate secret
-	mpz_urandomb((instance->s)[0], instance->state, instance->lambda);
+	if (instance->primes.secretBelowP && fixed_prime(instance->p, &instance->primes, instance->lambda)) {
+		mpz_urandomm((instance->s)[0], instance->state, instance->p);
+	} else {
+		mpz_urandomb((instance->s)[0], instance->state, instance->lambda);
+	}
  
-  instance->hasSecret = 1; // so free_instance knows to free s
+  instance->hasSecret = 1; // so free_shamir_instance knows to free s
   return;
 }
 
-void generate_shares(struct shamir *instance)
+struct horner_job {
+	mpz_t *out;               // out[i] is the value at x = first + i + 1
+	int first;
+	const mpz_t *c;
+	int len;
+	mpz_srcptr p;
+	int add;                  // add the values to out instead of storing them
+	struct field *f;          // NULL if p does not fit the field layer
+	const mp_limb_t *coeffs;
+};
+
+// Computes out[i] = poly(x), x = first + i + 1, for begin <= i < end with
+// Horner's rule on the fixed-limb field layer, which does one single-limb
+// Montgomery reduction per step. If p does not fit the field layer, the
+// accumulator is kept as an mpz_t and only reduced mod p once it has grown a
+// limb past p, since multiplying by the small x only adds a few bits per step.
+static void horner_range(void *arg, int begin, int end)
+{
+	struct horner_job *job = (struct horner_job *) arg;
+	if (job->f != NULL) {
+		mp_limb_t value[FIELD_MAX_LIMBS], old[FIELD_MAX_LIMBS];
+		for (int i = begin; i < end; i++) {
+			job->f->ops->horner(value, job->coeffs, job->len, (mp_limb_t) (job->first + i + 1), job->f);
+			if (job->add) {
+				field_import(old, job->out[i], job->f);
+				job->f->ops->add(value, value, old, job->f);
+			}
+			field_export(job->out[i], value, job->f);
+		}
+		return;
+	}
+
+	size_t limit = mpz_size(job->p) + 1;
+	mpz_t value;
+	mpz_init(value);
+	for (int i = begin; i < end; i++) {
+		mpz_set(value, job->c[job->len - 1]);
+		for (int j = job->len - 2; j >= 0; j--) {
+			// value = value * x + c[j]
+			mpz_mul_ui(value, value, (unsigned long) (job->first + i + 1));
+			mpz_add(value, value, job->c[j]);
+			if (mpz_size(value) > limit) {
+				mpz_mod(value, value, job->p);
+			}
+		}
+		if (job->add) {
+			mpz_add(value, value, job->out[i]);
+		}
+		mpz_mod(job->out[i], value, job->p);
+	}
+	mpz_clear(value);
+}
+
+// Sets out[i] = c[0] + c[1] (i+1) + ... + c[len-1] (i+1)^(len-1) mod p for
+// begin <= i < end, or adds it to out[i] if add is nonzero, split across
+// pool's threads (NULL for serial). Each value only depends on its own x, so
+// the result does not depend on the pool size.
+void evaluate_shares(mpz_t *out, const mpz_t *c, int len, int begin, int end, const mpz_t p, int add,
+                     struct thread_pool *pool)
+{
+	struct field f;
+	struct horner_job job;
+	job.out = out + begin;
+	job.first = begin;
+	job.c = c;
+	job.len = len;
+	job.p = p;
+	job.add = add;
+	job.f = NULL;
+	job.coeffs = NULL;
+
+	mp_limb_t *coeffs = NULL;
+	if (field_init(&f, p)) {
+		coeffs = (mp_limb_t *) malloc((size_t) len * f.limbs * sizeof(mp_limb_t));
+		field_horner_coeffs(coeffs, c, len, &f);
+		job.f = &f;
+		job.coeffs = coeffs;
+	}
+	thread_pool_run(pool, end - begin, horner_range, &job);
+	free(coeffs);
+}
+
+// Same values as evaluate_shares, for all i at once by multi-point evaluation
+// over the subproduct tree of (x - 1)(x - 2)...(x - n), which is quasi-linear
+// in n and len instead of n * len steps of Horner's rule.
+void tree_evaluate_shares(mpz_t *out, const mpz_t *c, int len, int n, const mpz_t p)
+{
+	mpz_t *points = (mpz_t *) malloc(n * sizeof(mpz_t));
+	for (int i = 0; i < n; i++) {
+		mpz_init_set_ui(points[i], (unsigned long) (i + 1));
+	}
+
+	struct subproduct_tree tree;
+	build_subproduct_tree(&tree, points, n, p);
+
+	// view the coefficient array as a polynomial without copying it
+	struct poly f;
+	f.len = len;
+	f.size = len;
+	f.c = (mpz_t *) c;
+	poly_normalize(&f);
+
+	multipoint_evaluate(out, &f, &tree, p);
+
+	free_subproduct_tree(&tree);
+	for (int i = 0; i < n; i++) {
+		mpz_clear(points[i]);
+	}
+	free(points);
+}
+
+// whether generate_shamir_shares evaluates on the subproduct tree for t, n
+// and a p of the given number of limbs
+int uses_subproduct_tree(int t, int n, int limbs)
+{
+	int cutoff = SUBPRODUCT_THRESHOLD * (limbs + 4);
+	return n >= cutoff && t >= cutoff;
+}
+
+void generate_shamir_shares(struct shamir *instance)
 {
   if (instance->hasShares != 0)
   {
@@ -108,22 +262,8 @@ void generate_shares(struct shamir *instance)
   }
 
 	// CHOOSING GALOIS FIELD GF(p)
-	// make random p such that s < p < 2^lambda
-	mpz_urandomb(instance->p, instance->state, instance->lambda);
-	while (mpz_cmp(instance->p, (instance->s)[0]) <= 0) {
-		mpz_urandomb(instance->p, instance->state, instance->lambda);
-	}
-	mpz_nextprime(instance->p, instance->p); // make next prime
-	int prime_found = 0;
-	while (prime_found == 0) { // make sure p is prime with err prob 1/2^lambda
-		int test;
-		test = mpz_probab_prime_p(instance->p, (instance->lambda) / 2);
-		if (test > 0) { // it was prime
-			prime_found = 1;
-		} else if (test == 0) {  // it was not prime
-			mpz_nextprime(instance->p, instance->p);
-		}
-	}
+	// prime p such that s < p, from the instance's prime source
+	provide_prime(instance->p, &instance->primes, instance->lambda, (instance->s)[0], instance->state);
 
 	// CHOOSING POLYNOMIAL IN [s[0], ..., s[t-1]] in GF(p)[x^0, ..., x^t-1]
 	for (int i = 1; i < instance->t; i++) {
@@ -131,32 +271,252 @@ void generate_shares(struct shamir *instance)
 		mpz_urandomm((instance->s)[i], instance->state, instance->p); 
 	}
 
-	// Computing shares[i] = poly(i)
-	mpz_t term;
-	for (int i = 0; i < instance->n; i++) {
-		// shares[i] = s[0]
-		mpz_set((instance->shares)[i], (instance->s)[0]);
-		// term = 1
-		mpz_init_set_ui(term, (unsigned long) 1); 
-		for (int j = 1; j < instance->t; j++) {
-			// term = term * (i+1)
-			mpz_mul_ui(term, term, (unsigned long) (i + 1));
-			// term = term mod p
-			mpz_mod(term, term, instance->p);
-			// shares[i] += s[j] * term
-			mpz_addmul((instance->shares)[i], (instance->s)[j], term);
-			// shares[i] = shares[i] mod p
-			mpz_mod((instance->shares)[i], (instance->shares)[i], instance->p); 
-		}
+	// Computing shares[i] = poly(i + 1)
+	if (uses_subproduct_tree(instance->t, instance->n, (int) mpz_size(instance->p))) {
+		tree_evaluate_shares(instance->shares, instance->s, instance->t, instance->n, instance->p);
+	} else {
+		evaluate_shares(instance->shares, instance->s, instance->t, 0, instance->n, instance->p, 0, instance->pool);
 	}
-	mpz_clear(term);
-	
+
 	instance->hasShares = 1;
   
   return;
 }
 
-int recover_secret(struct shamir *instance)
+// Enrolls participants n+1, ..., n+k into an instance that already has
+// shares, evaluating the polynomial only at the new points, so each one costs
+// t steps of Horner's rule. The shares array grows geometrically.
+void add_shamir_participants(struct shamir *instance, int k)
+{
+	if (instance->hasShares != 1 || instance->hasSecret != 1) {
+		printf("Cannot add participants to an instance without shares and their polynomial.\n");
+		return;
+	}
+	if (k < 1 || k > MAX_PARTICIPANTS - instance->n) {
+		printf("Cannot add %d participants to %d, the limit is %d.\n", k, instance->n, MAX_PARTICIPANTS);
+		return;
+	}
+
+	int n = instance->n + k;
+	if (n > instance->capacity) {
+		int capacity = 2 * instance->capacity > n ? 2 * instance->capacity : n;
+		instance->shares = (mpz_t *) realloc(instance->shares, capacity * sizeof(mpz_t));
+		instance->capacity = capacity;
+	}
+	for (int i = instance->n; i < n; i++) {
+		mpz_init((instance->shares)[i]);
+	}
+
+	evaluate_shares(instance->shares, instance->s, instance->t, instance->n, n, instance->p, 0, instance->pool);
+	instance->n = n;
+}
+
+// Sets inv[i] = i^-1 mod p for 1 <= i <= m without a single modular inversion,
+// using p = (p / i) * i + (p mod i), so i^-1 = -(p / i) * (p mod i)^-1.
+// inv must have room for m + 1 entries and p must be a prime larger than m.
+void small_inverses(mpz_t *inv, int m, const mpz_t p)
+{
+	mpz_t q;
+	mpz_init(q);
+	mpz_set_ui(inv[1], (unsigned long int) 1);
+	for (int i = 2; i <= m; i++) {
+		// q = p / i, r = p mod i < i
+		unsigned long int r = mpz_fdiv_q_ui(q, p, (unsigned long int) i);
+		mpz_mul(inv[i], q, inv[r]);
+		mpz_neg(inv[i], inv[i]);
+		mpz_mod(inv[i], inv[i], p);
+	}
+	mpz_clear(q);
+}
+
+// Checks that the quorum's x-coordinates are distinct and in 1 ... p-1.
+// Returns the largest of them, or 0 if the quorum is not valid.
+int check_quorum(const int *x, int k, const mpz_t p)
+{
+	int max_x = 0;
+	for (int i = 0; i < k; i++) {
+		if (x[i] < 1 || mpz_cmp_ui(p, (unsigned long int) x[i]) <= 0) {
+			printf("Share x-coordinate %d is not in 1 ... p-1.\n", x[i]);
+			return 0;
+		}
+		for (int j = 0; j < i; j++) {
+			if (x[i] == x[j]) {
+				printf("Share x-coordinate %d appears twice in the quorum.\n", x[i]);
+				return 0;
+			}
+		}
+		if (x[i] > max_x) {
+			max_x = x[i];
+		}
+	}
+	return max_x;
+}
+
+// Sets dinv[i] = d[i]^-1 mod p, d[i] = prod_{j != i} (x[j] - x[i]), for a
+// valid quorum. The d[i] are built from word-sized factors and inverted
+// together with Montgomery's trick, so this does a single modular inversion.
+void lagrange_denominators(mpz_t *dinv, const int *x, int k, const mpz_t p)
+{
+	size_t limit = mpz_size(p) + 1;
+	mpz_t *d = (mpz_t *) malloc(k * sizeof(mpz_t));
+	mpz_t acc;
+	mpz_init(acc);
+
+	// d[i], reduced lazily
+	for (int i = 0; i < k; i++) {
+		int negative = 0;
+		mpz_init_set_ui(d[i], (unsigned long int) 1);
+		for (int j = 0; j < k; j++) {
+			if (j == i) {
+				continue;
+			}
+			if (x[j] < x[i]) {
+				negative ^= 1;
+				mpz_mul_ui(d[i], d[i], (unsigned long int) (x[i] - x[j]));
+			} else {
+				mpz_mul_ui(d[i], d[i], (unsigned long int) (x[j] - x[i]));
+			}
+			if (mpz_size(d[i]) > limit) {
+				mpz_mod(d[i], d[i], p);
+			}
+		}
+		if (negative) {
+			mpz_neg(d[i], d[i]);
+		}
+		mpz_mod(d[i], d[i], p);
+	}
+
+	// Montgomery's trick: dinv[i] = d[0] * ... * d[i], invert only the last
+	// prefix and peel the individual inverses back off it.
+	mpz_set(dinv[0], d[0]);
+	for (int i = 1; i < k; i++) {
+		mpz_mul(dinv[i], dinv[i - 1], d[i]);
+		mpz_mod(dinv[i], dinv[i], p);
+	}
+	mpz_invert(acc, dinv[k - 1], p); // acc = (d[0] * ... * d[k-1])^-1
+	for (int i = k - 1; i > 0; i--) {
+		// d[i]^-1 = acc * prefix[i-1], then drop d[i] from acc
+		mpz_mul(dinv[i], acc, dinv[i - 1]);
+		mpz_mod(dinv[i], dinv[i], p);
+		mpz_mul(acc, acc, d[i]);
+		mpz_mod(acc, acc, p);
+	}
+	mpz_set(dinv[0], acc);
+
+	for (int i = 0; i < k; i++) {
+		mpz_clear(d[i]);
+	}
+	free(d);
+	mpz_clear(acc);
+}
+
+// Precomputes the Lagrange coefficients at 0 for shares with x-coordinates
+// x[0], ..., x[k-1] over GF(p). Each coefficient is
+// 	coeff[i] = prod_{j != i} x[j] / (x[j] - x[i])
+// 	         = N * x[i]^-1 * d[i]^-1,  N = prod x[j],  d[i] = prod_{j != i} (x[j] - x[i])
+// The x[i]^-1 come from a table of small inverses and the d[i]^-1 from
+// lagrange_denominators, so the whole setup does a single modular inversion.
+struct shamir_recovery *init_shamir_recovery(const int *x, int k, const mpz_t p)
+{
+	int max_x = check_quorum(x, k, p);
+	if (max_x == 0) {
+		return NULL;
+	}
+
+	struct shamir_recovery *context;
+	context = (struct shamir_recovery *) malloc(1 * sizeof(struct shamir_recovery));
+	context->k = k;
+	context->x = (int *) malloc(k * sizeof(int));
+	memcpy(context->x, x, k * sizeof(int));
+	mpz_init_set(context->p, p);
+	context->coeff = (mpz_t *) malloc(k * sizeof(mpz_t));
+	for (int i = 0; i < k; i++) {
+		mpz_init(context->coeff[i]);
+	}
+
+	size_t limit = mpz_size(p) + 1;
+	mpz_t numerator;
+	mpz_init_set_ui(numerator, (unsigned long int) 1);
+
+	// numerator = prod x[j]
+	for (int j = 0; j < k; j++) {
+		mpz_mul_ui(numerator, numerator, (unsigned long int) x[j]);
+		if (mpz_size(numerator) > limit) {
+			mpz_mod(numerator, numerator, p);
+		}
+	}
+	mpz_mod(numerator, numerator, p);
+
+	lagrange_denominators(context->coeff, x, k, p);
+
+	// coeff[i] = numerator * x[i]^-1 * d[i]^-1
+	mpz_t *inv = (mpz_t *) malloc((max_x + 1) * sizeof(mpz_t));
+	for (int i = 0; i <= max_x; i++) {
+		mpz_init(inv[i]);
+	}
+	small_inverses(inv, max_x, p);
+	for (int i = 0; i < k; i++) {
+		mpz_mul(context->coeff[i], context->coeff[i], inv[x[i]]);
+		mpz_mod(context->coeff[i], context->coeff[i], p);
+		mpz_mul(context->coeff[i], context->coeff[i], numerator);
+		mpz_mod(context->coeff[i], context->coeff[i], p);
+	}
+
+	// keep a fixed-limb copy of the coefficients for shamir_recover_with
+	context->coeff_limbs = NULL;
+	if (field_init(&(context->f), p)) {
+		context->coeff_limbs = (mp_limb_t *) malloc((size_t) k * context->f.limbs * sizeof(mp_limb_t));
+		for (int i = 0; i < k; i++) {
+			field_import(context->coeff_limbs + (size_t) i * context->f.limbs, context->coeff[i], &(context->f));
+		}
+	}
+
+	for (int i = 0; i <= max_x; i++) {
+		mpz_clear(inv[i]);
+	}
+	free(inv);
+	mpz_clear(numerator);
+	return context;
+}
+
+void free_shamir_recovery(struct shamir_recovery *context)
+{
+	for (int i = 0; i < context->k; i++) {
+		mpz_clear(context->coeff[i]);
+	}
+	free(context->coeff);
+	free(context->coeff_limbs);
+	free(context->x);
+	mpz_clear(context->p);
+	free(context);
+}
+
+// Recovers a secret from the quorum's shares, where ys[i] is the share of the
+// participant with x-coordinate context->x[i]. This is a single dot product,
+// so a context can be reused for every secret the quorum unlocks.
+void shamir_recover_with(mpz_t secret, const struct shamir_recovery *context, const mpz_t *ys)
+{
+	if (context->coeff_limbs != NULL) {
+		const struct field *f = &(context->f);
+		mp_limb_t *y = (mp_limb_t *) malloc((size_t) context->k * f->limbs * sizeof(mp_limb_t));
+		mp_limb_t result[FIELD_MAX_LIMBS];
+		for (int i = 0; i < context->k; i++) {
+			field_import(y + (size_t) i * f->limbs, ys[i], f);
+		}
+		f->ops->dot(result, y, context->coeff_limbs, context->k, f);
+		field_export(secret, result, f);
+		free(y);
+		return;
+	}
+
+	mpz_set_ui(secret, (unsigned long int) 0);
+	for (int i = 0; i < context->k; i++) {
+		mpz_addmul(secret, ys[i], context->coeff[i]);
+	}
+	mpz_mod(secret, secret, context->p);
+}
+
+int recover_shamir_secret(struct shamir *instance)
 {
 	if (instance->hasShares != 1) {
 		printf("Cannot recover secret if no shares exist.\n");
@@ -164,36 +524,17 @@ int recover_secret(struct shamir *instance)
 		exit(EXIT_FAILURE);
 	}
 
-	// LAGRANGE INTERPOLATION
-	mpz_t result, product, denom;
-	mpz_init(result); // result = 0
-	mpz_init(product); // product = 0
-	mpz_init(denom);  // den = 0
+	// LAGRANGE INTERPOLATION from participants 1, ..., t
+	int *x = (int *) malloc(instance->t * sizeof(int));
 	for (int i = 0; i < instance->t; i++) {
-		mpz_set_ui(product, (unsigned long int) 1); // product = 1
-		for (int j = 0; j < instance->t; j++) {
-			if (j != i) {
-				// multiplying the numerator
-				// product = product * (j + 1) mod p
-				mpz_mul_ui(product, product, (unsigned long int) (j + 1));
-				mpz_mod(product, product, instance->p);
-
-				// multiplying the denominator
-				// denom = (j+1) - (i+1)
-				mpz_set_si(denom, (signed long int) ((j + 1) - (i  +1)));
-				// denom = denom mod p
-				mpz_fdiv_r(denom, denom, instance->p);
-				// denom = denom^-1
-				mpz_invert(denom, denom, instance->p);
-				// product = product * denom
-				mpz_mul(product, product, denom);
-			}
-		}
-
-		// result = result + shares[i] * product mod p
-		mpz_addmul(result, (instance->shares)[i], product);
-		mpz_mod(result, result, instance->p);
+		x[i] = i + 1;
 	}
+	struct shamir_recovery *context = init_shamir_recovery(x, instance->t, instance->p);
+	free(x);
+
+	mpz_t result;
+	mpz_init(result);
+	shamir_recover_with(result, context, instance->shares);
 
 	int found_secret = 0;
 	if (mpz_cmp(result, (instance->s)[0]) == 0) { // SUCCESS!
@@ -201,12 +542,11 @@ int recover_secret(struct shamir *instance)
 	}
 
 	mpz_clear(result);
-	mpz_clear(product);
-	mpz_clear(denom);
+	free_shamir_recovery(context);
 	return found_secret;
 }
 
-void print_instance(struct shamir *instance)
+void print_shamir_instance(struct shamir *instance)
 {
   if (instance->passedInit != 1)
   {
@@ -4,7 +4,27 @@
 #include <gmp.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/random.h>
+#include "poly.h"
+#include "../common/field.h"
+#include "../common/primes.h"
+#include "../common/threadpool.h"
+#include "../common/visibility.h"
+
+// largest number of participants an instance accepts: secrets are sharded to
+// thousands of custodians, and the subproduct tree only takes over from
+// Horner at 5000 to 12000 of them (see SUBPRODUCT_THRESHOLD). Counts and
+// products of two counts, such as the k * q coefficients of a packed
+// recovery, stay within an int.
+#define MAX_PARTICIPANTS 16384
+
+// generate_shamir_shares switches from Horner to the subproduct tree once both n and t
+// reach SUBPRODUCT_THRESHOLD * (limbs in p + 4). Measured with t = n on one core
+// (./benchmark t n lambda evaluate): the tree catches up with Horner at about
+// 5000 for one limb, 7000 for two, 8000 to 10000 for three to six and 12000
+// for eight.
+#define SUBPRODUCT_THRESHOLD 1000
 
 struct shamir {
   int t;
@@ -20,19 +40,61 @@ struct shamir {
   // big ints
 	mpz_t *s; // secret array. s[0] is secret. s[i] is ith coefficient of the poly
 	mpz_t p; // we will do arithmetic over GF(p).
+	struct prime_provider primes; // where p comes from, the prime table by default
+	struct thread_pool *pool; // splits share generation across threads, NULL for serial
 	mpz_t *shares; // share array. Participant 0's share is (0, share[0]).
+	int capacity; // shares allocated, at least n
+};
+
+// Lagrange coefficients for a fixed quorum of share x-coordinates, so that
+// the same quorum can recover any number of secrets with one dot product each.
+struct shamir_recovery {
+  int k;        // number of shares in the quorum
+  int *x;       // x-coordinates of the quorum's shares
+  mpz_t p;
+  mpz_t *coeff; // coeff[i] is the Lagrange basis polynomial for x[i] at 0
+
+  // the same coefficients on the fixed-limb field layer, NULL if p does not fit
+  struct field f;
+  mp_limb_t *coeff_limbs;
 };
 
-void free_instance(struct shamir *);
+SECRET_SHARING_API void free_shamir_instance(struct shamir *);
+
+SECRET_SHARING_API struct shamir *init_shamir_instance(int, int, int);
+
+SECRET_SHARING_API void set_shamir_prime_source(struct shamir *, enum prime_source, struct prime_cache *);
+
+SECRET_SHARING_API void set_shamir_secret_below_p(struct shamir *, int);
+
+SECRET_SHARING_API void set_shamir_thread_pool(struct shamir *, struct thread_pool *);
+
+SECRET_SHARING_API void generate_shamir_secret(struct shamir *);
+
+void evaluate_shares(mpz_t *, const mpz_t *, int, int, int, const mpz_t, int, struct thread_pool *);
+
+void tree_evaluate_shares(mpz_t *, const mpz_t *, int, int, const mpz_t);
+
+int uses_subproduct_tree(int, int, int);
+
+SECRET_SHARING_API void generate_shamir_shares(struct shamir *);
+
+SECRET_SHARING_API void add_shamir_participants(struct shamir *, int);
+
+void small_inverses(mpz_t *, int, const mpz_t);
+
+int check_quorum(const int *, int, const mpz_t);
+
+void lagrange_denominators(mpz_t *, const int *, int, const mpz_t);
 
-struct shamir *init_instance(int, int, int);
+SECRET_SHARING_API struct shamir_recovery *init_shamir_recovery(const int *, int, const mpz_t);
 
-void generate_secret(struct shamir *);
+SECRET_SHARING_API void free_shamir_recovery(struct shamir_recovery *);
 
-void generate_shares(struct shamir *);
+SECRET_SHARING_API void shamir_recover_with(mpz_t, const struct shamir_recovery *, const mpz_t *);
 
-int recover_secret(struct shamir *);
+SECRET_SHARING_API int recover_shamir_secret(struct shamir *);
 
-void print_instance(struct shamir *);
+SECRET_SHARING_API void print_shamir_instance(struct shamir *);
 
 #endif
@@ -0,0 +1,162 @@
+#include "stream.h"
+
+// Starts an empty stream for a (t,n) secret shared over GF(p).
+struct shamir_stream *init_shamir_stream(int t, const mpz_t p)
+{
+	if (t < 2) {
+		printf("A stream needs a threshold of at least 2, got %d.\n", t);
+		exit(EXIT_FAILURE);
+	}
+
+	struct shamir_stream *stream;
+	stream = (struct shamir_stream *) malloc(1 * sizeof(struct shamir_stream));
+	stream->t = t;
+	stream->k = 0;
+	mpz_init_set(stream->p, p);
+	stream->x = (int *) malloc(t * sizeof(int));
+	stream->a = (mpz_t *) malloc(t * sizeof(mpz_t));
+	for (int j = 0; j < t; j++) {
+		mpz_init(stream->a[j]);
+	}
+	mpz_init_set_ui(stream->w, (unsigned long int) 1);
+	mpz_init(stream->secret);
+	stream->callback = NULL;
+	stream->arg = NULL;
+	pthread_mutex_init(&(stream->lock), NULL);
+	pthread_cond_init(&(stream->ready), NULL);
+	return stream;
+}
+
+void free_shamir_stream(struct shamir_stream *stream)
+{
+	for (int j = 0; j < stream->t; j++) {
+		mpz_clear(stream->a[j]);
+	}
+	free(stream->a);
+	free(stream->x);
+	mpz_clear(stream->p);
+	mpz_clear(stream->w);
+	mpz_clear(stream->secret);
+	pthread_mutex_destroy(&(stream->lock));
+	pthread_cond_destroy(&(stream->ready));
+	free(stream);
+}
+
+// Registers fn(secret, arg) to be called once the t-th share arrives. If the
+// secret is already there, fn is not called.
+void set_stream_callback(struct shamir_stream *stream, stream_callback fn, void *arg)
+{
+	pthread_mutex_lock(&(stream->lock));
+	stream->callback = fn;
+	stream->arg = arg;
+	pthread_mutex_unlock(&(stream->lock));
+}
+
+// Takes share y of the participant with x-coordinate x. Returns the number of
+// shares taken so far, or -1 if the share is rejected: x is not in 1 ... p-1
+// or was seen before, or the quorum is complete and y does not lie on its
+// polynomial.
+int add_stream_share(struct shamir_stream *stream, int x, const mpz_t y)
+{
+	pthread_mutex_lock(&(stream->lock));
+	int k = stream->k;
+	if (x < 1 || mpz_cmp_ui(stream->p, (unsigned long int) x) <= 0) {
+		printf("Share x-coordinate %d is not in 1 ... p-1.\n", x);
+		pthread_mutex_unlock(&(stream->lock));
+		return -1;
+	}
+	for (int j = 0; j < k; j++) {
+		if (stream->x[j] == x) {
+			printf("Share x-coordinate %d arrived twice.\n", x);
+			pthread_mutex_unlock(&(stream->lock));
+			return -1;
+		}
+	}
+
+	// value = P(x) from the Newton form, d = prod_{j<k} (x - x[j]), both with
+	// word-sized factors and reduced lazily
+	size_t limit = mpz_size(stream->p) + 1;
+	mpz_t value, d;
+	mpz_init(value);
+	mpz_init_set_ui(d, (unsigned long int) 1);
+	if (k > 0) {
+		mpz_set(value, stream->a[k - 1]);
+	}
+	for (int j = k - 2; j >= 0; j--) {
+		mpz_mul_si(value, value, (long int) x - stream->x[j]);
+		mpz_add(value, value, stream->a[j]);
+		if (mpz_size(value) > limit) {
+			mpz_mod(value, value, stream->p);
+		}
+	}
+	for (int j = 0; j < k; j++) {
+		mpz_mul_si(d, d, (long int) x - stream->x[j]);
+		if (mpz_size(d) > limit) {
+			mpz_mod(d, d, stream->p);
+		}
+	}
+	mpz_sub(value, y, value);
+	mpz_mod(value, value, stream->p);
+
+	if (k == stream->t) {
+		// P is fixed, so y has to be on it
+		int on = mpz_sgn(value) == 0;
+		if (!on) {
+			printf("Share of x-coordinate %d does not match the other shares.\n", x);
+		}
+		mpz_clear(value);
+		mpz_clear(d);
+		pthread_mutex_unlock(&(stream->lock));
+		return on ? k : -1;
+	}
+
+	// a[k] = (y - P(x)) / d, then P(0) += a[k] * w and w *= -x
+	mpz_mod(d, d, stream->p);
+	mpz_invert(d, d, stream->p);
+	mpz_mul(stream->a[k], value, d);
+	mpz_mod(stream->a[k], stream->a[k], stream->p);
+	mpz_addmul(stream->secret, stream->a[k], stream->w);
+	mpz_mod(stream->secret, stream->secret, stream->p);
+	mpz_mul_si(stream->w, stream->w, -(long int) x);
+	mpz_mod(stream->w, stream->w, stream->p);
+	stream->x[k] = x;
+	stream->k = ++k;
+	mpz_clear(value);
+	mpz_clear(d);
+
+	stream_callback callback = NULL;
+	if (k == stream->t) {
+		callback = stream->callback;
+		pthread_cond_broadcast(&(stream->ready));
+	}
+	pthread_mutex_unlock(&(stream->lock));
+
+	// the secret does not change any more, so it is read without the lock
+	if (callback != NULL) {
+		callback(stream->secret, stream->arg);
+	}
+	return k;
+}
+
+// Sets secret and returns 1 if the quorum is complete, returns 0 otherwise.
+int stream_secret(mpz_t secret, struct shamir_stream *stream)
+{
+	pthread_mutex_lock(&(stream->lock));
+	int done = stream->k == stream->t;
+	if (done) {
+		mpz_set(secret, stream->secret);
+	}
+	pthread_mutex_unlock(&(stream->lock));
+	return done;
+}
+
+// Blocks until the t-th share has arrived, then sets secret.
+void wait_stream_secret(mpz_t secret, struct shamir_stream *stream)
+{
+	pthread_mutex_lock(&(stream->lock));
+	while (stream->k < stream->t) {
+		pthread_cond_wait(&(stream->ready), &(stream->lock));
+	}
+	mpz_set(secret, stream->secret);
+	pthread_mutex_unlock(&(stream->lock));
+}
@@ -0,0 +1,53 @@
+// Incremental recovery of a Shamir secret from shares that arrive one at a
+// time.
+//
+// The stream keeps the polynomial through the shares seen so far in Newton
+// form, P(x) = a[0] + a[1] (x - x[0]) + a[2] (x - x[0]) (x - x[1]) + ...,
+// together with its value P(0). A new share (x[k], y) only appends
+// a[k] = (y - P(x[k])) / prod_{j<k} (x[k] - x[j]) and updates P(0), which is
+// O(k) small multiplications and one inversion, so when the t-th share lands
+// the secret is ready after O(t) work instead of a whole O(t^2) Lagrange
+// setup. Shares arriving after that are checked against the polynomial.
+//
+// Shares may come from any number of threads. A service can either wait for
+// the quorum with wait_stream_secret or register a callback that runs once,
+// in the thread that delivers the t-th share.
+#ifndef SHAMIR_STREAM_HEADER
+#define SHAMIR_STREAM_HEADER
+
+#include <gmp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "../common/visibility.h"
+
+typedef void (*stream_callback)(const mpz_t, void *);
+
+struct shamir_stream {
+  int t;
+  int k;        // shares taken so far, at most t
+  mpz_t p;
+  int *x;       // x-coordinates of the shares taken
+  mpz_t *a;     // Newton coefficients, a[j] for j < k
+  mpz_t w;      // prod_{j<k} (0 - x[j]) mod p, the next basis polynomial at 0
+  mpz_t secret; // P(0) of the shares taken so far, the secret once k = t
+
+  stream_callback callback; // called once the secret is ready, NULL for none
+  void *arg;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+};
+
+SECRET_SHARING_API struct shamir_stream *init_shamir_stream(int, const mpz_t);
+
+SECRET_SHARING_API void free_shamir_stream(struct shamir_stream *);
+
+SECRET_SHARING_API void set_stream_callback(struct shamir_stream *, stream_callback, void *);
+
+SECRET_SHARING_API int add_stream_share(struct shamir_stream *, int, const mpz_t);
+
+SECRET_SHARING_API int stream_secret(mpz_t, struct shamir_stream *);
+
+SECRET_SHARING_API void wait_stream_secret(mpz_t, struct shamir_stream *);
+
+#endif
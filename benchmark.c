@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 199309L
+#include "secretsharing.h"
+#include <stdio.h>
+#include <time.h>
+
+static double since(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+// shares and recovers one secret with scheme, through the common interface
+// only, and returns whether it was recovered
+static int time_scheme(const struct secret_sharing_scheme *scheme, int t, int n, int lambda, struct thread_pool *pool,
+                       double *share_ms, double *recover_ms)
+{
+  struct timespec start;
+  void *instance = scheme->init(t, n, lambda);
+  scheme->set_thread_pool(instance, pool);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  scheme->generate_secret(instance);
+  scheme->generate_shares(instance);
+  *share_ms = since(&start);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int found = scheme->recover_secret(instance);
+  *recover_ms = since(&start);
+  scheme->free(instance);
+  return found;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 4)
+  {
+    printf("Must input a threshold, number of parties, and security parameter.\n");
+    printf("An optional fourth argument is the number of threads, 0 for one per processor.\n");
+    printf("Shares and recovers a secret with every scheme that takes the parameters and names the fastest.\n");
+    exit(EXIT_FAILURE);
+  }
+  int t = (int)strtol(argv[1], NULL, 10);
+  int n = (int)strtol(argv[2], NULL, 10);
+  int lambda = (int)strtol(argv[3], NULL, 10);
+  struct thread_pool *pool = argc > 4 ? start_thread_pool((int)strtol(argv[4], NULL, 10)) : NULL;
+
+  const struct secret_sharing_scheme *fastest = NULL;
+  double best = 0;
+  for (int i = 0; secret_sharing_schemes[i] != NULL; i++)
+  {
+    const struct secret_sharing_scheme *scheme = secret_sharing_schemes[i];
+    if (!scheme_accepts(scheme, t, n, lambda))
+    {
+      printf("%-13s does not take (%d,%d) with security %d\n", scheme->name, t, n, lambda);
+      continue;
+    }
+    double share, recover;
+    int found = time_scheme(scheme, t, n, lambda, pool, &share, &recover);
+    printf("%-13s shared in %10.3f ms, recovered in %10.3f ms, secret recovered: %d\n", scheme->name, share, recover,
+           found);
+    if (found && (fastest == NULL || share + recover < best))
+    {
+      fastest = scheme;
+      best = share + recover;
+    }
+  }
+  if (fastest != NULL)
+  {
+    printf("Fastest: %s\n", fastest->name);
+  }
+
+  stop_thread_pool(pool);
+  return 0;
+}
@@ -81,6 +81,16 @@ done
 done
 done
 
+# Shamir's share evaluation across the point where generate_shamir_shares moves
+# from Horner's rule to the subproduct tree (SUBPRODUCT_THRESHOLD)
+for n in 4000 8000 12000 16000; do
+for l in 64 256 512; do
+   newfile="${dir_dest}/Shamir-evaluate-${n}_${l}"
+   echo "   creating $newfile"
+   $exec_S $n $n $l evaluate > ${newfile}
+done
+done
+
 #Save results for future 
 
 mkdir "${dir_source}/data"
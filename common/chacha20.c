@@ -0,0 +1,296 @@
+#include "chacha20.h"
+#include <string.h>
+#include <immintrin.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#define ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QR(a, b, c, d)                          \
+  do {                                          \
+    a += b; d ^= a; d = ROTL(d, 16);            \
+    c += d; b ^= c; b = ROTL(b, 12);            \
+    a += b; d ^= a; d = ROTL(d, 8);             \
+    c += d; b ^= c; b = ROTL(b, 7);             \
+  } while (0)
+
+static void chacha20_input(uint32_t *in, const struct chacha20 *s)
+{
+  in[0] = 0x61707865;
+  in[1] = 0x3320646e;
+  in[2] = 0x79622d32;
+  in[3] = 0x6b206574;
+  memcpy(in + 4, s->key, sizeof(s->key));
+  in[12] = 0;
+  in[13] = 0;
+  in[14] = (uint32_t) s->nonce;
+  in[15] = (uint32_t) (s->nonce >> 32);
+}
+
+static void store32(uint8_t *o, uint32_t v)
+{
+  o[0] = (uint8_t) v;
+  o[1] = (uint8_t) (v >> 8);
+  o[2] = (uint8_t) (v >> 16);
+  o[3] = (uint8_t) (v >> 24);
+}
+
+static void chacha20_blocks_scalar(const struct chacha20 *s, uint64_t counter, uint8_t *out)
+{
+  uint32_t in[16], x[16];
+  chacha20_input(in, s);
+
+  for (int l = 0; l < CHACHA20_LANES; l++, out += 64)
+  {
+    in[12] = (uint32_t) (counter + l);
+    in[13] = (uint32_t) ((counter + l) >> 32);
+    memcpy(x, in, sizeof(x));
+    for (int r = 0; r < 10; r++)
+    {
+      QR(x[0], x[4], x[8], x[12]);
+      QR(x[1], x[5], x[9], x[13]);
+      QR(x[2], x[6], x[10], x[14]);
+      QR(x[3], x[7], x[11], x[15]);
+      QR(x[0], x[5], x[10], x[15]);
+      QR(x[1], x[6], x[11], x[12]);
+      QR(x[2], x[7], x[8], x[13]);
+      QR(x[3], x[4], x[9], x[14]);
+    }
+    for (int w = 0; w < 16; w++)
+      store32(out + 4 * w, x[w] + in[w]);
+  }
+}
+
+#define ADD(a, b) _mm256_add_epi32(a, b)
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ROTV(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+#define QRV(a, b, c, d)                                         \
+  do {                                                          \
+    a = ADD(a, b); d = XOR(d, a); d = _mm256_shuffle_epi8(d, rot16); \
+    c = ADD(c, d); b = XOR(b, c); b = ROTV(b, 12);              \
+    a = ADD(a, b); d = XOR(d, a); d = _mm256_shuffle_epi8(d, rot8); \
+    c = ADD(c, d); b = XOR(b, c); b = ROTV(b, 7);               \
+  } while (0)
+
+// eight blocks counter ... counter + 7, one per 32 bit lane; x86 is little endian,
+// so the words are stored as they are
+__attribute__((target("avx2")))
+static void chacha20_blocks_avx2(const struct chacha20 *s, uint64_t counter, uint8_t *out)
+{
+  uint32_t in[16];
+  __m256i x[16];
+  const __m256i rot16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+  const __m256i rot8 = _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                       14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+  chacha20_input(in, s);
+
+  for (int w = 0; w < 16; w++)
+    x[w] = _mm256_set1_epi32((int) in[w]);
+  __m256i lo = _mm256_set1_epi64x((long long) counter);
+  __m256i c0 = _mm256_add_epi64(lo, _mm256_set_epi64x(3, 2, 1, 0));
+  __m256i c1 = _mm256_add_epi64(lo, _mm256_set_epi64x(7, 6, 5, 4));
+  // split the eight 64 bit counters into low and high words, in lane order
+  __m256i perm = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+  c0 = _mm256_permutevar8x32_epi32(c0, perm);
+  c1 = _mm256_permutevar8x32_epi32(c1, perm);
+  x[12] = _mm256_permute2x128_si256(c0, c1, 0x20);
+  x[13] = _mm256_permute2x128_si256(c0, c1, 0x31);
+  __m256i x12 = x[12], x13 = x[13];
+
+  for (int r = 0; r < 10; r++)
+  {
+    QRV(x[0], x[4], x[8], x[12]);
+    QRV(x[1], x[5], x[9], x[13]);
+    QRV(x[2], x[6], x[10], x[14]);
+    QRV(x[3], x[7], x[11], x[15]);
+    QRV(x[0], x[5], x[10], x[15]);
+    QRV(x[1], x[6], x[11], x[12]);
+    QRV(x[2], x[7], x[8], x[13]);
+    QRV(x[3], x[4], x[9], x[14]);
+  }
+
+  for (int w = 0; w < 16; w++)
+    x[w] = ADD(x[w], w == 12 ? x12 : w == 13 ? x13 : _mm256_set1_epi32((int) in[w]));
+
+  // 8x8 transposes of words 0-7 and 8-15 give every block as two 32 byte rows
+  for (int g = 0; g < 2; g++)
+  {
+    __m256i *v = x + 8 * g;
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]), t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]), t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]), t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]), t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+    // u0 holds words 0-3 of blocks 0 and 4, u4 words 4-7 of the same blocks
+    uint8_t *o = out + 32 * g;
+    _mm256_storeu_si256((__m256i *) (o + 64 * 0), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 1), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 2), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 3), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 4), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 5), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 6), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *) (o + 64 * 7), _mm256_permute2x128_si256(u3, u7, 0x31));
+  }
+}
+
+#define QRZ(a, b, c, d)                                                                           \
+  do {                                                                                            \
+    a = _mm512_add_epi32(a, b); d = _mm512_xor_si512(d, a); d = _mm512_rol_epi32(d, 16);           \
+    c = _mm512_add_epi32(c, d); b = _mm512_xor_si512(b, c); b = _mm512_rol_epi32(b, 12);           \
+    a = _mm512_add_epi32(a, b); d = _mm512_xor_si512(d, a); d = _mm512_rol_epi32(d, 8);            \
+    c = _mm512_add_epi32(c, d); b = _mm512_xor_si512(b, c); b = _mm512_rol_epi32(b, 7);            \
+  } while (0)
+
+// sixteen blocks, one per lane of a zmm register, with native rotates
+__attribute__((target("avx512f")))
+static void chacha20_blocks_avx512(const struct chacha20 *s, uint64_t counter, uint8_t *out)
+{
+  uint32_t in[16];
+  __m512i x[16], u[16];
+  chacha20_input(in, s);
+
+  for (int w = 0; w < 16; w++)
+    x[w] = _mm512_set1_epi32((int) in[w]);
+  __m512i base = _mm512_set1_epi64((long long) counter);
+  __m512i c0 = _mm512_add_epi64(base, _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+  __m512i c1 = _mm512_add_epi64(base, _mm512_set_epi64(15, 14, 13, 12, 11, 10, 9, 8));
+  x[12] = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(c0)), _mm512_cvtepi64_epi32(c1), 1);
+  x[13] = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(_mm512_srli_epi64(c0, 32))),
+                             _mm512_cvtepi64_epi32(_mm512_srli_epi64(c1, 32)), 1);
+  __m512i x12 = x[12], x13 = x[13];
+
+  for (int r = 0; r < 10; r++)
+  {
+    QRZ(x[0], x[4], x[8], x[12]);
+    QRZ(x[1], x[5], x[9], x[13]);
+    QRZ(x[2], x[6], x[10], x[14]);
+    QRZ(x[3], x[7], x[11], x[15]);
+    QRZ(x[0], x[5], x[10], x[15]);
+    QRZ(x[1], x[6], x[11], x[12]);
+    QRZ(x[2], x[7], x[8], x[13]);
+    QRZ(x[3], x[4], x[9], x[14]);
+  }
+
+  for (int w = 0; w < 16; w++)
+    x[w] = _mm512_add_epi32(x[w], w == 12 ? x12 : w == 13 ? x13 : _mm512_set1_epi32((int) in[w]));
+
+  // 16x16 transpose: afterwards 128 bit lane L of u[4i + m] holds words
+  // 4i ... 4i+3 of block 4L + m
+  for (int i = 0; i < 4; i++)
+  {
+    __m512i t0 = _mm512_unpacklo_epi32(x[4 * i], x[4 * i + 1]);
+    __m512i t1 = _mm512_unpackhi_epi32(x[4 * i], x[4 * i + 1]);
+    __m512i t2 = _mm512_unpacklo_epi32(x[4 * i + 2], x[4 * i + 3]);
+    __m512i t3 = _mm512_unpackhi_epi32(x[4 * i + 2], x[4 * i + 3]);
+    u[4 * i] = _mm512_unpacklo_epi64(t0, t2);
+    u[4 * i + 1] = _mm512_unpackhi_epi64(t0, t2);
+    u[4 * i + 2] = _mm512_unpacklo_epi64(t1, t3);
+    u[4 * i + 3] = _mm512_unpackhi_epi64(t1, t3);
+  }
+  for (int m = 0; m < 4; m++)
+  {
+    __m512i p0 = _mm512_shuffle_i32x4(u[m], u[4 + m], 0x44);
+    __m512i p1 = _mm512_shuffle_i32x4(u[m], u[4 + m], 0xee);
+    __m512i q0 = _mm512_shuffle_i32x4(u[8 + m], u[12 + m], 0x44);
+    __m512i q1 = _mm512_shuffle_i32x4(u[8 + m], u[12 + m], 0xee);
+    _mm512_storeu_si512((void *) (out + 64 * m), _mm512_shuffle_i32x4(p0, q0, 0x88));
+    _mm512_storeu_si512((void *) (out + 64 * (4 + m)), _mm512_shuffle_i32x4(p0, q0, 0xdd));
+    _mm512_storeu_si512((void *) (out + 64 * (8 + m)), _mm512_shuffle_i32x4(p1, q1, 0x88));
+    _mm512_storeu_si512((void *) (out + 64 * (12 + m)), _mm512_shuffle_i32x4(p1, q1, 0xdd));
+  }
+}
+
+// widest kernel the CPU runs: 2 for AVX-512F, 1 for AVX2, 0 for scalar. Set
+// once under pthread_once, since streams may be drawn from several threads.
+static int level;
+static pthread_once_t level_once = PTHREAD_ONCE_INIT;
+
+static void select_level(void)
+{
+  __builtin_cpu_init();
+  level = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+// CHACHA20_LANES blocks starting at counter into out
+static void chacha20_blocks(const struct chacha20 *s, uint64_t counter, uint8_t *out)
+{
+  pthread_once(&level_once, select_level);
+  if (level == 2)
+    chacha20_blocks_avx512(s, counter, out);
+  else if (level == 1)
+  {
+    chacha20_blocks_avx2(s, counter, out);
+    chacha20_blocks_avx2(s, counter + 8, out + 512);
+  }
+  else
+    chacha20_blocks_scalar(s, counter, out);
+}
+
+// key is 32 bytes, read little endian
+void chacha20_init(struct chacha20 *s, const uint8_t *key, uint64_t nonce)
+{
+  for (int i = 0; i < 8; i++)
+    s->key[i] = (uint32_t) key[4 * i] | (uint32_t) key[4 * i + 1] << 8 |
+                (uint32_t) key[4 * i + 2] << 16 | (uint32_t) key[4 * i + 3] << 24;
+  s->nonce = nonce;
+  s->counter = 0;
+  s->pos = 0;
+  s->avail = 0;
+}
+
+// fresh key from the kernel, nonce 0
+void chacha20_seed(struct chacha20 *s)
+{
+  uint8_t key[32];
+  size_t got = 0;
+  while (got < sizeof(key))
+  {
+    ssize_t r = getrandom(key + got, sizeof(key) - got, 0);
+    if (r > 0)
+      got += (size_t) r;
+  }
+  chacha20_init(s, key, 0);
+  memset(key, 0, sizeof(key));
+}
+
+// continue the stream at byte 64 * block
+void chacha20_seek(struct chacha20 *s, uint64_t block)
+{
+  s->counter = block;
+  s->pos = 0;
+  s->avail = 0;
+}
+
+void chacha20_bytes(struct chacha20 *s, uint8_t *out, size_t len)
+{
+  size_t take = len < (size_t) s->avail ? len : (size_t) s->avail;
+  memcpy(out, s->buf + s->pos, take);
+  s->pos += (int) take;
+  s->avail -= (int) take;
+  out += take;
+  len -= take;
+
+  // whole batches go straight to the caller
+  while (len >= sizeof(s->buf))
+  {
+    chacha20_blocks(s, s->counter, out);
+    s->counter += CHACHA20_LANES;
+    out += sizeof(s->buf);
+    len -= sizeof(s->buf);
+  }
+
+  if (len > 0)
+  {
+    chacha20_blocks(s, s->counter, s->buf);
+    s->counter += CHACHA20_LANES;
+    memcpy(out, s->buf, len);
+    s->pos = (int) len;
+    s->avail = (int) (sizeof(s->buf) - len);
+  }
+}
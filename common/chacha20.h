@@ -0,0 +1,32 @@
+// ChaCha20 keystream used as a fast CSPRNG for bulk random bytes.
+//
+// This is the original 64-bit nonce, 64-bit block counter variant, so one key
+// and nonce give 2^70 bytes of stream. The stream is seekable: the bytes at
+// offset 64 * c onwards only depend on the key, the nonce and c.
+#ifndef CHACHA20_HEADER
+#define CHACHA20_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+// blocks generated per call of the inner kernel
+#define CHACHA20_LANES 16
+
+struct chacha20 {
+  uint32_t key[8];
+  uint64_t nonce;
+  uint64_t counter;                   // next block to generate
+  uint8_t buf[64 * CHACHA20_LANES];   // unread keystream
+  int pos;                            // first unread byte of buf
+  int avail;                          // bytes of buf still unread
+};
+
+void chacha20_init(struct chacha20 *, const uint8_t *, uint64_t);
+
+void chacha20_seed(struct chacha20 *);
+
+void chacha20_seek(struct chacha20 *, uint64_t);
+
+void chacha20_bytes(struct chacha20 *, uint8_t *, size_t);
+
+#endif
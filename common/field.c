@@ -0,0 +1,761 @@
+// Fixed-limb arithmetic in GF(p). Every kernel below is written once for a
+// generic limb count n and then stamped out for n = 1, 2, 3, 4, 6, 8 and 9, so
+// the compiler sees n as a constant and can unroll the limb loops.
+
+#include "field.h"
+
+typedef unsigned __int128 dlimb;
+
+#define KERNEL static inline __attribute__((always_inline))
+
+// fully unroll the limb loops of a kernel, n is never more than 9
+#define UNROLL _Pragma("GCC unroll 16")
+
+// r = 0 for n limbs
+KERNEL void zero_n(mp_limb_t *r, const int n)
+{
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    r[i] = 0;
+  }
+}
+
+// compare a and b as n limb numbers
+KERNEL int cmp_n(const mp_limb_t *a, const mp_limb_t *b, const int n)
+{
+  for (int i = n - 1; i >= 0; i--)
+  {
+    if (a[i] != b[i])
+    {
+      return a[i] > b[i] ? 1 : -1;
+    }
+  }
+  return 0;
+}
+
+// r = a - b for n limbs, returns the borrow
+KERNEL mp_limb_t sub_n(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const int n)
+{
+  mp_limb_t borrow = 0;
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    dlimb d = (dlimb)a[i] - b[i] - borrow;
+    r[i] = (mp_limb_t)d;
+    borrow = (mp_limb_t)(d >> 64) & 1;
+  }
+  return borrow;
+}
+
+// r = a + b for n limbs, returns the carry
+KERNEL mp_limb_t add_n(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const int n)
+{
+  mp_limb_t carry = 0;
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    dlimb s = (dlimb)a[i] + b[i] + carry;
+    r[i] = (mp_limb_t)s;
+    carry = (mp_limb_t)(s >> 64);
+  }
+  return carry;
+}
+
+// t[0 ... 2n] += a * b. t has 2n + 1 limbs and must not overflow them.
+KERNEL void addmul_n(mp_limb_t *t, const mp_limb_t *a, const mp_limb_t *b, const int n)
+{
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    mp_limb_t carry = 0;
+    UNROLL
+    for (int j = 0; j < n; j++)
+    {
+      dlimb prod = (dlimb)a[i] * b[j] + t[i + j] + carry;
+      t[i + j] = (mp_limb_t)prod;
+      carry = (mp_limb_t)(prod >> 64);
+    }
+    for (int k = i + n; carry != 0 && k <= 2 * n; k++)
+    {
+      dlimb s = (dlimb)t[k] + carry;
+      t[k] = (mp_limb_t)s;
+      carry = (mp_limb_t)(s >> 64);
+    }
+  }
+}
+
+// Montgomery reduction of the 2n + 1 limb t, which is destroyed. If t < c * p * R
+// then r = t / R mod p comes out after at most c subtractions of p.
+KERNEL void redc_n(mp_limb_t *r, mp_limb_t *t, const struct field *f, const int n)
+{
+  const mp_limb_t *p = f->p;
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    // choose u so that limb i of t + u * p * 2^(64i) is zero
+    mp_limb_t u = t[i] * f->pinv;
+    mp_limb_t carry = 0;
+    UNROLL
+    for (int j = 0; j < n; j++)
+    {
+      dlimb prod = (dlimb)u * p[j] + t[i + j] + carry;
+      t[i + j] = (mp_limb_t)prod;
+      carry = (mp_limb_t)(prod >> 64);
+    }
+    for (int k = i + n; carry != 0 && k <= 2 * n; k++)
+    {
+      dlimb s = (dlimb)t[k] + carry;
+      t[k] = (mp_limb_t)s;
+      carry = (mp_limb_t)(s >> 64);
+    }
+  }
+
+  // the result is the n + 1 limbs t[n ... 2n]
+  mp_limb_t *hi = t + n;
+  while (hi[n] != 0 || cmp_n(hi, p, n) >= 0)
+  {
+    hi[n] -= sub_n(hi, hi, p, n);
+  }
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    r[i] = hi[i];
+  }
+}
+
+KERNEL void mul_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f, const int n)
+{
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  zero_n(t, 2 * n + 1);
+  addmul_n(t, a, b, n);
+  redc_n(r, t, f, n);
+}
+
+KERNEL void add_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f, const int n)
+{
+  mp_limb_t carry = add_n(r, a, b, n);
+  if (carry != 0 || cmp_n(r, f->p, n) >= 0)
+  {
+    sub_n(r, r, f->p, n);
+  }
+}
+
+KERNEL void sub_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f, const int n)
+{
+  if (sub_n(r, a, b, n) != 0)
+  {
+    add_n(r, r, f->p, n);
+  }
+}
+
+// All products are summed unreduced into 2n + 1 limbs, which holds up to
+// 2^64 of them, and the sum is divided by p once.
+KERNEL void dot_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, int len, const struct field *f, const int n)
+{
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  mp_limb_t q[2 * FIELD_MAX_LIMBS + 2];
+  zero_n(t, 2 * n + 1);
+  for (int i = 0; i < len; i++)
+  {
+    addmul_n(t, a + (size_t)i * n, b + (size_t)i * n, n);
+  }
+  zero_n(r, n);
+  mpn_tdiv_qr(q, r, 0, t, 2 * n + 1, f->p, f->psize);
+}
+
+// Horner's rule with a one limb Montgomery reduction per step: every step
+// computes acc = (acc * x + c[j]) / 2^64 mod p, which keeps acc below 2p using
+// only 2n word multiplications. field_horner_coeffs stores c[j] * 2^(64(j+1))
+// so that the 2^-64 factors picked up along the way cancel out.
+KERNEL void horner_step_n(mp_limb_t *acc, const mp_limb_t *cj, mp_limb_t x, const struct field *f, const int n)
+{
+  const mp_limb_t *p = f->p;
+
+  // acc = acc * x + c[j], below (2x + 1) * 2^(64n)
+  mp_limb_t carry = 0;
+  UNROLL
+  for (int k = 0; k < n; k++)
+  {
+    dlimb prod = (dlimb)acc[k] * x + cj[k] + carry;
+    acc[k] = (mp_limb_t)prod;
+    carry = (mp_limb_t)(prod >> 64);
+  }
+  acc[n] = acc[n] * x + carry;
+
+  // acc = (acc + u * p) / 2^64 with u chosen to clear the low limb
+  mp_limb_t u = acc[0] * f->pinv;
+  carry = 0;
+  UNROLL
+  for (int k = 0; k < n; k++)
+  {
+    dlimb prod = (dlimb)u * p[k] + acc[k] + carry;
+    acc[k] = (mp_limb_t)prod;
+    carry = (mp_limb_t)(prod >> 64);
+  }
+  dlimb top = (dlimb)acc[n] + carry;
+  UNROLL
+  for (int k = 0; k < n - 1; k++)
+  {
+    acc[k] = acc[k + 1];
+  }
+  acc[n - 1] = (mp_limb_t)top;
+  acc[n] = (mp_limb_t)(top >> 64);
+}
+
+// r = acc mod p for the acc < 2p left by horner_step_n
+KERNEL void horner_final_n(mp_limb_t *r, mp_limb_t *acc, const struct field *f, const int n)
+{
+  if (acc[n] != 0 || cmp_n(acc, f->p, n) >= 0)
+  {
+    sub_n(acc, acc, f->p, n);
+  }
+  UNROLL
+  for (int k = 0; k < n; k++)
+  {
+    r[k] = acc[k];
+  }
+}
+
+KERNEL void horner_kernel(mp_limb_t *r, const mp_limb_t *c, int len, mp_limb_t x, const struct field *f, const int n)
+{
+  mp_limb_t acc[FIELD_MAX_LIMBS + 2];
+  zero_n(acc, n + 2);
+  for (int j = len - 1; j >= 0; j--)
+  {
+    horner_step_n(acc, c + (size_t)j * n, x, f, n);
+  }
+  horner_final_n(r, acc, f, n);
+}
+
+// a * y - b * x is computed as a * y + (p - b) * x < 2p^2 and reduced once
+KERNEL void combine_kernel(mp_limb_t *y, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *x, int len, const struct field *f, const int n)
+{
+  mp_limb_t nb[FIELD_MAX_LIMBS];
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  sub_n(nb, f->p, b, n);
+  for (int k = 0; k < len; k++)
+  {
+    mp_limb_t *yk = y + (size_t)k * n;
+    zero_n(t, 2 * n + 1);
+    addmul_n(t, a, yk, n);
+    addmul_n(t, nb, x + (size_t)k * n, n);
+    redc_n(yk, t, f, n);
+  }
+}
+
+// Special form primes p = 2^bits - d with a short d, where p fills its n
+// limbs. Since 2^(64n) = F mod p for the fold constant F = d * 2^(64n - bits),
+// a number is reduced by replacing its limbs above n with their product by F,
+// which costs about n * foldn word multiplications instead of the n^2 of a
+// Montgomery reduction, and finally folding the bits above bit `bits` with d
+// the same way. All elements stay plain residues, i.e. R = 1 and "Montgomery
+// form" is the identity.
+
+// x[0 ... n-1] = x[0 ... n + FIELD_SPECIAL_LIMBS + 1] mod p + k p for a small
+// k, folding the limbs above n back in until there are none left
+KERNEL void fold_top_n(mp_limb_t *x, const struct field *f, const int n)
+{
+  const int hn = f->foldn + 2;
+  mp_limb_t any = 0;
+  for (int i = 0; i < hn; i++)
+  {
+    any |= x[n + i];
+  }
+  while (any != 0)
+  {
+    mp_limb_t hi[FIELD_SPECIAL_LIMBS + 2];
+    for (int i = 0; i < hn; i++)
+    {
+      hi[i] = x[n + i];
+      x[n + i] = 0;
+    }
+    for (int j = 0; j < f->foldn; j++)
+    {
+      mp_limb_t carry = 0;
+      int i = 0;
+      for (; i < hn; i++)
+      {
+        dlimb prod = (dlimb)hi[i] * f->fold[j] + x[i + j] + carry;
+        x[i + j] = (mp_limb_t)prod;
+        carry = (mp_limb_t)(prod >> 64);
+      }
+      for (i += j; carry != 0; i++)
+      {
+        dlimb sum = (dlimb)x[i] + carry;
+        x[i] = (mp_limb_t)sum;
+        carry = (mp_limb_t)(sum >> 64);
+      }
+    }
+    any = 0;
+    for (int i = 0; i < hn; i++)
+    {
+      any |= x[n + i];
+    }
+  }
+}
+
+// r = x mod p for x < 2^(64n), x is destroyed
+KERNEL void fold_bits_n(mp_limb_t *r, mp_limb_t *x, const struct field *f, const int n)
+{
+  // the bits from `bits` up are all in the top limb, x = x mod 2^bits + h * d
+  const int kb = f->bits - 64 * (n - 1);
+  if (kb < 64)
+  {
+    mp_limb_t h;
+    while ((h = x[n - 1] >> kb) != 0)
+    {
+      x[n - 1] &= ((mp_limb_t)1 << kb) - 1;
+      mp_limb_t carry = 0;
+      int i = 0;
+      for (; i < f->dn; i++)
+      {
+        dlimb prod = (dlimb)h * f->d[i] + x[i] + carry;
+        x[i] = (mp_limb_t)prod;
+        carry = (mp_limb_t)(prod >> 64);
+      }
+      for (; carry != 0; i++)
+      {
+        dlimb sum = (dlimb)x[i] + carry;
+        x[i] = (mp_limb_t)sum;
+        carry = (mp_limb_t)(sum >> 64);
+      }
+    }
+  }
+
+  // x < 2^bits = p + d, so one subtraction is enough
+  if (cmp_n(x, f->p, n) >= 0)
+  {
+    sub_n(x, x, f->p, n);
+  }
+  UNROLL
+  for (int i = 0; i < n; i++)
+  {
+    r[i] = x[i];
+  }
+}
+
+// r = t mod p for the 2n + 1 limb t
+KERNEL void fold_n(mp_limb_t *r, const mp_limb_t *t, const struct field *f, const int n)
+{
+  mp_limb_t x[FIELD_MAX_LIMBS + FIELD_SPECIAL_LIMBS + 2];
+
+  if (f->foldn == 1)
+  {
+    // pseudo-Mersenne primes: x = t[0 ... n-1] + t[n ... 2n-1] * F, plus
+    // top * F for the two limbs top that spill over
+    const mp_limb_t F = f->fold[0];
+    mp_limb_t carry = 0;
+    UNROLL
+    for (int i = 0; i < n; i++)
+    {
+      dlimb prod = (dlimb)t[n + i] * F + t[i] + carry;
+      x[i] = (mp_limb_t)prod;
+      carry = (mp_limb_t)(prod >> 64);
+    }
+    for (int i = n; i < n + FIELD_SPECIAL_LIMBS + 2; i++)
+    {
+      x[i] = 0;
+    }
+    dlimb top = (dlimb)t[2 * n] * F + carry;
+    dlimb lo = (dlimb)(mp_limb_t)top * F;
+    dlimb hi = (dlimb)(mp_limb_t)(top >> 64) * F + (mp_limb_t)(lo >> 64);
+    mp_limb_t v[3] = {(mp_limb_t)lo, (mp_limb_t)hi, (mp_limb_t)(hi >> 64)};
+    carry = 0;
+    int i = 0;
+    for (; i < 3; i++)
+    {
+      dlimb sum = (dlimb)x[i] + v[i] + carry;
+      x[i] = (mp_limb_t)sum;
+      carry = (mp_limb_t)(sum >> 64);
+    }
+    for (; carry != 0; i++)
+    {
+      dlimb sum = (dlimb)x[i] + carry;
+      x[i] = (mp_limb_t)sum;
+      carry = (mp_limb_t)(sum >> 64);
+    }
+  }
+  else
+  {
+    // x = t[0 ... n-1] + t[n ... 2n] * F
+    UNROLL
+    for (int i = 0; i < n; i++)
+    {
+      x[i] = t[i];
+    }
+    for (int i = n; i < n + FIELD_SPECIAL_LIMBS + 2; i++)
+    {
+      x[i] = 0;
+    }
+    for (int j = 0; j < f->foldn; j++)
+    {
+      mp_limb_t carry = 0;
+      UNROLL
+      for (int i = 0; i <= n; i++)
+      {
+        dlimb prod = (dlimb)t[n + i] * f->fold[j] + x[i + j] + carry;
+        x[i + j] = (mp_limb_t)prod;
+        carry = (mp_limb_t)(prod >> 64);
+      }
+      x[n + 1 + j] = carry;
+    }
+  }
+
+  fold_top_n(x, f, n);
+  fold_bits_n(r, x, f, n);
+}
+
+KERNEL void smul_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f, const int n)
+{
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  zero_n(t, 2 * n + 1);
+  addmul_n(t, a, b, n);
+  fold_n(r, t, f, n);
+}
+
+KERNEL void sdot_kernel(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, int len, const struct field *f, const int n)
+{
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  zero_n(t, 2 * n + 1);
+  for (int i = 0; i < len; i++)
+  {
+    addmul_n(t, a + (size_t)i * n, b + (size_t)i * n, n);
+  }
+  fold_n(r, t, f, n);
+}
+
+// Plain Horner's rule, acc = acc * x + c[j], with the limb that spills past
+// n folded back every step. acc stays below 2^(64n), so the spill is at most x
+// and folding it almost never spills again. acc needs n + FIELD_SPECIAL_LIMBS
+// + 2 limbs, zero above n.
+KERNEL void shorner_step_n(mp_limb_t *acc, const mp_limb_t *cj, mp_limb_t x, const struct field *f, const int n)
+{
+  mp_limb_t carry = 0;
+  UNROLL
+  for (int k = 0; k < n; k++)
+  {
+    dlimb prod = (dlimb)acc[k] * x + cj[k] + carry;
+    acc[k] = (mp_limb_t)prod;
+    carry = (mp_limb_t)(prod >> 64);
+  }
+  acc[n] = carry;
+
+  // acc = acc mod 2^(64n) + acc[n] * F, carried through all n limbs
+  // without branching, which leaves a spill of 0 or 1 for the next step
+  mp_limb_t h = acc[n];
+  carry = 0;
+  for (int k = 0; k < f->foldn; k++)
+  {
+    dlimb prod = (dlimb)h * f->fold[k] + acc[k] + carry;
+    acc[k] = (mp_limb_t)prod;
+    carry = (mp_limb_t)(prod >> 64);
+  }
+  for (int k = f->foldn; k < n; k++)
+  {
+    dlimb sum = (dlimb)acc[k] + carry;
+    acc[k] = (mp_limb_t)sum;
+    carry = (mp_limb_t)(sum >> 64);
+  }
+  acc[n] = carry;
+  if (carry != 0)
+  {
+    fold_top_n(acc, f, n);
+  }
+}
+
+KERNEL void shorner_kernel(mp_limb_t *r, const mp_limb_t *c, int len, mp_limb_t x, const struct field *f, const int n)
+{
+  mp_limb_t acc[FIELD_MAX_LIMBS + FIELD_SPECIAL_LIMBS + 2];
+  zero_n(acc, n + FIELD_SPECIAL_LIMBS + 2);
+  for (int j = len - 1; j >= 0; j--)
+  {
+    shorner_step_n(acc, c + (size_t)j * n, x, f, n);
+  }
+  fold_bits_n(r, acc, f, n);
+}
+
+// Horner's rule for count polynomials at once, with c[j] of polynomial s in
+// slot j * stride + s. The polynomials are walked FIELD_BATCH at a time, one
+// step of each in turn, so the multiply chains of independent polynomials
+// overlap instead of each step waiting on the carries of the one before.
+KERNEL void horner_batch_kernel(mp_limb_t *r, const mp_limb_t *c, int len, int count, int stride, mp_limb_t x,
+                                const struct field *f, const int n, const int special)
+{
+  mp_limb_t acc[FIELD_BATCH][FIELD_MAX_LIMBS + FIELD_SPECIAL_LIMBS + 2];
+  for (int s0 = 0; s0 < count; s0 += FIELD_BATCH)
+  {
+    int b = count - s0 < FIELD_BATCH ? count - s0 : FIELD_BATCH;
+    for (int q = 0; q < b; q++)
+    {
+      zero_n(acc[q], n + FIELD_SPECIAL_LIMBS + 2);
+    }
+    for (int j = len - 1; j >= 0; j--)
+    {
+      const mp_limb_t *cj = c + ((size_t)j * stride + s0) * n;
+      for (int q = 0; q < b; q++)
+      {
+        if (special)
+        {
+          shorner_step_n(acc[q], cj + (size_t)q * n, x, f, n);
+        }
+        else
+        {
+          horner_step_n(acc[q], cj + (size_t)q * n, x, f, n);
+        }
+      }
+    }
+    for (int q = 0; q < b; q++)
+    {
+      if (special)
+      {
+        fold_bits_n(r + (size_t)(s0 + q) * n, acc[q], f, n);
+      }
+      else
+      {
+        horner_final_n(r + (size_t)(s0 + q) * n, acc[q], f, n);
+      }
+    }
+  }
+}
+
+KERNEL void scombine_kernel(mp_limb_t *y, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *x, int len, const struct field *f, const int n)
+{
+  mp_limb_t nb[FIELD_MAX_LIMBS];
+  mp_limb_t t[2 * FIELD_MAX_LIMBS + 1];
+  sub_n(nb, f->p, b, n);
+  for (int k = 0; k < len; k++)
+  {
+    mp_limb_t *yk = y + (size_t)k * n;
+    zero_n(t, 2 * n + 1);
+    addmul_n(t, a, yk, n);
+    addmul_n(t, nb, x + (size_t)k * n, n);
+    fold_n(yk, t, f, n);
+  }
+}
+
+#define FIELD_INSTANCE(N)                                                                                             \
+  static void mul_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f)                    \
+  {                                                                                                                   \
+    mul_kernel(r, a, b, f, N);                                                                                        \
+  }                                                                                                                   \
+  static void add_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f)                    \
+  {                                                                                                                   \
+    add_kernel(r, a, b, f, N);                                                                                        \
+  }                                                                                                                   \
+  static void sub_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f)                    \
+  {                                                                                                                   \
+    sub_kernel(r, a, b, f, N);                                                                                        \
+  }                                                                                                                   \
+  static void dot_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, int len, const struct field *f)           \
+  {                                                                                                                   \
+    dot_kernel(r, a, b, len, f, N);                                                                                   \
+  }                                                                                                                   \
+  static void horner_##N(mp_limb_t *r, const mp_limb_t *c, int len, mp_limb_t x, const struct field *f)               \
+  {                                                                                                                   \
+    horner_kernel(r, c, len, x, f, N);                                                                                \
+  }                                                                                                                   \
+  static void combine_##N(mp_limb_t *y, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *x, int len,          \
+                          const struct field *f)                                                                      \
+  {                                                                                                                   \
+    combine_kernel(y, a, b, x, len, f, N);                                                                            \
+  }                                                                                                                   \
+  static void horner_batch_##N(mp_limb_t *r, const mp_limb_t *c, int len, int count, int stride, mp_limb_t x,         \
+                               const struct field *f)                                                                 \
+  {                                                                                                                   \
+    horner_batch_kernel(r, c, len, count, stride, x, f, N, 0);                                                        \
+  }                                                                                                                   \
+  static const struct field_ops ops_##N = {mul_##N, add_##N, sub_##N, dot_##N, horner_##N, combine_##N,               \
+                                           horner_batch_##N};                                                         \
+  static void smul_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, const struct field *f)                   \
+  {                                                                                                                   \
+    smul_kernel(r, a, b, f, N);                                                                                       \
+  }                                                                                                                   \
+  static void sdot_##N(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b, int len, const struct field *f)          \
+  {                                                                                                                   \
+    sdot_kernel(r, a, b, len, f, N);                                                                                  \
+  }                                                                                                                   \
+  static void shorner_##N(mp_limb_t *r, const mp_limb_t *c, int len, mp_limb_t x, const struct field *f)              \
+  {                                                                                                                   \
+    shorner_kernel(r, c, len, x, f, N);                                                                               \
+  }                                                                                                                   \
+  static void scombine_##N(mp_limb_t *y, const mp_limb_t *a, const mp_limb_t *b, const mp_limb_t *x, int len,         \
+                           const struct field *f)                                                                     \
+  {                                                                                                                   \
+    scombine_kernel(y, a, b, x, len, f, N);                                                                           \
+  }                                                                                                                   \
+  static void shorner_batch_##N(mp_limb_t *r, const mp_limb_t *c, int len, int count, int stride, mp_limb_t x,        \
+                                const struct field *f)                                                                \
+  {                                                                                                                   \
+    horner_batch_kernel(r, c, len, count, stride, x, f, N, 1);                                                        \
+  }                                                                                                                   \
+  static const struct field_ops special_ops_##N = {smul_##N, add_##N, sub_##N, sdot_##N, shorner_##N, scombine_##N,   \
+                                                   shorner_batch_##N};
+
+FIELD_INSTANCE(1)
+FIELD_INSTANCE(2)
+FIELD_INSTANCE(3)
+FIELD_INSTANCE(4)
+FIELD_INSTANCE(6)
+FIELD_INSTANCE(8)
+FIELD_INSTANCE(9)
+
+// instantiation used for a modulus of i limbs
+static const struct field_ops *const ops_for_size[FIELD_MAX_LIMBS + 1] = {
+    NULL, &ops_1, &ops_2, &ops_3, &ops_4, &ops_6, &ops_6, &ops_8, &ops_8, &ops_9};
+static const struct field_ops *const special_ops_for_size[FIELD_MAX_LIMBS + 1] = {
+    NULL, &special_ops_1, &special_ops_2, &special_ops_3, &special_ops_4, &special_ops_6,
+    &special_ops_6, &special_ops_8, &special_ops_8, &special_ops_9};
+static const int limbs_for_size[FIELD_MAX_LIMBS + 1] = {0, 1, 2, 3, 4, 6, 6, 8, 8, 9};
+
+// Checks whether p = 2^bits - d fills its limbs and has d and the fold
+// constant d * 2^(64 limbs - bits) short enough for the folding kernels, and
+// fills them in if so.
+static int special_form(struct field *f, const mpz_t p)
+{
+  mpz_t d, fold;
+  mpz_init(d);
+  mpz_init(fold);
+  f->bits = (int)mpz_sizeinbase(p, 2);
+  mpz_setbit(d, (mp_bitcnt_t)f->bits);
+  mpz_sub(d, d, p);
+  mpz_mul_2exp(fold, d, (mp_bitcnt_t)(64 * f->psize - f->bits));
+
+  // every fold must drop at least 32 bits for the loops in fold_n to be short
+  int ok = f->limbs == f->psize && mpz_size(d) <= FIELD_SPECIAL_LIMBS && mpz_size(fold) <= FIELD_SPECIAL_LIMBS &&
+           (int)mpz_sizeinbase(fold, 2) <= 64 * f->psize - 32;
+  if (ok)
+  {
+    f->dn = (int)mpz_size(d);
+    f->foldn = (int)mpz_size(fold);
+    memset(f->d, 0, sizeof(f->d));
+    memset(f->fold, 0, sizeof(f->fold));
+    memcpy(f->d, mpz_limbs_read(d), f->dn * sizeof(mp_limb_t));
+    memcpy(f->fold, mpz_limbs_read(fold), f->foldn * sizeof(mp_limb_t));
+  }
+  mpz_clear(d);
+  mpz_clear(fold);
+  return ok;
+}
+
+// Set up f for arithmetic mod p. Returns 0 when p is even or longer than
+// FIELD_MAX_LIMBS limbs, in which case the caller has to stay on mpz_t.
+int field_init(struct field *f, const mpz_t p)
+{
+  int size = (int)mpz_size(p);
+  if (mpz_sgn(p) <= 0 || size > FIELD_MAX_LIMBS || mpz_even_p(p))
+  {
+    return 0;
+  }
+
+  f->limbs = limbs_for_size[size];
+  f->psize = size;
+  f->ops = ops_for_size[size];
+  memset(f->p, 0, sizeof(f->p));
+  memcpy(f->p, mpz_limbs_read(p), size * sizeof(mp_limb_t));
+
+  // special form primes are reduced by folding and use R = 1
+  f->special = special_form(f, p);
+  if (f->special)
+  {
+    f->ops = special_ops_for_size[size];
+    f->pinv = 0;
+    memset(f->one, 0, sizeof(f->one));
+    memset(f->r2, 0, sizeof(f->r2));
+    f->one[0] = 1;
+    f->r2[0] = 1;
+    return 1;
+  }
+
+  // p^-1 mod 2^64 by Newton iteration, every step doubles the correct bits
+  mp_limb_t inv = f->p[0]; // correct to 3 bits for odd p
+  for (int i = 0; i < 5; i++)
+  {
+    inv *= 2 - f->p[0] * inv;
+  }
+  f->pinv = -inv;
+
+  // one = R mod p, r2 = R^2 mod p
+  mpz_t tmp;
+  mpz_init(tmp);
+  mpz_setbit(tmp, (mp_bitcnt_t)64 * f->limbs);
+  mpz_mod(tmp, tmp, p);
+  field_import(f->one, tmp, f);
+  mpz_set_ui(tmp, (unsigned long int)0);
+  mpz_setbit(tmp, (mp_bitcnt_t)128 * f->limbs);
+  mpz_mod(tmp, tmp, p);
+  field_import(f->r2, tmp, f);
+  mpz_clear(tmp);
+
+  return 1;
+}
+
+// r = a for 0 <= a < p
+void field_import(mp_limb_t *r, const mpz_t a, const struct field *f)
+{
+  size_t size = mpz_size(a);
+  memcpy(r, mpz_limbs_read(a), size * sizeof(mp_limb_t));
+  memset(r + size, 0, (f->limbs - size) * sizeof(mp_limb_t));
+}
+
+void field_export(mpz_t r, const mp_limb_t *a, const struct field *f)
+{
+  mp_limb_t *w = mpz_limbs_write(r, f->limbs);
+  memcpy(w, a, f->limbs * sizeof(mp_limb_t));
+  mpz_limbs_finish(r, f->limbs);
+}
+
+// r = a * R mod p
+void field_to_mont(mp_limb_t *r, const mp_limb_t *a, const struct field *f)
+{
+  f->ops->mul(r, a, f->r2, f);
+}
+
+// r = a / R mod p
+void field_from_mont(mp_limb_t *r, const mp_limb_t *a, const struct field *f)
+{
+  mp_limb_t one[FIELD_MAX_LIMBS] = {1};
+  f->ops->mul(r, a, one, f);
+}
+
+// Lay out the coefficients c[0 ... len-1] for the horner kernel, which wants
+// c[j] * 2^(64(j+1)) mod p in slot j, or just c[j] for a special form p.
+void field_horner_coeffs(mp_limb_t *out, const mpz_t *c, int len, const struct field *f)
+{
+  if (f->special)
+  {
+    for (int j = 0; j < len; j++)
+    {
+      field_import(out + (size_t)j * f->limbs, c[j], f);
+    }
+    return;
+  }
+
+  mpz_t p, scale, tmp;
+  mpz_roinit_n(p, f->p, f->psize);
+  mpz_init_set_ui(scale, (unsigned long int)1);
+  mpz_init(tmp);
+  for (int j = 0; j < len; j++)
+  {
+    mpz_mul_2exp(scale, scale, 64);
+    mpz_mod(scale, scale, p);
+    mpz_mul(tmp, c[j], scale);
+    mpz_mod(tmp, tmp, p);
+    field_import(out + (size_t)j * f->limbs, tmp, f);
+  }
+  mpz_clear(scale);
+  mpz_clear(tmp);
+}
+
+// r = x mod m on raw limbs, for moduli that vary from call to call. r gets mn
+// limbs, m[mn-1] must be nonzero and scratch needs xn - mn + 1 limbs.
+void field_mod(mp_limb_t *r, const mp_limb_t *x, mp_size_t xn, const mp_limb_t *m, mp_size_t mn, mp_limb_t *scratch)
+{
+  if (xn < mn)
+  {
+    memcpy(r, x, xn * sizeof(mp_limb_t));
+    memset(r + xn, 0, (mn - xn) * sizeof(mp_limb_t));
+    return;
+  }
+  mpn_tdiv_qr(scratch, r, 0, x, xn, m, mn);
+}
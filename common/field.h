@@ -0,0 +1,91 @@
+// Fixed-limb arithmetic in GF(p) for p of at most FIELD_MAX_LIMBS limbs.
+//
+// Elements are arrays of f->limbs limbs, zero padded. The kernels are
+// instantiated once per limb count (1, 2, 3, 4, 6, 8 and 9 limbs), so every loop
+// in them runs over a compile-time constant and works on stack arrays, with no
+// allocation and no size normalization. field_init picks the smallest
+// instantiation that holds p.
+//
+// Unless noted, elements are plain residues in [0, p). The Montgomery
+// functions (field_mul, field_combine) take and return elements in
+// Montgomery form a * R mod p, where R = 2^(64 * limbs).
+//
+// Special form primes p = 2^bits - d with a short d (2^127 - 1, 2^255 - 19,
+// P-192, the table primes of primes.c, ...) get kernels that reduce by
+// shifting and adding multiples of d instead of Montgomery reduction. For them
+// R = 1, so the Montgomery conversions are the identity and callers do not
+// need to tell the two apart.
+#ifndef FIELD_HEADER
+#define FIELD_HEADER
+
+#include <gmp.h>
+#include <string.h>
+
+#if GMP_NUMB_BITS != 64
+#error "the field kernels need 64 bit GMP limbs without nails"
+#endif
+
+#define FIELD_MAX_LIMBS 9
+
+// longest d, in limbs, for p = 2^bits - d to count as special form
+#define FIELD_SPECIAL_LIMBS 3
+
+// polynomials interleaved by the horner_batch kernel
+#define FIELD_BATCH 8
+
+struct field;
+
+struct field_ops {
+  // r = a * b / R mod p, Montgomery form in and out
+  void (*mul)(mp_limb_t *, const mp_limb_t *, const mp_limb_t *, const struct field *);
+  // r = a + b mod p
+  void (*add)(mp_limb_t *, const mp_limb_t *, const mp_limb_t *, const struct field *);
+  // r = a - b mod p
+  void (*sub)(mp_limb_t *, const mp_limb_t *, const mp_limb_t *, const struct field *);
+  // r = a[0] * b[0] + ... + a[len-1] * b[len-1] mod p, plain residues in and
+  // out, reduced only once at the end
+  void (*dot)(mp_limb_t *, const mp_limb_t *, const mp_limb_t *, int, const struct field *);
+  // r = c[0] + c[1] * x + ... + c[len-1] * x^(len-1) mod p for a small x, with
+  // c prepared by field_horner_coeffs
+  void (*horner)(mp_limb_t *, const mp_limb_t *, int, mp_limb_t, const struct field *);
+  // y[k] = a * y[k] - b * x[k] mod p for 0 <= k < len, Montgomery form
+  void (*combine)(mp_limb_t *, const mp_limb_t *, const mp_limb_t *, const mp_limb_t *, int, const struct field *);
+  // horner for count polynomials of len coefficients at the same x, with
+  // coefficient j of polynomial s in slot j * stride + s and its value in r[s]
+  void (*horner_batch)(mp_limb_t *, const mp_limb_t *, int, int, int, mp_limb_t, const struct field *);
+};
+
+struct field {
+  int limbs;                      // limbs per element
+  int psize;                      // limbs in p without the zero padding
+  mp_limb_t p[FIELD_MAX_LIMBS];   // the modulus
+  mp_limb_t pinv;                 // -p^-1 mod 2^64
+  mp_limb_t one[FIELD_MAX_LIMBS]; // R mod p, i.e. 1 in Montgomery form
+  mp_limb_t r2[FIELD_MAX_LIMBS];  // R^2 mod p
+
+  // p = 2^bits - d, folded with 2^(64 psize) = fold mod p; special is 0 when
+  // p does not have that form and the Montgomery kernels are used
+  int special;
+  int bits;
+  int dn;
+  int foldn;
+  mp_limb_t d[FIELD_SPECIAL_LIMBS];
+  mp_limb_t fold[FIELD_SPECIAL_LIMBS];
+  const struct field_ops *ops;
+};
+
+int field_init(struct field *, const mpz_t);
+
+void field_import(mp_limb_t *, const mpz_t, const struct field *);
+
+void field_export(mpz_t, const mp_limb_t *, const struct field *);
+
+void field_to_mont(mp_limb_t *, const mp_limb_t *, const struct field *);
+
+void field_from_mont(mp_limb_t *, const mp_limb_t *, const struct field *);
+
+void field_horner_coeffs(mp_limb_t *, const mpz_t *, int, const struct field *);
+
+void field_mod(mp_limb_t *, const mp_limb_t *, mp_size_t, const mp_limb_t *, mp_size_t, mp_limb_t *);
+
+#endif
@@ -0,0 +1,277 @@
+#include "primes.h"
+#include <stdlib.h>
+#include <sys/random.h>
+
+// The largest prime below 2^lambda is 2^lambda - prime_offsets[lambda - 64].
+// Each entry was found by stepping down from 2^lambda - 1 and is the first
+// value that passes mpz_probab_prime_p with 64 rounds, which runs BPSW first.
+static const unsigned short prime_offsets[PRIME_TABLE_MAX - PRIME_TABLE_MIN + 1] = {
+  59, 49, 5, 19, 23, 19, 35, 231, 93, 69, 35, 97,
+  15, 33, 11, 67, 65, 51, 57, 55, 35, 19, 35, 67,
+  299, 1, 33, 45, 83, 25, 3, 15, 17, 141, 51, 115,
+  15, 69, 33, 97, 17, 13, 117, 1, 59, 31, 21, 37,
+  75, 133, 11, 67, 3, 279, 5, 69, 119, 73, 3, 67,
+  59, 9, 137, 1, 159, 25, 5, 69, 347, 99, 45, 45,
+  113, 13, 105, 187, 27, 9, 111, 69, 83, 151, 153, 145,
+  167, 31, 3, 195, 17, 69, 243, 31, 143, 19, 15, 91,
+  47, 159, 101, 55, 63, 25, 5, 135, 257, 643, 143, 19,
+  95, 55, 3, 229, 233, 339, 41, 49, 47, 165, 161, 147,
+  33, 303, 371, 85, 125, 25, 11, 19, 237, 31, 33, 135,
+  15, 75, 17, 49, 75, 55, 183, 159, 167, 81, 5, 91,
+  299, 33, 47, 175, 23, 3, 185, 157, 377, 61, 33, 121,
+  77, 3, 117, 235, 63, 49, 5, 405, 93, 91, 27, 165,
+  567, 3, 83, 15, 209, 181, 161, 87, 467, 39, 63, 9,
+  189, 163, 107, 81, 237, 75, 207, 9, 129, 273, 245, 19,
+  189, 93, 87, 361, 149, 223, 71, 747, 275, 49, 3, 265,
+  77, 241, 53, 169, 237, 205, 305, 129, 89, 103, 93, 69,
+  47, 139, 83, 45, 173, 9, 165, 115, 167, 493, 47, 19,
+  167, 601, 35, 171, 285, 123, 341, 69, 153, 265, 267, 121,
+  75, 103, 503, 99, 159, 493, 77, 45, 203, 139, 113, 465,
+  57, 33, 165, 795, 197, 9, 11, 141, 23, 399, 101, 595,
+  155, 139, 255, 61, 707, 483, 243, 321, 3, 75, 15, 147,
+  293, 229, 65, 199, 119, 475, 45, 211, 117, 285, 113, 61,
+  657, 139, 153, 49, 173, 243, 671, 411, 719, 369, 605, 75,
+  923, 169, 167, 487, 315, 25, 495, 741, 177, 333, 65, 679,
+  57, 259, 417, 19, 65, 313, 105, 31, 317, 265, 231, 615,
+  45, 21, 137, 105, 107, 93, 377, 531, 605, 81, 131, 91,
+  593, 31, 53, 379, 257, 235, 923, 157, 1005, 103, 51, 205,
+  183, 21, 17, 45, 435, 1029, 147, 69, 317, 271, 101, 91,
+  389, 301, 321, 781, 65, 55, 677, 201, 299, 601, 183, 97,
+  87, 93, 417, 151, 33, 361, 995, 685, 17, 195, 77, 325,
+  203, 241, 501, 2239, 3, 285, 57, 217, 627, 273, 57, 549,
+  77, 649, 195, 157, 437, 819, 813, 511, 17, 283, 35, 147,
+  209, 579, 135, 129, 153, 123, 95, 537, 47, 273, 275, 301,
+  39, 1399, 143, 57, 17, 21, 917, 75, 129, 433, 125, 31,
+  257, 1291, 563, 151, 863, 45, 671, 91, 503, 91, 45, 265,
+  243, 741, 75, 187, 569, 445
+};
+
+// p = the largest prime below 2^lambda, PRIME_TABLE_MIN <= lambda <= PRIME_TABLE_MAX
+void table_prime(mpz_t p, int lambda)
+{
+  mpz_set_ui(p, 0);
+  mpz_setbit(p, (mp_bitcnt_t)lambda);
+  mpz_sub_ui(p, p, prime_offsets[lambda - PRIME_TABLE_MIN]);
+}
+
+// The special form primes, smallest first. P-256 is left out on purpose: its
+// 2^256 - p is about 2^224, too long for the folding reduction to pay off.
+static const struct {
+  int bits;
+  const char *hex;
+} special_primes[] = {
+    {89, "1ffffffffffffffffffffff"},                                                                     // 2^89 - 1
+    {127, "7fffffffffffffffffffffffffffffff"},                                                           // 2^127 - 1
+    {192, "fffffffffffffffffffffffffffffffeffffffffffffffff"},                                           // P-192
+    {255, "7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffed"},                           // 2^255 - 19
+    {384, "fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff"}, // P-384
+    {521, NULL},                                                                                         // 2^521 - 1
+};
+
+#define SPECIAL_PRIMES ((int)(sizeof(special_primes) / sizeof(special_primes[0])))
+
+static void special_prime_at(mpz_t p, int i)
+{
+  if (special_primes[i].hex == NULL)
+  {
+    mpz_set_ui(p, 0);
+    mpz_setbit(p, (mp_bitcnt_t)special_primes[i].bits);
+    mpz_sub_ui(p, p, 1);
+    return;
+  }
+  mpz_set_str(p, special_primes[i].hex, 16);
+}
+
+static int special_index(int lambda)
+{
+  int i = 0;
+  while (i < SPECIAL_PRIMES - 1 && special_primes[i].bits < lambda)
+  {
+    i++;
+  }
+  return i;
+}
+
+// p = the smallest special form prime of at least lambda bits, lambda <= 521
+void special_prime(mpz_t p, int lambda)
+{
+  special_prime_at(p, special_index(lambda));
+}
+
+// Sets p and returns 1 if the provider's source gives a prime that only
+// depends on lambda, so that a secret can be drawn below it in advance.
+int fixed_prime(mpz_t p, const struct prime_provider *provider, int lambda)
+{
+  switch (provider->source)
+  {
+  case PRIME_TABLE:
+    table_prime(p, lambda);
+    return 1;
+  case PRIME_SPECIAL:
+    special_prime(p, lambda);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// p = a random prime with bound < p, close to 2^lambda, that passes lambda/2
+// Miller-Rabin rounds
+void random_prime(mpz_t p, int lambda, const mpz_t bound, gmp_randstate_t state)
+{
+  mpz_urandomb(p, state, lambda);
+  while (mpz_cmp(p, bound) <= 0)
+  {
+    mpz_urandomb(p, state, lambda);
+  }
+  mpz_nextprime(p, p);
+
+  // make sure p is prime with err prob 1/2^lambda
+  while (mpz_probab_prime_p(p, lambda / 2) == 0)
+  {
+    mpz_nextprime(p, p);
+  }
+}
+
+static void *refill_prime_cache(void *arg)
+{
+  struct prime_cache *cache = (struct prime_cache *)arg;
+  gmp_randstate_t state;
+  unsigned long int seed;
+  mpz_t p, floor;
+
+  getrandom(&seed, sizeof(unsigned long int), 0);
+  gmp_randinit_default(state);
+  gmp_randseed_ui(state, seed);
+  mpz_init(p);
+
+  // full length primes, so a cached prime is above a random lambda bit secret
+  // at least half of the time
+  mpz_init(floor);
+  mpz_setbit(floor, (mp_bitcnt_t)(cache->lambda - 1));
+
+  pthread_mutex_lock(&cache->lock);
+  while (cache->running)
+  {
+    if (cache->count == cache->capacity)
+    {
+      pthread_cond_wait(&cache->space, &cache->lock);
+      continue;
+    }
+
+    // the expensive part runs without the lock
+    pthread_mutex_unlock(&cache->lock);
+    random_prime(p, cache->lambda, floor, state);
+    pthread_mutex_lock(&cache->lock);
+
+    if (cache->count < cache->capacity)
+    {
+      mpz_swap(cache->pool[cache->count], p);
+      cache->count++;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  mpz_clears(p, floor, NULL);
+  gmp_randclear(state);
+  return NULL;
+}
+
+// starts a thread that keeps capacity random lambda bit primes ready
+struct prime_cache *start_prime_cache(int lambda, int capacity)
+{
+  struct prime_cache *cache = (struct prime_cache *)malloc(sizeof(struct prime_cache));
+  cache->lambda = lambda;
+  cache->capacity = capacity;
+  cache->count = 0;
+  cache->pool = (mpz_t *)malloc(capacity * sizeof(mpz_t));
+  for (int i = 0; i < capacity; i++)
+  {
+    mpz_init(cache->pool[i]);
+  }
+
+  cache->running = 1;
+  pthread_mutex_init(&cache->lock, NULL);
+  pthread_cond_init(&cache->space, NULL);
+  pthread_create(&cache->thread, NULL, refill_prime_cache, cache);
+  return cache;
+}
+
+void stop_prime_cache(struct prime_cache *cache)
+{
+  pthread_mutex_lock(&cache->lock);
+  cache->running = 0;
+  pthread_cond_signal(&cache->space);
+  pthread_mutex_unlock(&cache->lock);
+  pthread_join(cache->thread, NULL);
+
+  pthread_cond_destroy(&cache->space);
+  pthread_mutex_destroy(&cache->lock);
+  for (int i = 0; i < cache->capacity; i++)
+  {
+    mpz_clear(cache->pool[i]);
+  }
+  free(cache->pool);
+  free(cache);
+}
+
+// Takes a cached prime above bound into p and returns 1, or returns 0 if the
+// pool has none right now. Primes that are not above bound stay in the pool.
+int take_cached_prime(mpz_t p, struct prime_cache *cache, const mpz_t bound)
+{
+  int found = 0;
+  pthread_mutex_lock(&cache->lock);
+  for (int i = 0; i < cache->count; i++)
+  {
+    if (mpz_cmp(cache->pool[i], bound) > 0)
+    {
+      mpz_swap(p, cache->pool[i]);
+      cache->count--;
+      mpz_swap(cache->pool[i], cache->pool[cache->count]);
+      pthread_cond_signal(&cache->space);
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return found;
+}
+
+// p = a lambda bit prime above bound (a secret below 2^lambda) from the
+// provider's source. The table falls back to the lambda+1 bit prime in the
+// rare case bound is not below the lambda bit one, the special primes to the
+// next larger one, and the cache to generating a prime on the spot when it has
+// none that fits.
+void provide_prime(mpz_t p, const struct prime_provider *provider, int lambda, const mpz_t bound, gmp_randstate_t state)
+{
+  switch (provider->source)
+  {
+  case PRIME_TABLE:
+    table_prime(p, lambda);
+    if (mpz_cmp(p, bound) <= 0)
+    {
+      table_prime(p, lambda + 1);
+    }
+    return;
+  case PRIME_SPECIAL:
+  {
+    int i = special_index(lambda);
+    special_prime_at(p, i);
+    if (mpz_cmp(p, bound) <= 0 && i + 1 < SPECIAL_PRIMES)
+    {
+      special_prime_at(p, i + 1);
+    }
+    return;
+  }
+  case PRIME_CACHE:
+    if (provider->cache != NULL && provider->cache->lambda == lambda &&
+        take_cached_prime(p, provider->cache, bound))
+    {
+      return;
+    }
+    break;
+  case PRIME_RANDOM:
+    break;
+  }
+  random_prime(p, lambda, bound, state);
+}
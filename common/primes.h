@@ -0,0 +1,65 @@
+// Where the schemes get their prime p from.
+//
+// PRIME_TABLE uses the largest prime below 2^lambda, read from a built-in
+// table of offsets, so it costs no primality testing at all. PRIME_SPECIAL
+// uses the smallest well-known special form prime of at least lambda bits
+// (2^89 - 1, 2^127 - 1, P-192, 2^255 - 19, P-384, 2^521 - 1), which the field
+// layer reduces with shifts and adds. PRIME_CACHE takes a random lambda bit
+// prime that a background thread generated ahead of time. PRIME_RANDOM is the
+// original behaviour: a fresh random prime per instance.
+#ifndef PRIMES_HEADER
+#define PRIMES_HEADER
+
+#include <gmp.h>
+#include <pthread.h>
+#include "visibility.h"
+
+// the table covers 64 <= lambda <= 513; 513 is the fallback for a 512 bit secret
+// that is not below the 512 bit prime
+#define PRIME_TABLE_MIN 64
+#define PRIME_TABLE_MAX 513
+
+enum prime_source {
+  PRIME_TABLE,
+  PRIME_SPECIAL,
+  PRIME_CACHE,
+  PRIME_RANDOM
+};
+
+// A fixed size pool of random lambda bit primes, refilled by its own thread.
+struct prime_cache {
+  int lambda;
+  int capacity;
+  int count;    // primes currently in the pool
+  mpz_t *pool;  // pool[0] ... pool[count-1]
+
+  int running;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t space; // signalled when a prime is taken
+};
+
+struct prime_provider {
+  enum prime_source source;
+  struct prime_cache *cache; // only used by PRIME_CACHE
+  int secretBelowP;          // draw the secret below p instead of below 2^lambda,
+                             // for the sources where p does not depend on it
+};
+
+void table_prime(mpz_t, int);
+
+void special_prime(mpz_t, int);
+
+int fixed_prime(mpz_t, const struct prime_provider *, int);
+
+void random_prime(mpz_t, int, const mpz_t, gmp_randstate_t);
+
+SECRET_SHARING_API struct prime_cache *start_prime_cache(int, int);
+
+SECRET_SHARING_API void stop_prime_cache(struct prime_cache *);
+
+int take_cached_prime(mpz_t, struct prime_cache *, const mpz_t);
+
+void provide_prime(mpz_t, const struct prime_provider *, int, const mpz_t, gmp_randstate_t);
+
+#endif
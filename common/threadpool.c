@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200112L
+#include "threadpool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+// number of processors online, at least 1
+int online_threads(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+}
+
+// range w of threads ranges over 0 ... count-1
+static void run_range(thread_pool_fn fn, void *arg, int count, int w, int threads)
+{
+  int begin = (int)((long long)count * w / threads);
+  int end = (int)((long long)count * (w + 1) / threads);
+  if (begin < end)
+  {
+    fn(arg, begin, end);
+  }
+}
+
+static void *worker(void *arg)
+{
+  struct thread_pool *pool = (struct thread_pool *)arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  int w = ++pool->started; // the calling thread is range 0
+  for (;;)
+  {
+    while (pool->running && pool->job == seen)
+    {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (!pool->running)
+    {
+      break;
+    }
+    seen = pool->job;
+    thread_pool_fn fn = pool->fn;
+    void *job_arg = pool->arg;
+    int count = pool->count;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_range(fn, job_arg, count, w, pool->threads);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0)
+    {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+// Starts a pool of threads workers counting the caller, or one per online
+// processor if threads is 0 or less. Returns NULL if no thread could be started.
+struct thread_pool *start_thread_pool(int threads)
+{
+  if (threads <= 0)
+  {
+    threads = online_threads();
+  }
+
+  struct thread_pool *pool;
+  pool = (struct thread_pool *)malloc(1 * sizeof(struct thread_pool));
+  pool->threads = threads;
+  pool->workers = (pthread_t *)malloc((threads > 1 ? threads - 1 : 1) * sizeof(pthread_t));
+  pool->fn = NULL;
+  pool->arg = NULL;
+  pool->count = 0;
+  pool->job = 0;
+  pool->pending = 0;
+  pool->running = 1;
+  pool->started = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for (int i = 0; i < threads - 1; i++)
+  {
+    if (pthread_create(&pool->workers[i], NULL, worker, pool) != 0)
+    {
+      // run with the workers we got; ranges are only cut for started ones
+      pool->threads = i + 1;
+      break;
+    }
+  }
+  return pool;
+}
+
+void stop_thread_pool(struct thread_pool *pool)
+{
+  if (pool == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->running = 0;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < pool->threads - 1; i++)
+  {
+    pthread_join(pool->workers[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->workers);
+  free(pool);
+}
+
+// Calls fn(arg, begin, end) over 0 ... count-1 split across the pool. With a
+// NULL pool the whole range runs on the calling thread. Jobs must not be
+// posted to the same pool from more than one thread at a time.
+void thread_pool_run(struct thread_pool *pool, int count, thread_pool_fn fn, void *arg)
+{
+  if (pool == NULL || pool->threads == 1 || count < 2)
+  {
+    if (count > 0)
+    {
+      fn(arg, 0, count);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->count = count;
+  pool->pending = pool->threads - 1;
+  pool->job++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_range(fn, arg, count, 0, pool->threads);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending != 0)
+  {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
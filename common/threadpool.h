@@ -0,0 +1,41 @@
+// A fixed set of worker threads that split index ranges between them.
+//
+// thread_pool_run(pool, count, fn, arg) cuts 0 ... count-1 into one contiguous
+// range per thread, calls fn(arg, begin, end) for each range and returns once
+// all of them are done. The calling thread works on the first range itself.
+// The ranges only depend on count and the number of threads, so any work whose
+// result only depends on the index gives the same output for every pool size.
+#ifndef THREADPOOL_HEADER
+#define THREADPOOL_HEADER
+
+#include <pthread.h>
+#include "visibility.h"
+
+typedef void (*thread_pool_fn)(void *, int, int);
+
+struct thread_pool {
+  int threads;          // including the calling thread
+  pthread_t *workers;   // threads - 1 of them
+  pthread_mutex_t lock;
+  pthread_cond_t start; // signalled when a new job is posted
+  pthread_cond_t done;  // signalled when the last range of a job finishes
+
+  // current job
+  thread_pool_fn fn;
+  void *arg;
+  int count;
+  unsigned long job;    // incremented for every job, 0 before the first
+  int pending;          // worker ranges of the current job still running
+  int running;
+  int started;          // workers that have picked their index
+};
+
+SECRET_SHARING_API int online_threads(void);
+
+SECRET_SHARING_API struct thread_pool *start_thread_pool(int);
+
+SECRET_SHARING_API void stop_thread_pool(struct thread_pool *);
+
+void thread_pool_run(struct thread_pool *, int, thread_pool_fn, void *);
+
+#endif
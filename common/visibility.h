@@ -0,0 +1,11 @@
+// Marks the functions and tables that libsecretsharing exports. The library is
+// built with -fvisibility=hidden, so helpers such as the field layer, ChaCha20
+// and the schemes' internal arithmetic stay inside it. The makefiles in the
+// scheme directories build with default visibility, where the mark changes
+// nothing.
+#ifndef VISIBILITY_HEADER
+#define VISIBILITY_HEADER
+
+#define SECRET_SHARING_API __attribute__((visibility("default")))
+
+#endif
@@ -0,0 +1,124 @@
+#include "secretsharing.h"
+
+static void *shamir_init(int t, int n, int lambda)
+{
+  return init_shamir_instance(t, n, lambda);
+}
+
+static void shamir_pool(void *instance, struct thread_pool *pool)
+{
+  set_shamir_thread_pool((struct shamir *)instance, pool);
+}
+
+static void shamir_secret(void *instance)
+{
+  generate_shamir_secret((struct shamir *)instance);
+}
+
+static void shamir_shares(void *instance)
+{
+  generate_shamir_shares((struct shamir *)instance);
+}
+
+static int shamir_recover(void *instance)
+{
+  return recover_shamir_secret((struct shamir *)instance);
+}
+
+static void shamir_free(void *instance)
+{
+  free_shamir_instance((struct shamir *)instance);
+}
+
+static void *blakely_init(int t, int n, int lambda)
+{
+  return init_blakely_instance(t, n, lambda);
+}
+
+static void blakely_pool(void *instance, struct thread_pool *pool)
+{
+  set_blakely_thread_pool((struct blakely *)instance, pool);
+}
+
+static void blakely_secret(void *instance)
+{
+  generate_blakely_secret((struct blakely *)instance);
+}
+
+static void blakely_shares(void *instance)
+{
+  generate_blakely_shares((struct blakely *)instance);
+}
+
+static int blakely_recover(void *instance)
+{
+  return recover_blakely_secret((struct blakely *)instance);
+}
+
+static void blakely_free(void *instance)
+{
+  free_blakely_instance((struct blakely *)instance);
+}
+
+static void *asmuth_bloom_init(int t, int n, int lambda)
+{
+  return init_asmuth_bloom_instance(t, n, lambda);
+}
+
+static void asmuth_bloom_pool(void *instance, struct thread_pool *pool)
+{
+  set_asmuth_bloom_thread_pool((struct asmuth_bloom *)instance, pool);
+}
+
+static void asmuth_bloom_secret(void *instance)
+{
+  generate_asmuth_bloom_secret((struct asmuth_bloom *)instance);
+}
+
+static void asmuth_bloom_shares(void *instance)
+{
+  generate_asmuth_bloom_shares((struct asmuth_bloom *)instance);
+}
+
+static int asmuth_bloom_recover(void *instance)
+{
+  return recover_asmuth_bloom_secret((struct asmuth_bloom *)instance);
+}
+
+static void asmuth_bloom_free(void *instance)
+{
+  free_asmuth_bloom_instance((struct asmuth_bloom *)instance);
+}
+
+const struct secret_sharing_scheme shamir_scheme = {
+    "shamir", MAX_PARTICIPANTS, shamir_init, shamir_pool, shamir_secret, shamir_shares, shamir_recover, shamir_free};
+
+const struct secret_sharing_scheme blakely_scheme = {
+    "blakely", 1000, blakely_init, blakely_pool, blakely_secret, blakely_shares, blakely_recover, blakely_free};
+
+const struct secret_sharing_scheme asmuth_bloom_scheme = {
+    "asmuth-bloom", 1000, asmuth_bloom_init, asmuth_bloom_pool, asmuth_bloom_secret, asmuth_bloom_shares,
+    asmuth_bloom_recover, asmuth_bloom_free};
+
+const struct secret_sharing_scheme *const secret_sharing_schemes[] = {&shamir_scheme, &blakely_scheme,
+                                                                      &asmuth_bloom_scheme, NULL};
+
+// the scheme called name ("shamir", "blakely" or "asmuth-bloom"), NULL if
+// there is none
+const struct secret_sharing_scheme *find_scheme(const char *name)
+{
+  for (int i = 0; secret_sharing_schemes[i] != NULL; i++)
+  {
+    if (strcmp(secret_sharing_schemes[i]->name, name) == 0)
+    {
+      return secret_sharing_schemes[i];
+    }
+  }
+  return NULL;
+}
+
+// whether scheme->init takes t, n and lambda, which it would exit on otherwise
+int scheme_accepts(const struct secret_sharing_scheme *scheme, int t, int n, int lambda)
+{
+  return t >= 2 && t <= n && n <= scheme->max_participants && lambda >= 64 && lambda <= 512;
+}
@@ -0,0 +1,52 @@
+// libsecretsharing: Shamir, Blakely and Asmuth-Bloom in one library.
+//
+// Every scheme keeps its own entry points, with the scheme in their names
+// (init_shamir_instance, generate_blakely_shares, recover_asmuth_bloom_secret,
+// ...), so all of them link into one process. struct secret_sharing_scheme
+// puts the calls that every scheme has behind one table of functions on
+// opaque instances, so a caller can pick a scheme at run time, by name or by
+// timing them, and drive it without knowing which one it got.
+//
+// The library is built with -fvisibility=hidden. Only what is marked
+// SECRET_SHARING_API in these headers is exported from libsecretsharing.so.
+#ifndef SECRET_SHARING_HEADER
+#define SECRET_SHARING_HEADER
+
+#include "common/visibility.h"
+#include "Shamir/shamir.h"
+#include "Shamir/batch.h"
+#include "Shamir/packed.h"
+#include "Shamir/feldman.h"
+#include "Shamir/reshare.h"
+#include "Shamir/stream.h"
+#include "Shamir/decode.h"
+#include "Shamir/gf256.h"
+#include "Blakely/blakely.h"
+#include "AsmuthBloom/asmuthbloom.h"
+#include "AsmuthBloom/moduli.h"
+#include "AsmuthBloom/rns.h"
+
+struct secret_sharing_scheme {
+  const char *name;
+  int max_participants; // n above this is not valid, 2 <= t <= n and 64 <= lambda <= 512 for all schemes
+
+  void *(*init)(int, int, int); // instance for t, n and lambda, exits on invalid ones
+  void (*set_thread_pool)(void *, struct thread_pool *);
+  void (*generate_secret)(void *);
+  void (*generate_shares)(void *);
+  int (*recover_secret)(void *); // 1 if the secret came back
+  void (*free)(void *);
+};
+
+SECRET_SHARING_API extern const struct secret_sharing_scheme shamir_scheme;
+SECRET_SHARING_API extern const struct secret_sharing_scheme blakely_scheme;
+SECRET_SHARING_API extern const struct secret_sharing_scheme asmuth_bloom_scheme;
+
+// every scheme, NULL terminated
+SECRET_SHARING_API extern const struct secret_sharing_scheme *const secret_sharing_schemes[];
+
+SECRET_SHARING_API const struct secret_sharing_scheme *find_scheme(const char *);
+
+SECRET_SHARING_API int scheme_accepts(const struct secret_sharing_scheme *, int, int, int);
+
+#endif